@@ -0,0 +1,1341 @@
+/* Benchmarks
+ *
+ * @file bench.c
+ * @brief Microbenchmarks for the search engine building blocks.
+ *
+ * Usage: bench <name> [args]
+ *   codecs    Encode/decode speed and size of the posting codecs
+ *   corpus    Re-encode the posting lists of the index in data/ with every
+ *             codec, compare the compression ratio and decode speed
+ *   vocab <tokens_file>
+ *             Tokens/sec of the indexing vocabulary, red-black tree
+ *             against hash table, over the parser output
+ *   tokenizer <xml_file>
+ *             MB/s of the tokenizer scanners (bytewise, scalar, sse2,
+ *             avx2) and a check that they all produce the same word stream
+ *   stemmer <xml_file>
+ *             Differential check of the trie stemmer (plain and cached)
+ *             against the reference stemmer over the corpus vocabulary,
+ *             and words/sec of each
+ *   topk [k]  Ranking the matches of broad one word queries on the index
+ *             in data/: full sort of all results against a k-bounded heap
+ *   wand <query_log> [k]
+ *             Top-k OR queries, one per line, on the index in data/:
+ *             exhaustive scoring against Block-Max WAND, and a check
+ *             that both find the same documents
+ *   intersect Intersection kernels (scalar merge, galloping, SSE2/AVX2
+ *             block compare and broadcast, adaptive) over synthetic
+ *             arrays and over word pairs of the index in data/, at length
+ *             ratios from 1 to 1024, checking they all find the same matches
+ *   large <dir> [GB]
+ *             Build a synthetic index in dir whose posting file reaches
+ *             past GB (default 5) gigabytes, then look up and decode every
+ *             term with and without mmap. The gap is a hole in a sparse
+ *             file, the files are removed afterwards
+ * 
+ * @author Ubaada
+ * @date 01-04-2024
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "include/common.h"
+#include "include/postings.h"
+#include "include/codec.h"
+#include "include/timing.h"
+#include "include/index_reader.h"
+#include "include/rbtree.h"
+#include "include/vocabulary.h"
+#include "include/tokenizer.h"
+#include "include/stemmer.h"
+#include "include/topk.h"
+#include "include/linked_list.h"
+#include "include/wand.h"
+#include "include/dictionary.h"
+#include "include/doc_ids.h"
+#include "include/intersect.h"
+
+#define BENCH_MIN_SECONDS 0.2 /* Repeat each measurement for at least this long */
+#define BENCH_VALUES (1 << 20) /* Integers per synthetic data set */
+#define BENCH_TOPK_QUERIES 20 /* Most frequent words used as queries by bench topk */
+#define BENCH_QUERY_TERMS 16 /* Words used of each query by bench wand */
+#define BENCH_LARGE_TERMS 64 /* Terms of the synthetic index of bench large */
+#define BENCH_LARGE_DOCS 10000 /* Documents of the synthetic index */
+#define BENCH_INTERSECT_SHORT 4096 /* Values of the shorter synthetic array */
+#define BENCH_INTERSECT_PAIRS 32 /* Word pairs per length ratio in bench intersect */
+#define BENCH_INTERSECT_MIN_DF 32 /* Shortest posting list paired in bench intersect */
+
+/* Small deterministic generator so runs are comparable */
+static uint64_t bench_rng_state = 88172645463325252ull;
+
+static uint32_t bench_rand(void) {
+    bench_rng_state ^= bench_rng_state << 13;
+    bench_rng_state ^= bench_rng_state >> 7;
+    bench_rng_state ^= bench_rng_state << 17;
+    return (uint32_t)bench_rng_state;
+}
+
+/* Geometric-ish value with the given mean */
+static uint32_t bench_rand_mean(uint32_t mean) {
+    return bench_rand() % (2 * mean) + (mean > 0 ? 0 : 1);
+}
+
+/**
+ * Time decoding of a block-encoded data set with the current codec setup
+ * 
+ * @param codec The codec the data was encoded with
+ * @param encoded The encoded blocks
+ * @param values The original values, to verify the decoding
+ * @param n The number of values
+ * @param out Scratch space for n decoded values
+ * @return Millions of integers decoded per second, -1 on a mismatch
+ */
+static double bench_decode(int codec, ByteBuffer *encoded, const uint32_t *values, int n, uint32_t *out) {
+    const unsigned char *end = encoded->data + encoded->size;
+    long rounds = 0;
+    double start = time_now();
+    double elapsed = 0;
+    do {
+        const unsigned char *p = encoded->data;
+        for (int i = 0; i < n; i += POSTING_BLOCK_SIZE) {
+            int count = n - i < POSTING_BLOCK_SIZE ? n - i : POSTING_BLOCK_SIZE;
+            p = codec_decode(codec, p, end, count, out + i);
+        }
+        rounds += 1;
+        elapsed = time_now() - start;
+    } while (elapsed < BENCH_MIN_SECONDS);
+
+    if (memcmp(out, values, n * sizeof(uint32_t)) != 0) {
+        return -1;
+    }
+    return (double)n * rounds / elapsed / 1e6;
+}
+
+/**
+ * Compare size and decode speed of the codecs on synthetic
+ * doc_id deltas and freqs, in blocks of POSTING_BLOCK_SIZE
+ */
+static int bench_codecs(void) {
+    const char *decoders[] = { "scalar", "ssse3", "avx2" };
+    struct { const char *name; uint32_t mean; } sets[] = {
+        { "freqs (mean 2)", 2 },
+        { "dense deltas (mean 8)", 8 },
+        { "sparse deltas (mean 300)", 300 },
+        { "very sparse deltas (mean 100000)", 100000 },
+    };
+    int n = BENCH_VALUES;
+    uint32_t *values = (uint32_t *)malloc(n * sizeof(uint32_t));
+    uint32_t *out = (uint32_t *)malloc((n + 32) * sizeof(uint32_t));
+
+    printf("%-34s %-12s %-8s %10s %14s\n", "data set", "codec", "decoder", "bytes/int", "M ints/sec");
+    for (size_t s = 0; s < sizeof(sets) / sizeof(sets[0]); s++) {
+        for (int i = 0; i < n; i++) {
+            values[i] = bench_rand_mean(sets[s].mean);
+        }
+
+        for (int codec = 0; codec < CODEC_COUNT; codec++) {
+            ByteBuffer encoded = {0};
+            for (int i = 0; i < n; i += POSTING_BLOCK_SIZE) {
+                int count = n - i < POSTING_BLOCK_SIZE ? n - i : POSTING_BLOCK_SIZE;
+                codec_encode(codec, values + i, count, &encoded);
+            }
+            double bytes_per_int = (double)encoded.size / n;
+
+            if (codec != CODEC_VBYTE) {
+                for (size_t d = 0; d < sizeof(decoders) / sizeof(decoders[0]); d++) {
+                    if (!codec_set_decoder(decoders[d])) continue;
+                    double speed = bench_decode(codec, &encoded, values, n, out);
+                    printf("%-34s %-12s %-8s %10.3f %14.1f%s\n", sets[s].name, codec_name(codec),
+                           decoders[d], bytes_per_int, speed, speed < 0 ? " MISMATCH" : "");
+                }
+            } else {
+                double speed = bench_decode(codec, &encoded, values, n, out);
+                printf("%-34s %-12s %-8s %10.3f %14.1f%s\n", sets[s].name, codec_name(codec),
+                       "scalar", bytes_per_int, speed, speed < 0 ? " MISMATCH" : "");
+            }
+            bytebuffer_free(&encoded);
+        }
+    }
+
+    free(values);
+    free(out);
+    return 0;
+}
+
+/**
+ * Re-encode every posting list of the index in data/ with each codec,
+ * then time decoding all of them through posting cursors
+ */
+static int bench_corpus(void) {
+    IndexReader index;
+    if (!index_open(&index, true)) {
+        index_close(&index);
+        return 1;
+    }
+
+    int n_words = index.dict_size;
+    long n_postings = 0;
+    long *offsets[CODEC_COUNT]; /* Start of each list in the encoded buffers */
+    ByteBuffer encoded[CODEC_COUNT] = {{0}};
+    IndexHeader headers[CODEC_COUNT];
+    int *docs = NULL;
+    int *freqs = NULL;
+    int capacity = 0;
+
+    for (int codec = 0; codec < CODEC_COUNT; codec++) {
+        headers[codec].version = INDEX_VERSION_BLOCKS;
+        headers[codec].block_size = POSTING_BLOCK_SIZE;
+        headers[codec].codec = codec;
+        headers[codec].stamp = 0;
+        offsets[codec] = (long *)malloc((n_words + 1) * sizeof(long));
+    }
+
+    /* Decode every list once and encode it with all codecs */
+    for (int w = 0; w < n_words; w++) {
+        char word[MAX_KEY_SIZE + 1];
+        int64_t begin, end;
+        PostingBytes bytes;
+        PostingCursor cursor;
+        index_entry(&index, w, word, sizeof(word), &begin, &end);
+        index_read_postings(&index, begin, end, &bytes);
+        posting_cursor_open(&cursor, bytes.data, bytes.size, &index.header);
+        PostingList *list = posting_cursor_decode_all(&cursor);
+        if (list->size > capacity) {
+            capacity = list->size;
+            docs = (int *)realloc(docs, capacity * sizeof(int));
+            freqs = (int *)realloc(freqs, capacity * sizeof(int));
+        }
+        for (int i = 0; i < list->size; i++) {
+            docs[i] = list->postings[i].doc_id;
+            freqs[i] = list->postings[i].freq;
+        }
+        n_postings += list->size;
+
+        for (int codec = 0; codec < CODEC_COUNT; codec++) {
+            offsets[codec][w] = encoded[codec].size;
+            encode_posting_blocks(docs, freqs, list->size, &headers[codec], NULL, &encoded[codec]);
+        }
+        posting_list_free(list);
+        posting_cursor_close(&cursor);
+        index_release_postings(&bytes);
+    }
+
+    for (int codec = 0; codec < CODEC_COUNT; codec++) {
+        offsets[codec][n_words] = encoded[codec].size;
+    }
+
+    printf("%d words, %ld postings, index codec %s\n", n_words, n_postings, codec_name(index.header.codec));
+    printf("%-12s %14s %14s %10s %16s\n", "codec", "bytes", "bytes/posting", "ratio", "M postings/sec");
+    for (int codec = 0; codec < CODEC_COUNT; codec++) {
+        long rounds = 0;
+        double start = time_now();
+        double elapsed = 0;
+        do {
+            for (int w = 0; w < n_words; w++) {
+                PostingCursor cursor;
+                posting_cursor_open(&cursor, encoded[codec].data + offsets[codec][w],
+                                    offsets[codec][w + 1] - offsets[codec][w], &headers[codec]);
+                PostingList *list = posting_cursor_decode_all(&cursor);
+                posting_list_free(list);
+                posting_cursor_close(&cursor);
+            }
+            rounds += 1;
+            elapsed = time_now() - start;
+        } while (elapsed < BENCH_MIN_SECONDS);
+
+        printf("%-12s %14zu %14.3f %10.3f %16.1f\n", codec_name(codec), encoded[codec].size,
+               (double)encoded[codec].size / n_postings,
+               (double)encoded[codec].size / encoded[CODEC_VBYTE].size,
+               (double)n_postings * rounds / elapsed / 1e6);
+    }
+
+    for (int codec = 0; codec < CODEC_COUNT; codec++) {
+        bytebuffer_free(&encoded[codec]);
+        free(offsets[codec]);
+    }
+    free(docs);
+    free(freqs);
+    index_close(&index);
+    return 0;
+}
+
+/**
+ * Feed every line of a token file to the red-black tree vocabulary the way
+ * the indexer used to (copy to a key, search, insert on a miss) and walk it
+ * in order. Each term counts its occurrences.
+ *
+ * @return The number of distinct terms
+ */
+static long bench_vocab_rbtree(const char *text, size_t size) {
+    Arena *arena = arena_create(0);
+    RBTree *tree = rb_create_arena(arena);
+    const char *end = text + size;
+    char word[MAX_KEY_SIZE];
+    for (const char *p = text; p < end;) {
+        const char *newline = memchr(p, '\n', end - p);
+        size_t length = (newline ? newline : end) - p;
+        if (length > 0) {
+            if (length > MAX_KEY_SIZE - 1) length = MAX_KEY_SIZE - 1;
+            memcpy(word, p, length);
+            word[length] = '\0';
+            RBTreeNode *node = rb_search(tree, word);
+            if (node == tree->nil) {
+                int *count = (int *)arena_alloc(arena, sizeof(int));
+                *count = 1;
+                rb_insert(tree, word, count);
+            } else {
+                *(int *)node->value += 1;
+            }
+        }
+        p = newline ? newline + 1 : end;
+    }
+
+    long n_terms = 0;
+    for (RBTreeNode *node = rb_minimum(tree, tree->root); node != tree->nil; node = rb_successor(tree, node)) {
+        n_terms += 1;
+    }
+    rb_destroy(tree);
+    free(tree);
+    arena_destroy(arena);
+    return n_terms;
+}
+
+/**
+ * Same as bench_vocab_rbtree with the hash table vocabulary, hashing the
+ * lines in place and sorting the terms once at the end
+ *
+ * @return The number of distinct terms
+ */
+static long bench_vocab_hash(const char *text, size_t size) {
+    Arena *arena = arena_create(0);
+    Vocabulary *vocab = vocab_create(arena);
+    const char *end = text + size;
+    for (const char *p = text; p < end;) {
+        const char *newline = memchr(p, '\n', end - p);
+        size_t length = (newline ? newline : end) - p;
+        if (length > 0) {
+            if (length > MAX_KEY_SIZE - 1) length = MAX_KEY_SIZE - 1;
+            bool added;
+            VocabTerm *term = vocab_find_or_add(vocab, p, length, &added);
+            if (added) {
+                term->value = arena_alloc(arena, sizeof(int));
+                *(int *)term->value = 0;
+            }
+            *(int *)term->value += 1;
+        }
+        p = newline ? newline + 1 : end;
+    }
+
+    long n_terms = vocab->size;
+    free(vocab_sorted(vocab));
+    vocab_destroy(vocab);
+    arena_destroy(arena);
+    return n_terms;
+}
+
+/**
+ * Read a whole file into memory
+ *
+ * @param path The file
+ * @param size Set to the size of the file
+ * @return The contents to free() after use, NULL on error
+ */
+static char* bench_read_file(const char *path, size_t *size) {
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        printf("Error: Couldn't open file '%s'\n", path);
+        return NULL;
+    }
+    fseek(fp, 0, SEEK_END);
+    *size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    char *text = (char *)malloc(*size + 1);
+    if (fread(text, 1, *size, fp) != *size) {
+        printf("Error: Couldn't read file '%s'\n", path);
+        fclose(fp);
+        free(text);
+        return NULL;
+    }
+    fclose(fp);
+    return text;
+}
+
+/**
+ * Compare the indexing vocabularies over a token file
+ *
+ * @param path The token file written by the parser
+ */
+static int bench_vocab(const char *path) {
+    size_t size;
+    char *text = bench_read_file(path, &size);
+    if (text == NULL) {
+        return 1;
+    }
+
+    long n_tokens = 0;
+    for (size_t i = 0; i + 1 < size; i++) {
+        n_tokens += text[i] != '\n' && text[i + 1] == '\n';
+    }
+
+    const char *names[2] = { "rbtree", "hash" };
+    long (*builders[2])(const char *, size_t) = { bench_vocab_rbtree, bench_vocab_hash };
+    printf("%ld tokens\n", n_tokens);
+    printf("%-10s %10s %12s %16s\n", "vocab", "terms", "seconds", "M tokens/sec");
+    for (int i = 0; i < 2; i++) {
+        long rounds = 0;
+        long n_terms = 0;
+        double start = time_now();
+        double elapsed = 0;
+        do {
+            n_terms = builders[i](text, size);
+            rounds += 1;
+            elapsed = time_now() - start;
+        } while (elapsed < BENCH_MIN_SECONDS);
+        printf("%-10s %10ld %12.3f %16.2f\n", names[i], n_terms, elapsed / rounds,
+               (double)n_tokens * rounds / elapsed / 1e6);
+    }
+
+    free(text);
+    return 0;
+}
+
+/* Collect the word stream of the tokenizer, a token per line */
+static void bench_collect_token(void *context, const char *token, int length) {
+    ByteBuffer *out = (ByteBuffer *)context;
+    bytebuffer_put(out, token, length);
+    bytebuffer_put(out, "\n", 1);
+}
+
+/**
+ * Time the tokenizer with the scanner in use
+ *
+ * @param xml The XML collection
+ * @param size The size of the collection
+ * @param stem Stem the words, false to time the scanning alone
+ * @param out Receives the word stream
+ * @return The throughput in MB/s
+ */
+static double bench_tokenize(const char *xml, size_t size, bool stem, ByteBuffer *out) {
+    long rounds = 0;
+    double start = time_now();
+    double elapsed = 0;
+    do {
+        out->size = 0;
+        Tokenizer tokenizer;
+        tokenizer_init(&tokenizer, bench_collect_token, out);
+        tokenizer.stem = stem;
+        tokenizer_feed(&tokenizer, xml, size);
+        rounds += 1;
+        elapsed = time_now() - start;
+    } while (elapsed < BENCH_MIN_SECONDS);
+    return size * rounds / elapsed / (1024.0 * 1024.0);
+}
+
+/**
+ * Time every tokenizer scanner over an XML file, with and without
+ * stemming, and check their word streams are identical to the byte
+ * at a time reference
+ *
+ * @param path The XML collection
+ * @return 0 if all scanners agree, 1 otherwise
+ */
+static int bench_tokenizer(const char *path) {
+    size_t size;
+    char *xml = bench_read_file(path, &size);
+    if (xml == NULL) {
+        return 1;
+    }
+
+    const char *scanners[] = { "bytewise", "scalar", "sse2", "avx2" };
+    ByteBuffer reference = {0};
+    ByteBuffer out = {0};
+    int status = 0;
+    double base = 0;
+    double base_no_stem = 0;
+    printf("%-10s %12s %10s %16s %10s %10s\n", "scanner", "MB/s", "speedup", "MB/s (no stem)", "speedup", "output");
+    for (int s = 0; s < 4; s++) {
+        if (!tokenizer_set_scanner(scanners[s])) {
+            printf("%-10s %12s\n", scanners[s], "unsupported");
+            continue;
+        }
+        double no_stem = bench_tokenize(xml, size, false, &out);
+        double full = bench_tokenize(xml, size, true, &out);
+        bool same = true;
+        if (s == 0) {
+            base = full;
+            base_no_stem = no_stem;
+            bytebuffer_put(&reference, out.data, out.size);
+        } else {
+            same = out.size == reference.size && memcmp(out.data, reference.data, out.size) == 0;
+        }
+        printf("%-10s %12.1f %10.2f %16.1f %10.2f %10s\n", scanners[s], full, full / base,
+               no_stem, no_stem / base_no_stem, same ? "identical" : "DIFFERENT");
+        if (!same) status = 1;
+    }
+
+    bytebuffer_free(&reference);
+    bytebuffer_free(&out);
+    free(xml);
+    return status;
+}
+
+/* Words the corpus may not have: short, upper case, apostrophes, exact suffixes */
+static const char *STEM_EDGE_CASES[] = { "", "s", "es", "ies", "able", "ables", "tables", "TABLES",
+    "Running", "RUNS", "dog's", "it's", "x's", "fly", "ally", "ness", "kindness", "nesses", "ions",
+    "lions", "onions", "IONS", "ated", "rates", "fizes", "wise", "noise", "ant", "pants", "ive",
+    "hive", "olives", "MENT", "cement", "ables\'s", "abc", "abcs", "A-B-Cs", "\xc3\xa9tudes", NULL };
+
+/**
+ * Time a stemmer over a sequence of words
+ *
+ * @param words The words, a word per line
+ * @param size The size of the words
+ * @param stemmer 0 reference, 1 trie, 2 trie with a cache
+ * @param cache The cache for stemmer 2
+ * @return Millions of words per second
+ */
+static double bench_stem_words(const char *words, size_t size, int stemmer, StemCache *cache) {
+    char word[MAX_TOKEN_SIZE];
+    long n_words = 0;
+    double start = time_now();
+    double elapsed = 0;
+    do {
+        const char *p = words;
+        const char *end = words + size;
+        while (p < end) {
+            const char *newline = memchr(p, '\n', end - p);
+            size_t length = newline - p;
+            memcpy(word, p, length);
+            word[length] = '\0';
+            if (stemmer == 0) {
+                stem_reference(word);
+            } else if (stemmer == 1) {
+                stem_length(word, length);
+            } else {
+                stem_cached(cache, word, length);
+            }
+            n_words += 1;
+            p = newline + 1;
+        }
+        elapsed = time_now() - start;
+    } while (elapsed < BENCH_MIN_SECONDS);
+    return n_words / elapsed / 1e6;
+}
+
+/**
+ * Check the trie stemmer against the reference on every distinct word of
+ * the corpus (unstemmed tokens) and some edge cases, then time them
+ *
+ * @param path The XML collection
+ * @return 0 if all words stem the same, 1 otherwise
+ */
+static int bench_stemmer(const char *path) {
+    size_t size;
+    char *xml = bench_read_file(path, &size);
+    if (xml == NULL) {
+        return 1;
+    }
+
+    /* The corpus words before stemming */
+    ByteBuffer words = {0};
+    Tokenizer tokenizer;
+    tokenizer_init(&tokenizer, bench_collect_token, &words);
+    tokenizer.stem = false;
+    tokenizer_feed(&tokenizer, xml, size);
+    free(xml);
+
+    /* Distinct words, plus the edge cases */
+    Arena *arena = arena_create(0);
+    Vocabulary *vocab = vocab_create(arena);
+    for (const char *p = (const char *)words.data; p < (const char *)words.data + words.size;) {
+        const char *newline = memchr(p, '\n', (const char *)words.data + words.size - p);
+        bool added;
+        vocab_find_or_add(vocab, p, newline - p, &added);
+        p = newline + 1;
+    }
+    for (int i = 0; STEM_EDGE_CASES[i] != NULL; i++) {
+        bool added;
+        vocab_find_or_add(vocab, STEM_EDGE_CASES[i], strlen(STEM_EDGE_CASES[i]), &added);
+    }
+
+    StemCache *cache = (StemCache *)calloc(1, sizeof(StemCache));
+    VocabTerm **terms = vocab_sorted(vocab);
+    long mismatches = 0;
+    for (size_t i = 0; i < vocab->size; i++) {
+        char reference[MAX_TOKEN_SIZE], trie[MAX_TOKEN_SIZE], cached[MAX_TOKEN_SIZE];
+        strcpy(reference, terms[i]->key);
+        strcpy(trie, terms[i]->key);
+        strcpy(cached, terms[i]->key);
+        stem_reference(reference);
+        stem_length(trie, terms[i]->length);
+        /* Twice, so both the miss and the hit are checked */
+        stem_cached(cache, cached, terms[i]->length);
+        strcpy(cached, terms[i]->key);
+        stem_cached(cache, cached, terms[i]->length);
+        if (strcmp(reference, trie) != 0 || strcmp(reference, cached) != 0) {
+            if (mismatches < 10) {
+                printf("Mismatch: '%s' -> '%s' (reference) '%s' (trie) '%s' (cached)\n",
+                       terms[i]->key, reference, trie, cached);
+            }
+            mismatches += 1;
+        }
+    }
+    printf("%zu distinct words checked, %ld mismatches\n", vocab->size, mismatches);
+
+    memset(cache, 0, sizeof(StemCache));
+    const char *names[3] = { "reference", "trie", "trie+cache" };
+    double base = 0;
+    printf("%-12s %16s %10s\n", "stemmer", "M words/sec", "speedup");
+    for (int i = 0; i < 3; i++) {
+        double rate = bench_stem_words((const char *)words.data, words.size, i, cache);
+        if (i == 0) base = rate;
+        printf("%-12s %16.1f %10.2f\n", names[i], rate, rate / base);
+    }
+    printf("cache hit rate %.1f%%\n", 100.0 * cache->hits / (cache->hits + cache->misses));
+
+    free(cache);
+    free(terms);
+    vocab_destroy(vocab);
+    arena_destroy(arena);
+    bytebuffer_free(&words);
+    return mismatches == 0 ? 0 : 1;
+}
+
+/* A result of the full sort path, as the searcher builds it */
+typedef struct BenchResult {
+    const char *doc_id;
+    float score;
+} BenchResult;
+
+/* Higher score first */
+static int bench_cmp_results(const void *a, const void *b) {
+    float score_a = ((const BenchResult *)a)->score;
+    float score_b = ((const BenchResult *)b)->score;
+    return score_a < score_b ? 1 : score_a > score_b ? -1 : 0;
+}
+
+/* Order words by posting list size, largest first */
+static long *bench_df;
+static int bench_cmp_df(const void *a, const void *b) {
+    long df_a = bench_df[*(const int *)a];
+    long df_b = bench_df[*(const int *)b];
+    return df_a < df_b ? 1 : df_a > df_b ? -1 : 0;
+}
+
+/**
+ * Rank the postings of the most frequent words (the broadest one word
+ * queries) the way the searcher does without -k, resolving and sorting
+ * every result, and with a k-bounded heap, resolving only the top k.
+ * Checks both give the same top k.
+ *
+ * @param k The number of results wanted
+ * @return 0 if the results agree, 1 otherwise
+ */
+static int bench_topk(int k) {
+    IndexReader index;
+    if (!index_open(&index, true)) {
+        index_close(&index);
+        return 1;
+    }
+
+    /* The most frequent words, by posting list bytes */
+    int n_words = index.dict_size;
+    bench_df = (long *)malloc(n_words * sizeof(long));
+    int *order = (int *)malloc(n_words * sizeof(int));
+    for (int w = 0; w < n_words; w++) {
+        char word[MAX_KEY_SIZE + 1];
+        int64_t begin, end;
+        index_entry(&index, w, word, sizeof(word), &begin, &end);
+        bench_df[w] = end - begin;
+        order[w] = w;
+    }
+    qsort(order, n_words, sizeof(int), bench_cmp_df);
+    int n_queries = n_words < BENCH_TOPK_QUERIES ? n_words : BENCH_TOPK_QUERIES;
+
+    PostingList *lists[BENCH_TOPK_QUERIES];
+    long n_postings = 0;
+    for (int q = 0; q < n_queries; q++) {
+        char word[MAX_KEY_SIZE + 1];
+        int64_t begin, end;
+        PostingBytes bytes;
+        PostingCursor cursor;
+        index_entry(&index, order[q], word, sizeof(word), &begin, &end);
+        index_read_postings(&index, begin, end, &bytes);
+        posting_cursor_open(&cursor, bytes.data, bytes.size, &index.header);
+        lists[q] = posting_cursor_decode_all(&cursor);
+        n_postings += lists[q]->size;
+        posting_cursor_close(&cursor);
+        index_release_postings(&bytes);
+    }
+
+    /* Full sort: every result resolved, linked and merge sorted */
+    int status = 0;
+    const char **full_top = (const char **)malloc((size_t)n_queries * k * sizeof(char *));
+    long rounds = 0;
+    double start = time_now();
+    double full_seconds = 0;
+    do {
+        for (int q = 0; q < n_queries; q++) {
+            LinkedList *ranked = linkedlist_create(bench_cmp_results);
+            for (int i = 0; i < lists[q]->size; i++) {
+                BenchResult *result = (BenchResult *)malloc(sizeof(BenchResult));
+                result->doc_id = index_doc_id(&index, lists[q]->postings[i].doc_id);
+                result->score = lists[q]->postings[i].freq;
+                linkedlist_add_tail(ranked, result);
+            }
+            linkedlist_sort(ranked);
+            int i = 0;
+            for (Node *node = ranked->head; node != NULL && i < k; node = node->next, i++) {
+                full_top[q * k + i] = ((BenchResult *)node->data)->doc_id;
+            }
+            linkedlist_delete(ranked);
+        }
+        rounds += 1;
+        full_seconds = time_now() - start;
+    } while (full_seconds < BENCH_MIN_SECONDS);
+    full_seconds /= rounds;
+
+    /* Heap: one pass of scores, only the k best resolved */
+    rounds = 0;
+    start = time_now();
+    double heap_seconds = 0;
+    do {
+        for (int q = 0; q < n_queries; q++) {
+            TopK topk;
+            topk_init(&topk, k);
+            for (int i = 0; i < lists[q]->size; i++) {
+                topk_push(&topk, lists[q]->postings[i].doc_id, lists[q]->postings[i].freq);
+            }
+            int n = topk_sort(&topk);
+            for (int i = 0; i < n; i++) {
+                const char *doc_id = index_doc_id(&index, topk.heap[i].doc_id);
+                if (rounds == 0 && strcmp(doc_id, full_top[q * k + i]) != 0) {
+                    status = 1;
+                }
+            }
+            topk_free(&topk);
+        }
+        rounds += 1;
+        heap_seconds = time_now() - start;
+    } while (heap_seconds < BENCH_MIN_SECONDS);
+    heap_seconds /= rounds;
+
+    printf("%d queries, %.0f results per query, k = %d\n", n_queries, (double)n_postings / n_queries, k);
+    printf("%-10s %16s %10s\n", "ranking", "ms per query", "speedup");
+    printf("%-10s %16.3f %10.2f\n", "full sort", full_seconds * 1000 / n_queries, 1.0);
+    printf("%-10s %16.3f %10.2f\n", "heap", heap_seconds * 1000 / n_queries, full_seconds / heap_seconds);
+    printf("top %d %s\n", k, status == 0 ? "identical" : "DIFFERENT");
+
+    for (int q = 0; q < n_queries; q++) {
+        posting_list_free(lists[q]);
+    }
+    free(full_top);
+    free(order);
+    free(bench_df);
+    index_close(&index);
+    return status;
+}
+
+/* A query of the log with its posting lists read */
+typedef struct BenchQuery {
+    int n_terms;
+    PostingBytes bytes[BENCH_QUERY_TERMS];
+    float idf[BENCH_QUERY_TERMS];
+} BenchQuery;
+
+/**
+ * Run one OR query on fresh cursors
+ *
+ * @param query The query
+ * @param index The opened index
+ * @param wand Block-Max WAND if true, exhaustive scoring otherwise
+ * @param topk Receives the best documents, initialised by the caller
+ * @param stats Work counters, added to
+ */
+static void bench_or_query(BenchQuery *query, IndexReader *index, bool wand, TopK *topk, WandStats *stats) {
+    PostingCursor cursors[BENCH_QUERY_TERMS];
+    QueryTerm terms[BENCH_QUERY_TERMS];
+    for (int t = 0; t < query->n_terms; t++) {
+        posting_cursor_open(&cursors[t], query->bytes[t].data, query->bytes[t].size, &index->header);
+        terms[t].cursor = &cursors[t];
+        terms[t].idf = query->idf[t];
+    }
+    if (wand) {
+        or_query_wand(terms, query->n_terms, index->stats.norm, topk, stats);
+    } else {
+        or_query_exhaustive(terms, query->n_terms, index->stats.norm, topk, stats);
+    }
+    for (int t = 0; t < query->n_terms; t++) {
+        posting_cursor_close(&cursors[t]);
+    }
+}
+
+/**
+ * Time the queries of a log with exhaustive OR scoring and with WAND
+ *
+ * @param path The query log, one query per line
+ * @param k The number of results per query
+ */
+static int bench_wand(const char *path, int k) {
+    size_t size;
+    char *text = bench_read_file(path, &size);
+    if (text == NULL) {
+        return 1;
+    }
+    text[size] = '\0';
+    IndexReader index;
+    if (!index_open(&index, true)) {
+        index_close(&index);
+        free(text);
+        return 1;
+    }
+    if (!index.has_stats) {
+        printf("Error: BM25 needs %s, rebuild the index\n", DOC_STATS_FILE);
+        index_close(&index);
+        free(text);
+        return 1;
+    }
+
+    /* Read the posting lists of every query up front */
+    int n_queries = 0, capacity = 256;
+    BenchQuery *queries = (BenchQuery *)malloc(capacity * sizeof(BenchQuery));
+    char *saveptr = NULL;
+    for (char *line = strtok_r(text, "\n", &saveptr); line != NULL; line = strtok_r(NULL, "\n", &saveptr)) {
+        if (n_queries == capacity) {
+            capacity *= 2;
+            queries = (BenchQuery *)realloc(queries, capacity * sizeof(BenchQuery));
+        }
+        BenchQuery *query = &queries[n_queries];
+        query->n_terms = 0;
+        char *word_saveptr = NULL;
+        for (char *word = strtok_r(line, " \t\r", &word_saveptr); word != NULL && query->n_terms < BENCH_QUERY_TERMS;
+                word = strtok_r(NULL, " \t\r", &word_saveptr)) {
+            int64_t begin, end;
+            stem(word);
+            if (!index_lookup(&index, word, &begin, &end)
+                    || !index_read_postings(&index, begin, end, &query->bytes[query->n_terms])) {
+                continue;
+            }
+            PostingCursor cursor;
+            posting_cursor_open(&cursor, query->bytes[query->n_terms].data, query->bytes[query->n_terms].size, &index.header);
+            query->idf[query->n_terms] = bm25_idf(index.stats.n_docs, cursor.n_postings);
+            posting_cursor_close(&cursor);
+            query->n_terms += 1;
+        }
+        if (query->n_terms > 0) {
+            n_queries += 1;
+        }
+    }
+    if (n_queries == 0) {
+        printf("Error: No query of '%s' has a word in the index\n", path);
+        free(queries);
+        index_close(&index);
+        free(text);
+        return 1;
+    }
+
+    /* Results of the exhaustive run, to check WAND against */
+    ScoredDoc *expected = (ScoredDoc *)malloc((size_t)n_queries * k * sizeof(ScoredDoc));
+    int *n_expected = (int *)malloc(n_queries * sizeof(int));
+    int status = 0;
+    double seconds[2] = { 0, 0 };
+    WandStats stats[2];
+    for (int wand = 0; wand < 2; wand++) {
+        long rounds = 0;
+        double start = time_now();
+        do {
+            stats[wand].n_scored = stats[wand].n_postings = 0;
+            for (int q = 0; q < n_queries; q++) {
+                TopK topk;
+                topk_init(&topk, k);
+                bench_or_query(&queries[q], &index, wand, &topk, &stats[wand]);
+                int n = topk_sort(&topk);
+                if (rounds == 0 && !wand) {
+                    memcpy(expected + (size_t)q * k, topk.heap, n * sizeof(ScoredDoc));
+                    n_expected[q] = n;
+                } else if (rounds == 0 && (n != n_expected[q]
+                        || memcmp(expected + (size_t)q * k, topk.heap, n * sizeof(ScoredDoc)) != 0)) {
+                    status = 1;
+                }
+                topk_free(&topk);
+            }
+            rounds += 1;
+            seconds[wand] = time_now() - start;
+        } while (seconds[wand] < BENCH_MIN_SECONDS);
+        seconds[wand] /= rounds;
+    }
+
+    printf("%d queries, %.0f postings per query, k = %d\n", n_queries, (double)stats[0].n_postings / n_queries, k);
+    printf("%-12s %16s %16s %10s\n", "OR scoring", "docs scored", "ms per query", "speedup");
+    printf("%-12s %16.0f %16.3f %10.2f\n", "exhaustive", (double)stats[0].n_scored / n_queries,
+           seconds[0] * 1000 / n_queries, 1.0);
+    printf("%-12s %16.0f %16.3f %10.2f\n", "block-max", (double)stats[1].n_scored / n_queries,
+           seconds[1] * 1000 / n_queries, seconds[0] / seconds[1]);
+    printf("top %d %s\n", k, status == 0 ? "identical" : "DIFFERENT");
+
+    for (int q = 0; q < n_queries; q++) {
+        for (int t = 0; t < queries[q].n_terms; t++) {
+            index_release_postings(&queries[q].bytes[t]);
+        }
+    }
+    free(expected);
+    free(n_expected);
+    free(queries);
+    index_close(&index);
+    free(text);
+    return status;
+}
+
+/* Two increasing arrays to intersect and what the merge finds in them */
+typedef struct BenchPair {
+    uint32_t *a;
+    int n_a;
+    uint32_t *b;
+    int n_b;
+    int n_matches;
+    uint64_t checksum; /* Of the match positions */
+} BenchPair;
+
+/* A kernel of bench intersect and the SIMD implementation it runs with */
+typedef struct BenchKernel {
+    const char *name;
+    IntersectFunc func;
+    const char *simd; /* NULL for the best the CPU supports */
+} BenchKernel;
+
+static const BenchKernel BENCH_KERNELS[] = {
+    { "merge", intersect_merge, "scalar" },
+    { "gallop", intersect_gallop, "scalar" },
+    { "block", intersect_block, "sse2" },
+    { "block", intersect_block, "avx2" },
+    { "broadcast", intersect_broadcast, "sse2" },
+    { "broadcast", intersect_broadcast, "avx2" },
+    { "adaptive", intersect_adaptive, NULL },
+};
+
+/* Checksum of the positions of the matches */
+static uint64_t bench_match_checksum(const int *match_a, const int *match_b, int n) {
+    uint64_t checksum = n;
+    for (int m = 0; m < n; m++) {
+        checksum = checksum * 1000003 + ((uint64_t)match_a[m] << 32 | (uint32_t)match_b[m]);
+    }
+    return checksum;
+}
+
+static int bench_cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Make a synthetic pair: b has n_a * ratio increasing values, a has about
+ * n_a values, half of them taken from b
+ *
+ * @param pair Filled with the arrays
+ * @param n_a The length of the shorter array before duplicates are dropped
+ * @param ratio The ratio of the lengths
+ */
+static void bench_synthetic_pair(BenchPair *pair, int n_a, int ratio) {
+    pair->n_b = n_a * ratio;
+    pair->b = (uint32_t *)malloc(pair->n_b * sizeof(uint32_t));
+    uint32_t value = 0;
+    for (int j = 0; j < pair->n_b; j++) {
+        value += 1 + bench_rand_mean(8);
+        pair->b[j] = value;
+    }
+    pair->a = (uint32_t *)malloc(n_a * sizeof(uint32_t));
+    for (int i = 0; i < n_a; i++) {
+        pair->a[i] = bench_rand() % 2 ? pair->b[bench_rand() % pair->n_b] : bench_rand() % (value + 1);
+    }
+    qsort(pair->a, n_a, sizeof(uint32_t), bench_cmp_u32);
+    pair->n_a = 0;
+    for (int i = 0; i < n_a; i++) {
+        if (pair->n_a == 0 || pair->a[pair->n_a - 1] != pair->a[i]) {
+            pair->a[pair->n_a++] = pair->a[i];
+        }
+    }
+}
+
+/**
+ * Time every kernel on a set of pairs and check their matches against the merge
+ *
+ * @param label The name of the data set
+ * @param pairs The pairs
+ * @param n_pairs The number of pairs
+ * @return 0 if every kernel found the same matches, 1 otherwise
+ */
+static int bench_intersect_pairs(const char *label, BenchPair *pairs, int n_pairs) {
+    const char *best = intersect_simd_name();
+    long n_values = 0;
+    long n_short = 0;
+    int capacity = 0;
+    for (int p = 0; p < n_pairs; p++) {
+        n_values += pairs[p].n_a + pairs[p].n_b;
+        n_short += pairs[p].n_a;
+        if (pairs[p].n_a > capacity) capacity = pairs[p].n_a;
+    }
+    int *match_a = (int *)malloc((capacity + 1) * sizeof(int));
+    int *match_b = (int *)malloc((capacity + 1) * sizeof(int));
+    for (int p = 0; p < n_pairs; p++) {
+        pairs[p].n_matches = intersect_merge(pairs[p].a, pairs[p].n_a, pairs[p].b, pairs[p].n_b, match_a, match_b);
+        pairs[p].checksum = bench_match_checksum(match_a, match_b, pairs[p].n_matches);
+    }
+
+    int status = 0;
+    for (size_t k = 0; k < sizeof(BENCH_KERNELS) / sizeof(BENCH_KERNELS[0]); k++) {
+        const BenchKernel *kernel = &BENCH_KERNELS[k];
+        const char *simd = kernel->simd != NULL ? kernel->simd : best;
+        if (!intersect_set_simd(simd)) continue;
+        bool same = true;
+        long rounds = 0;
+        double start = time_now();
+        double elapsed = 0;
+        do {
+            for (int p = 0; p < n_pairs; p++) {
+                int n = kernel->func(pairs[p].a, pairs[p].n_a, pairs[p].b, pairs[p].n_b, match_a, match_b);
+                if (rounds == 0 && (n != pairs[p].n_matches
+                        || bench_match_checksum(match_a, match_b, n) != pairs[p].checksum)) {
+                    same = false;
+                }
+            }
+            rounds += 1;
+            elapsed = time_now() - start;
+        } while (elapsed < BENCH_MIN_SECONDS);
+        if (!same) status = 1;
+        printf("%-24s %-10s %-8s %14.1f %16.2f%s\n", label, kernel->name, simd,
+               (double)n_values * rounds / elapsed / 1e6, elapsed * 1e9 / rounds / n_short,
+               same ? "" : " MISMATCH");
+    }
+    intersect_set_simd(best);
+    free(match_a);
+    free(match_b);
+    return status;
+}
+
+/* Decode the posting list of dictionary entry w, returns its doc_ids */
+static uint32_t* bench_decode_entry(IndexReader *index, int w, int *n) {
+    char word[MAX_KEY_SIZE + 1];
+    int64_t begin, end;
+    PostingBytes bytes;
+    PostingCursor cursor;
+    index_entry(index, w, word, sizeof(word), &begin, &end);
+    index_read_postings(index, begin, end, &bytes);
+    posting_cursor_open(&cursor, bytes.data, bytes.size, &index->header);
+    uint32_t *docs = (uint32_t *)malloc((cursor.n_postings + 1) * sizeof(uint32_t));
+    uint32_t *freqs = (uint32_t *)malloc((cursor.n_postings + 1) * sizeof(uint32_t));
+    *n = posting_cursor_decode_into(&cursor, docs, freqs);
+    free(freqs);
+    posting_cursor_close(&cursor);
+    index_release_postings(&bytes);
+    return docs;
+}
+
+/**
+ * Time the intersection kernels on synthetic arrays and on pairs of
+ * posting lists of the index in data/, by ratio of the list lengths
+ */
+static int bench_intersect(void) {
+    const int ratios[] = { 1, 4, 16, 64, 256, 1024 };
+    int n_ratios = sizeof(ratios) / sizeof(ratios[0]);
+    int status = 0;
+    char label[64];
+
+    printf("best SIMD: %s\n", intersect_simd_name());
+    printf("%-24s %-10s %-8s %14s %16s\n", "data set", "kernel", "simd", "M values/sec", "ns/short value");
+    for (int r = 0; r < n_ratios; r++) {
+        BenchPair pair;
+        bench_synthetic_pair(&pair, BENCH_INTERSECT_SHORT, ratios[r]);
+        snprintf(label, sizeof(label), "synthetic 1:%d", ratios[r]);
+        status |= bench_intersect_pairs(label, &pair, 1);
+        free(pair.a);
+        free(pair.b);
+    }
+
+    IndexReader index;
+    if (!index_open(&index, true)) {
+        index_close(&index);
+        return 1;
+    }
+    /* Document frequency of every word, in increasing order */
+    int n_words = index.dict_size;
+    bench_df = (long *)malloc(n_words * sizeof(long));
+    int *order = (int *)malloc(n_words * sizeof(int));
+    for (int w = 0; w < n_words; w++) {
+        char word[MAX_KEY_SIZE + 1];
+        int64_t begin, end;
+        PostingBytes bytes;
+        PostingCursor cursor;
+        index_entry(&index, w, word, sizeof(word), &begin, &end);
+        index_read_postings(&index, begin, end, &bytes);
+        posting_cursor_open(&cursor, bytes.data, bytes.size, &index.header);
+        bench_df[w] = cursor.n_postings;
+        order[w] = w;
+        posting_cursor_close(&cursor);
+        index_release_postings(&bytes);
+    }
+    qsort(order, n_words, sizeof(int), bench_cmp_df);
+    for (int i = 0; i < n_words / 2; i++) {
+        int swap = order[i];
+        order[i] = order[n_words - 1 - i];
+        order[n_words - 1 - i] = swap;
+    }
+    int first = 0; /* First word long enough to pair */
+    while (first < n_words && bench_df[order[first]] < BENCH_INTERSECT_MIN_DF) first++;
+
+    for (int r = 0; r < n_ratios && first < n_words; r++) {
+        /* Random short words, each with the word nearest ratio times as frequent */
+        BenchPair pairs[BENCH_INTERSECT_PAIRS];
+        int n_pairs = 0;
+        for (int attempt = 0; attempt < 100 * BENCH_INTERSECT_PAIRS && n_pairs < BENCH_INTERSECT_PAIRS; attempt++) {
+            int s = first + bench_rand() % (n_words - first);
+            long target = bench_df[order[s]] * ratios[r];
+            if (target > bench_df[order[n_words - 1]]) continue;
+            int low = s + 1, high = n_words - 1;
+            while (low < high) {
+                int mid = (low + high) / 2;
+                if (bench_df[order[mid]] < target) low = mid + 1; else high = mid;
+            }
+            if (low >= n_words || bench_df[order[low]] > 2 * target) continue;
+            pairs[n_pairs].a = bench_decode_entry(&index, order[s], &pairs[n_pairs].n_a);
+            pairs[n_pairs].b = bench_decode_entry(&index, order[low], &pairs[n_pairs].n_b);
+            n_pairs += 1;
+        }
+        if (n_pairs == 0) continue;
+        snprintf(label, sizeof(label), "wsj 1:%d (%d pairs)", ratios[r], n_pairs);
+        status |= bench_intersect_pairs(label, pairs, n_pairs);
+        for (int p = 0; p < n_pairs; p++) {
+            free(pairs[p].a);
+            free(pairs[p].b);
+        }
+    }
+    printf("matches %s\n", status == 0 ? "identical" : "DIFFERENT");
+
+    free(order);
+    free(bench_df);
+    index_close(&index);
+    return status;
+}
+
+/* Postings of term t in the synthetic index: every BENCH_LARGE_TERMS-th document */
+static int bench_large_postings(int t, int *docs, int *freqs) {
+    int n = 0;
+    for (int d = t; d < BENCH_LARGE_DOCS; d += BENCH_LARGE_TERMS) {
+        docs[n] = d;
+        freqs[n] = 1 + d % 3;
+        n += 1;
+    }
+    return n;
+}
+
+/**
+ * Write the synthetic index into data/. The middle term's posting list is
+ * a hole of gap bytes, so the terms after it start past the gap.
+ */
+static bool bench_large_write(int64_t gap) {
+    DocIdWriter ids;
+    if (!doc_id_writer_open(&ids, DOC_IDS_FILE)) {
+        return false;
+    }
+    for (int d = 0; d < BENCH_LARGE_DOCS; d++) {
+        char id[32];
+        snprintf(id, sizeof(id), "SYN-%d", d);
+        doc_id_writer_add(&ids, id);
+    }
+    doc_id_writer_close(&ids);
+
+    FILE *fp_post = fopen(POSTING_FILE, "wb");
+    FILE *fp_dict = fopen(DICT_FILE, "wb");
+    if (fp_post == NULL || fp_dict == NULL) {
+        printf("Error: Couldn't create the synthetic index\n");
+        if (fp_post) fclose(fp_post);
+        if (fp_dict) fclose(fp_dict);
+        return false;
+    }
+    IndexHeader header = { INDEX_VERSION_FRONT_CODED, POSTING_BLOCK_SIZE, CODEC_VBYTE, 0 };
+    index_header_write(fp_dict, &header);
+    DictWriter dict;
+    dict_writer_open(&dict, fp_dict, MAX_KEY_SIZE + OFFSET_SIZE);
+
+    float *norm = (float *)malloc(BENCH_LARGE_DOCS * sizeof(float));
+    for (int d = 0; d < BENCH_LARGE_DOCS; d++) {
+        norm[d] = 1;
+    }
+    int docs[BENCH_LARGE_DOCS], freqs[BENCH_LARGE_DOCS];
+    ByteBuffer encoded = {0};
+    int64_t offset = 0;
+    bool ok = true;
+    for (int t = 0; t < BENCH_LARGE_TERMS; t++) {
+        char term[32];
+        int length = snprintf(term, sizeof(term), "term%04d", t);
+        dict_writer_add(&dict, term, length, offset);
+        if (t == BENCH_LARGE_TERMS / 2) {
+            /* Seeking past the end leaves a hole */
+            offset += gap;
+            ok = ok && fseeko(fp_post, offset, SEEK_SET) == 0;
+            continue;
+        }
+        int n = bench_large_postings(t, docs, freqs);
+        encoded.size = 0;
+        encode_posting_blocks(docs, freqs, n, &header, norm, &encoded);
+        ok = ok && fwrite(encoded.data, 1, encoded.size, fp_post) == encoded.size;
+        offset += encoded.size;
+    }
+    dict_writer_close(&dict);
+    bytebuffer_free(&encoded);
+    free(norm);
+    ok = fclose(fp_post) == 0 && ok;
+    ok = fclose(fp_dict) == 0 && ok;
+    if (!ok) {
+        printf("Error: Couldn't write the synthetic index\n");
+    }
+    return ok;
+}
+
+/**
+ * Open the synthetic index and check every term against its postings
+ *
+ * @return The number of terms that don't match
+ */
+static int bench_large_check(bool use_mmap, int64_t gap) {
+    IndexReader index;
+    if (!index_open(&index, use_mmap)) {
+        index_close(&index);
+        return BENCH_LARGE_TERMS;
+    }
+    int errors = index.dict_size != BENCH_LARGE_TERMS;
+    int64_t last_begin = 0;
+    int docs[BENCH_LARGE_DOCS], freqs[BENCH_LARGE_DOCS];
+    for (int t = 0; t < BENCH_LARGE_TERMS; t++) {
+        char term[32], entry[32];
+        snprintf(term, sizeof(term), "term%04d", t);
+        int64_t begin, end, entry_begin, entry_end;
+        if (!index_lookup(&index, term, &begin, &end)
+                || !index_entry(&index, t, entry, sizeof(entry), &entry_begin, &entry_end)
+                || strcmp(entry, term) != 0 || entry_begin != begin || entry_end != end) {
+            errors += 1;
+            continue;
+        }
+        if (t == BENCH_LARGE_TERMS / 2) {
+            /* The hole, too long to be read as one list */
+            PostingBytes bytes;
+            errors += end - begin != gap || index_read_postings(&index, begin, end, &bytes);
+            continue;
+        }
+
+        PostingBytes bytes;
+        PostingCursor cursor;
+        if (!index_read_postings(&index, begin, end, &bytes)) {
+            errors += 1;
+            continue;
+        }
+        if (!posting_cursor_open(&cursor, bytes.data, bytes.size, &index.header)) {
+            errors += 1;
+            index_release_postings(&bytes);
+            continue;
+        }
+        PostingList *list = posting_cursor_decode_all(&cursor);
+        int n = bench_large_postings(t, docs, freqs);
+        bool same = list->size == n;
+        for (int i = 0; same && i < n; i++) {
+            same = list->postings[i].doc_id == docs[i] && list->postings[i].freq == freqs[i];
+        }
+        errors += !same;
+        last_begin = begin;
+        posting_list_free(list);
+        posting_cursor_close(&cursor);
+        index_release_postings(&bytes);
+    }
+    printf("%-8s %14lld %14lld %10d\n", use_mmap ? "mmap" : "pread", (long long)index.posting_size,
+           (long long)last_begin, errors);
+    index_close(&index);
+    return errors;
+}
+
+/**
+ * Build and check a synthetic index past 4 GB in dir
+ *
+ * @param dir The directory to build in, created if missing
+ * @param gigabytes Size of the posting file
+ */
+static int bench_large(const char *dir, int gigabytes) {
+    if ((mkdir(dir, 0755) == -1 && errno != EEXIST) || chdir(dir) == -1
+            || (mkdir("data", 0755) == -1 && errno != EEXIST)) {
+        printf("Error: Couldn't create '%s/data'\n", dir);
+        return 1;
+    }
+    int64_t gap = (int64_t)gigabytes << 30;
+    int status = 1;
+    if (bench_large_write(gap)) {
+        printf("%d terms, %d documents, a hole of %d GB in the posting file\n",
+               BENCH_LARGE_TERMS, BENCH_LARGE_DOCS, gigabytes);
+        printf("%-8s %14s %14s %10s\n", "reader", "posting bytes", "last list at", "errors");
+        int errors = bench_large_check(true, gap) + bench_large_check(false, gap);
+        printf("%s\n", errors == 0 ? "all terms found and decoded" : "MISMATCH");
+        status = errors != 0;
+    }
+    remove(POSTING_FILE);
+    remove(DICT_FILE);
+    remove(DOC_IDS_FILE);
+    rmdir("data");
+    return status;
+}
+
+/**
+ * Main function, runs the named benchmark
+ */
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        printf("Usage: %s codecs|corpus|vocab <tokens_file>|tokenizer <xml_file>|stemmer <xml_file>|topk [k]"
+               "|wand <query_log> [k]|intersect|large <dir> [GB]\n", argv[0]);
+        return 1;
+    }
+
+    if (strcmp(argv[1], "codecs") == 0) {
+        return bench_codecs();
+    }
+
+    if (strcmp(argv[1], "corpus") == 0) {
+        return bench_corpus();
+    }
+
+    if (argc > 2 && strcmp(argv[1], "vocab") == 0) {
+        return bench_vocab(argv[2]);
+    }
+
+    if (argc > 2 && strcmp(argv[1], "tokenizer") == 0) {
+        return bench_tokenizer(argv[2]);
+    }
+
+    if (argc > 2 && strcmp(argv[1], "stemmer") == 0) {
+        return bench_stemmer(argv[2]);
+    }
+
+    if (strcmp(argv[1], "topk") == 0) {
+        int k = argc > 2 ? atoi(argv[2]) : 10;
+        return bench_topk(k > 0 ? k : 10);
+    }
+
+    if (argc > 2 && strcmp(argv[1], "wand") == 0) {
+        int k = argc > 3 ? atoi(argv[3]) : 10;
+        return bench_wand(argv[2], k > 0 ? k : 10);
+    }
+
+    if (strcmp(argv[1], "intersect") == 0) {
+        return bench_intersect();
+    }
+
+    if (argc > 2 && strcmp(argv[1], "large") == 0) {
+        int gigabytes = argc > 3 ? atoi(argv[3]) : 5;
+        return bench_large(argv[2], gigabytes > 0 ? gigabytes : 5);
+    }
+
+    printf("Error: Unknown benchmark '%s'\n", argv[1]);
+    return 1;
+}
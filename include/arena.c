@@ -0,0 +1,73 @@
+/**
+ * @file arena.c
+ * @brief Arena (bump) allocator
+ */
+
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define ARENA_ALIGNMENT 8 /* Enough for the pointers and ints stored in arenas */
+
+/* Create an arena without any blocks yet */
+Arena* arena_create(size_t block_size) {
+    Arena *arena = (Arena *)calloc(1, sizeof(Arena));
+    if (arena == NULL) {
+        return NULL;
+    }
+    arena->block_size = block_size ? block_size : ARENA_BLOCK_SIZE;
+    return arena;
+}
+
+/* Bump allocate from the newest block, adding a block when it is full */
+void* arena_alloc(Arena *arena, size_t size) {
+    size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+    ArenaBlock *block = arena->head;
+    if (block == NULL || block->used + size > block->size) {
+        /* Objects larger than a block get a block of their own */
+        size_t block_size = size > arena->block_size ? size : arena->block_size;
+        block = (ArenaBlock *)malloc(sizeof(ArenaBlock) + block_size);
+        if (block == NULL) {
+            printf("Error: Out of memory\n");
+            exit(1);
+        }
+        block->size = block_size;
+        block->used = 0;
+        block->next = arena->head;
+        arena->head = block;
+        arena->bytes_reserved += sizeof(ArenaBlock) + block_size;
+    }
+
+    void *memory = block->data + block->used;
+    block->used += size;
+    arena->n_allocations += 1;
+    arena->bytes_used += size;
+    return memory;
+}
+
+/* Copy a string into the arena */
+char* arena_strdup(Arena *arena, const char *str) {
+    size_t length = strlen(str) + 1;
+    char *copy = (char *)arena_alloc(arena, length);
+    memcpy(copy, str, length);
+    return copy;
+}
+
+/* Free every block at once */
+void arena_destroy(Arena *arena) {
+    if (arena == NULL) return;
+    ArenaBlock *block = arena->head;
+    while (block != NULL) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    free(arena);
+}
+
+/* Print the counters */
+void arena_report(const Arena *arena, const char *label, FILE *out) {
+    fprintf(out, "%s: %zu allocations, %.1f MB used, %.1f MB reserved\n", label, arena->n_allocations,
+            arena->bytes_used / (1024.0 * 1024.0), arena->bytes_reserved / (1024.0 * 1024.0));
+}
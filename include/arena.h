@@ -0,0 +1,81 @@
+/**
+ * @file arena.h
+ * @brief Arena (bump) allocator for many small objects freed together.
+ *
+ * Memory is carved from large blocks by bumping a pointer, there is no
+ * per-object free. Everything allocated from an arena is released at once
+ * by arena_destroy.
+ *
+ * @author Ubaada
+ * @date 01-04-2024
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#define ARENA_BLOCK_SIZE (1 << 20) /* Default block size, 1 MB */
+
+/* A block of memory objects are carved from */
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    size_t size;
+    size_t used;
+    unsigned char data[];
+} ArenaBlock;
+
+/* The arena, a list of blocks with the newest first */
+typedef struct Arena {
+    ArenaBlock *head;
+    size_t block_size;
+    size_t n_allocations; /* Objects allocated */
+    size_t bytes_used; /* Bytes handed out, including alignment padding */
+    size_t bytes_reserved; /* Bytes of all blocks */
+} Arena;
+
+/**
+ * Create an empty arena
+ *
+ * @param block_size The size of the blocks to allocate, 0 for the default
+ * @return The arena, NULL if out of memory
+ */
+Arena* arena_create(size_t block_size);
+
+/**
+ * Allocate memory from the arena, aligned for pointers and integers.
+ * Exits the program if out of memory.
+ *
+ * @param arena The arena
+ * @param size The number of bytes
+ * @return The memory, valid until the arena is destroyed
+ */
+void* arena_alloc(Arena *arena, size_t size);
+
+/**
+ * Copy a string into the arena
+ *
+ * @param arena The arena
+ * @param str The string to copy
+ * @return The copy
+ */
+char* arena_strdup(Arena *arena, const char *str);
+
+/**
+ * Free all blocks and the arena itself
+ *
+ * @param arena The arena, may be NULL
+ */
+void arena_destroy(Arena *arena);
+
+/**
+ * Print the allocation count and memory use of an arena
+ *
+ * @param arena The arena
+ * @param label A label printed in front of the report
+ * @param out The stream to print to
+ */
+void arena_report(const Arena *arena, const char *label, FILE *out);
+
+#endif // ARENA_H
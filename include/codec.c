@@ -0,0 +1,432 @@
+/**
+ * @file codec.c
+ * @brief Variable byte, Stream VByte and PFor integer codecs
+ */
+
+#include "codec.h"
+#include <string.h>
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CODEC_X86 1
+#include <immintrin.h>
+#endif
+
+typedef const unsigned char* (*DecodeFunc)(const unsigned char *, const unsigned char *, int, uint32_t *);
+
+#define PFOR_CHUNK 128 /* Integers per bit-packed chunk */
+#define PFOR_LANES 4 /* Interleaved 32-bit lanes, one SSE2 register */
+
+static const char *CODEC_NAMES[CODEC_COUNT] = { "vbyte", "streamvbyte", "pfor" };
+
+/* Stream VByte tables indexed by control byte */
+static unsigned char svb_shuffle[256][16]; /* Data byte to output byte shuffle */
+static unsigned char svb_length[256]; /* Data bytes used by the four integers */
+static bool svb_tables_ready = false;
+
+static DecodeFunc svb_decode = NULL;
+static const char *svb_decode_name = "scalar";
+static pthread_once_t svb_decoder_once = PTHREAD_ONCE_INIT; /* Searcher threads decode concurrently */
+
+/* Name of a codec */
+const char* codec_name(int codec) {
+    if (codec < 0 || codec >= CODEC_COUNT) {
+        return "unknown";
+    }
+    return CODEC_NAMES[codec];
+}
+
+/* Codec by name */
+int codec_from_name(const char *name) {
+    for (int i = 0; i < CODEC_COUNT; i++) {
+        if (strcmp(name, CODEC_NAMES[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* Build the shuffle and length tables once */
+static void svb_init_tables(void) {
+    if (svb_tables_ready) return;
+    for (int c = 0; c < 256; c++) {
+        int byte = 0;
+        for (int k = 0; k < 4; k++) {
+            int length = ((c >> (2 * k)) & 3) + 1;
+            for (int j = 0; j < 4; j++) {
+                /* 0xFF zeroes the output byte in pshufb */
+                svb_shuffle[c][4 * k + j] = j < length ? byte + j : 0xFF;
+            }
+            byte += length;
+        }
+        svb_length[c] = byte;
+    }
+    svb_tables_ready = true;
+}
+
+/* Length in bytes (1 to 4) of a value */
+static int svb_value_length(uint32_t v) {
+    if (v < (1u << 8)) return 1;
+    if (v < (1u << 16)) return 2;
+    if (v < (1u << 24)) return 3;
+    return 4;
+}
+
+/* Control bytes for all values, followed by the data bytes */
+static void svb_encode(const uint32_t *values, int n, ByteBuffer *out) {
+    int n_ctrl = (n + 3) / 4;
+    bytebuffer_reserve(out, n_ctrl + 4 * (size_t)n);
+    unsigned char *ctrl = out->data + out->size;
+    unsigned char *data = ctrl + n_ctrl;
+    memset(ctrl, 0, n_ctrl);
+
+    for (int i = 0; i < n; i++) {
+        uint32_t v = values[i];
+        int length = svb_value_length(v);
+        ctrl[i >> 2] |= (length - 1) << ((i & 3) * 2);
+        for (int j = 0; j < length; j++) {
+            *data++ = (v >> (8 * j)) & 0xFF;
+        }
+    }
+    out->size = data - out->data;
+}
+
+/*
+ * A list whose control or data bytes do not fit before end is corrupt,
+ * values [from, n) are zeroed and decoding stops at end.
+ */
+static const unsigned char* svb_corrupt(const unsigned char *end, int from, int n, uint32_t *out) {
+    memset(out + from, 0, (size_t)(n - from) * sizeof(uint32_t));
+    return end;
+}
+
+/* Decode values [from, n) one at a time */
+static const unsigned char* svb_decode_tail(const unsigned char *ctrl, const unsigned char *data, const unsigned char *end, int from, int n, uint32_t *out) {
+    for (int i = from; i < n; i++) {
+        int length = ((ctrl[i >> 2] >> ((i & 3) * 2)) & 3) + 1;
+        if (end - data < length) {
+            return svb_corrupt(end, i, n, out);
+        }
+        uint32_t v = 0;
+        for (int j = 0; j < length; j++) {
+            v |= (uint32_t)data[j] << (8 * j);
+        }
+        data += length;
+        out[i] = v;
+    }
+    return data;
+}
+
+/* Portable decoder */
+static const unsigned char* svb_decode_scalar(const unsigned char *in, const unsigned char *end, int n, uint32_t *out) {
+    if (end - in < (n + 3) / 4) {
+        return svb_corrupt(end, 0, n, out);
+    }
+    return svb_decode_tail(in, in + (n + 3) / 4, end, 0, n, out);
+}
+
+#ifdef CODEC_X86
+/* Four integers per control byte with one pshufb */
+__attribute__((target("ssse3")))
+static const unsigned char* svb_decode_ssse3(const unsigned char *in, const unsigned char *end, int n, uint32_t *out) {
+    if (end - in < (n + 3) / 4) {
+        return svb_corrupt(end, 0, n, out);
+    }
+    const unsigned char *ctrl = in;
+    const unsigned char *data = in + (n + 3) / 4;
+    int i = 0;
+    /* Each step loads 16 data bytes, stop while that stays readable */
+    for (; i + 4 <= n && data + 16 <= end; i += 4) {
+        unsigned char c = ctrl[i >> 2];
+        __m128i bytes = _mm_loadu_si128((const __m128i *)data);
+        __m128i shuffle = _mm_loadu_si128((const __m128i *)svb_shuffle[c]);
+        _mm_storeu_si128((__m128i *)(out + i), _mm_shuffle_epi8(bytes, shuffle));
+        data += svb_length[c];
+    }
+    return svb_decode_tail(ctrl, data, end, i, n, out);
+}
+
+/* Eight integers per two control bytes, one 128-bit lane each */
+__attribute__((target("avx2")))
+static const unsigned char* svb_decode_avx2(const unsigned char *in, const unsigned char *end, int n, uint32_t *out) {
+    if (end - in < (n + 3) / 4) {
+        return svb_corrupt(end, 0, n, out);
+    }
+    const unsigned char *ctrl = in;
+    const unsigned char *data = in + (n + 3) / 4;
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        unsigned char c0 = ctrl[i >> 2];
+        unsigned char c1 = ctrl[(i >> 2) + 1];
+        if (data + svb_length[c0] + 16 > end) {
+            break;
+        }
+        __m128i low = _mm_loadu_si128((const __m128i *)data);
+        __m128i high = _mm_loadu_si128((const __m128i *)(data + svb_length[c0]));
+        __m256i bytes = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+        __m256i shuffle = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)svb_shuffle[c0])),
+                _mm_loadu_si128((const __m128i *)svb_shuffle[c1]), 1);
+        _mm256_storeu_si256((__m256i *)(out + i), _mm256_shuffle_epi8(bytes, shuffle));
+        data += svb_length[c0] + svb_length[c1];
+    }
+    return svb_decode_tail(ctrl, data, end, i, n, out);
+}
+#endif
+
+/* Number of bits needed to store v */
+static int pfor_bits(uint32_t v) {
+    return v == 0 ? 0 : 32 - __builtin_clz(v);
+}
+
+/* Bytes used by the variable byte encoding of v */
+static int vbyte_length(uint32_t v) {
+    int length = 1;
+    while (v >= 128) {
+        v >>= 7;
+        length += 1;
+    }
+    return length;
+}
+
+/*
+ * One chunk of PFOR_CHUNK integers:
+ *     byte b, byte n_exceptions,
+ *     4 * b packed 32-bit words (little-endian, lane interleaved),
+ *     n_exceptions positions, n_exceptions vbyte high parts (value >> b)
+ */
+static void pfor_encode_chunk(const uint32_t *values, ByteBuffer *out) {
+    /* Pick b by the size of the chunk it produces */
+    int best_b = 32;
+    long best_cost = -1;
+    for (int b = 32; b >= 0; b--) {
+        long cost = 16L * b;
+        for (int i = 0; i < PFOR_CHUNK; i++) {
+            if (pfor_bits(values[i]) > b) {
+                /* Position byte plus the vbyte high part */
+                cost += 1 + vbyte_length(values[i] >> b);
+            }
+        }
+        if (best_cost == -1 || cost <= best_cost) {
+            best_cost = cost;
+            best_b = b;
+        }
+    }
+
+    int b = best_b;
+    uint32_t mask = b == 32 ? 0xFFFFFFFFu : (1u << b) - 1;
+    unsigned char exceptions[PFOR_CHUNK];
+    int n_exceptions = 0;
+    for (int i = 0; i < PFOR_CHUNK; i++) {
+        if (pfor_bits(values[i]) > b) {
+            exceptions[n_exceptions++] = i;
+        }
+    }
+
+    bytebuffer_reserve(out, 2 + 16 * (size_t)b + n_exceptions * 6);
+    out->data[out->size++] = b;
+    out->data[out->size++] = n_exceptions;
+
+    /* Value 4 * j + lane goes to bit j * b of that lane's bit stream */
+    uint32_t words[PFOR_LANES * 32] = {0};
+    for (int lane = 0; lane < PFOR_LANES; lane++) {
+        for (int j = 0; j < PFOR_CHUNK / PFOR_LANES && b > 0; j++) {
+            uint32_t v = values[PFOR_LANES * j + lane] & mask;
+            int position = j * b;
+            int word = position >> 5;
+            int shift = position & 31;
+            words[PFOR_LANES * word + lane] |= v << shift;
+            if (shift + b > 32) {
+                words[PFOR_LANES * (word + 1) + lane] |= v >> (32 - shift);
+            }
+        }
+    }
+    for (int w = 0; w < PFOR_LANES * b; w++) {
+        for (int k = 0; k < 4; k++) {
+            out->data[out->size++] = (words[w] >> (8 * k)) & 0xFF;
+        }
+    }
+
+    for (int e = 0; e < n_exceptions; e++) {
+        out->data[out->size++] = exceptions[e];
+    }
+    for (int e = 0; e < n_exceptions; e++) {
+        bytebuffer_put_vbyte(out, (int)(values[exceptions[e]] >> b));
+    }
+}
+
+/* Full chunks bit-packed, the rest vbyte */
+static void pfor_encode(const uint32_t *values, int n, ByteBuffer *out) {
+    int i = 0;
+    for (; i + PFOR_CHUNK <= n; i += PFOR_CHUNK) {
+        pfor_encode_chunk(values + i, out);
+    }
+    for (; i < n; i++) {
+        bytebuffer_put_vbyte(out, (int)values[i]);
+    }
+}
+
+/* Read a little-endian 32-bit word */
+static uint32_t load_le32(const unsigned char *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* Unpack the 4 interleaved lanes one value at a time */
+static void pfor_unpack_scalar(const unsigned char *packed, int b, uint32_t *out) {
+    uint32_t mask = b == 32 ? 0xFFFFFFFFu : (1u << b) - 1;
+    for (int j = 0; j < PFOR_CHUNK / PFOR_LANES; j++) {
+        int position = j * b;
+        int word = position >> 5;
+        int shift = position & 31;
+        for (int lane = 0; lane < PFOR_LANES; lane++) {
+            uint32_t v = load_le32(packed + 4 * (PFOR_LANES * word + lane)) >> shift;
+            if (shift + b > 32) {
+                v |= load_le32(packed + 4 * (PFOR_LANES * (word + 1) + lane)) << (32 - shift);
+            }
+            out[PFOR_LANES * j + lane] = v & mask;
+        }
+    }
+}
+
+#if defined(__SSE2__) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+/* Unpack 4 values (one per lane) per shift/mask */
+static void pfor_unpack_sse2(const unsigned char *packed, int b, uint32_t *out) {
+    const __m128i *words = (const __m128i *)packed;
+    __m128i mask = _mm_set1_epi32(b == 32 ? -1 : (int)((1u << b) - 1));
+    for (int j = 0; j < PFOR_CHUNK / PFOR_LANES; j++) {
+        int position = j * b;
+        int word = position >> 5;
+        int shift = position & 31;
+        __m128i v = _mm_srl_epi32(_mm_loadu_si128(words + word), _mm_cvtsi32_si128(shift));
+        if (shift + b > 32) {
+            __m128i next = _mm_loadu_si128(words + word + 1);
+            v = _mm_or_si128(v, _mm_sll_epi32(next, _mm_cvtsi32_si128(32 - shift)));
+        }
+        _mm_storeu_si128((__m128i *)(out + PFOR_LANES * j), _mm_and_si128(v, mask));
+    }
+}
+#define PFOR_UNPACK_SIMD pfor_unpack_sse2
+#else
+#define PFOR_UNPACK_SIMD pfor_unpack_scalar
+#endif
+
+/* SSE2 is part of x86-64, so the SIMD unpack needs no runtime check */
+static void (*pfor_unpack)(const unsigned char *, int, uint32_t *) = PFOR_UNPACK_SIMD;
+
+/*
+ * Unpack full chunks, patch the exceptions, vbyte decode the rest.
+ * A chunk whose width or sizes do not fit before end is corrupt, its
+ * values and the rest are zeroed and decoding stops at end.
+ */
+static const unsigned char* pfor_decode(const unsigned char *in, const unsigned char *end, int n, uint32_t *out) {
+    int i = 0;
+    for (; i + PFOR_CHUNK <= n; i += PFOR_CHUNK) {
+        if (end - in < 2 || in[0] > 32 || in[1] > PFOR_CHUNK ||
+                end - in - 2 < 16 * in[0] + in[1]) {
+            memset(out + i, 0, (size_t)(n - i) * sizeof(uint32_t));
+            return end;
+        }
+        int b = in[0];
+        int n_exceptions = in[1];
+        in += 2;
+        if (b == 0) {
+            memset(out + i, 0, PFOR_CHUNK * sizeof(uint32_t));
+        } else {
+            pfor_unpack(in, b, out + i);
+        }
+        in += 16 * b;
+
+        const unsigned char *positions = in;
+        in += n_exceptions;
+        for (int e = 0; e < n_exceptions; e++) {
+            uint32_t high = (uint32_t)vbyte_get(&in, end);
+            if (positions[e] < PFOR_CHUNK && b < 32) {
+                out[i + positions[e]] |= high << b;
+            }
+        }
+    }
+    for (; i < n; i++) {
+        out[i] = (uint32_t)vbyte_get(&in, end);
+    }
+    return in;
+}
+
+/* Pick the best decoder the CPU supports */
+static void svb_select_decoder(void) {
+    svb_init_tables();
+    svb_decode = svb_decode_scalar;
+    svb_decode_name = "scalar";
+#ifdef CODEC_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        svb_decode = svb_decode_avx2;
+        svb_decode_name = "avx2";
+    } else if (__builtin_cpu_supports("ssse3")) {
+        svb_decode = svb_decode_ssse3;
+        svb_decode_name = "ssse3";
+    }
+#endif
+}
+
+/* Force a decoder, for benchmarking */
+bool codec_set_decoder(const char *name) {
+    pthread_once(&svb_decoder_once, svb_select_decoder);
+    if (strcmp(name, "scalar") == 0) {
+        svb_decode = svb_decode_scalar;
+        svb_decode_name = "scalar";
+        pfor_unpack = pfor_unpack_scalar;
+        return true;
+    }
+#ifdef CODEC_X86
+    __builtin_cpu_init();
+    if (strcmp(name, "ssse3") == 0 && __builtin_cpu_supports("ssse3")) {
+        svb_decode = svb_decode_ssse3;
+        svb_decode_name = "ssse3";
+        pfor_unpack = PFOR_UNPACK_SIMD;
+        return true;
+    }
+    if (strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2")) {
+        svb_decode = svb_decode_avx2;
+        svb_decode_name = "avx2";
+        pfor_unpack = PFOR_UNPACK_SIMD;
+        return true;
+    }
+#endif
+    return false;
+}
+
+/* Name of the decoder in use */
+const char* codec_decoder_name(void) {
+    pthread_once(&svb_decoder_once, svb_select_decoder);
+    return svb_decode_name;
+}
+
+/* Encode with the given codec */
+void codec_encode(int codec, const uint32_t *values, int n, ByteBuffer *out) {
+    if (codec == CODEC_STREAMVBYTE) {
+        svb_encode(values, n, out);
+        return;
+    }
+    if (codec == CODEC_PFOR) {
+        pfor_encode(values, n, out);
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        bytebuffer_put_vbyte(out, (int)values[i]);
+    }
+}
+
+/* Decode with the given codec */
+const unsigned char* codec_decode(int codec, const unsigned char *in, const unsigned char *end, int n, uint32_t *out) {
+    if (codec == CODEC_STREAMVBYTE) {
+        pthread_once(&svb_decoder_once, svb_select_decoder);
+        return svb_decode(in, end, n, out);
+    }
+    if (codec == CODEC_PFOR) {
+        return pfor_decode(in, end, n, out);
+    }
+    for (int i = 0; i < n; i++) {
+        out[i] = (uint32_t)vbyte_get(&in, end);
+    }
+    return in;
+}
@@ -0,0 +1,90 @@
+/**
+ * @file codec.h
+ * @brief Integer codecs for the doc_id deltas and freqs of posting blocks.
+ *
+ * CODEC_VBYTE: the original variable byte encoding, one byte at a time.
+ * CODEC_STREAMVBYTE: Stream VByte. The 2-bit lengths of four integers are
+ * packed into one control byte, all control bytes come first and the
+ * little-endian data bytes follow. Decoding uses a shuffle table indexed by
+ * the control byte (SSSE3 for 4 integers, AVX2 for 8 integers at a time)
+ * with a scalar fallback, chosen at runtime from the CPU features.
+ * CODEC_PFOR: patched frame of reference. Every full chunk of 128 integers
+ * is bit-packed with the bit width b that gives the smallest chunk, values
+ * that need more than b bits are patched from an exception list. The packed
+ * words are interleaved over 4 lanes so one SSE2 shift/mask unpacks 4
+ * integers at a time. A partial chunk at the end is vbyte encoded.
+ *
+ * @author Ubaada
+ * @date 01-04-2024
+ */
+
+#ifndef CODEC_H
+#define CODEC_H
+
+#include <stdint.h>
+#include "postings.h"
+
+typedef enum PostingCodec {
+    CODEC_VBYTE = 0,
+    CODEC_STREAMVBYTE = 1,
+    CODEC_PFOR = 2,
+    CODEC_COUNT
+} PostingCodec;
+
+/**
+ * Get the name of a codec
+ *
+ * @param codec The codec
+ * @return The name, "unknown" for an invalid codec
+ */
+const char* codec_name(int codec);
+
+/**
+ * Look up a codec by name
+ *
+ * @param name The name of the codec
+ * @return The codec, -1 if there is no such codec
+ */
+int codec_from_name(const char *name);
+
+/**
+ * Encode integers and append them to a buffer
+ *
+ * @param codec The codec to use
+ * @param values The integers to encode
+ * @param n The number of integers
+ * @param out The buffer to append to
+ */
+void codec_encode(int codec, const uint32_t *values, int n, ByteBuffer *out);
+
+/**
+ * Decode n integers. Safe to call from several threads, the decoder
+ * is picked once on first use.
+ *
+ * @param codec The codec the integers were encoded with
+ * @param in The encoded data
+ * @param end End of the readable memory, SIMD decoders may read up to here
+ * @param n The number of integers to decode
+ * @param out Receives the n integers
+ * @return Pointer just past the encoded integers
+ */
+const unsigned char* codec_decode(int codec, const unsigned char *in, const unsigned char *end, int n, uint32_t *out);
+
+/**
+ * Force the SIMD or scalar decoder implementations. Stream VByte uses the
+ * named one, PFor uses its SSE2 unpack for "ssse3"/"avx2".
+ * The default is the best one the CPU supports.
+ *
+ * @param name "scalar", "ssse3" or "avx2"
+ * @return false if the implementation is unknown or not supported by the CPU
+ */
+bool codec_set_decoder(const char *name);
+
+/**
+ * Get the name of the Stream VByte decoder implementation in use
+ *
+ * @return "scalar", "ssse3" or "avx2"
+ */
+const char* codec_decoder_name(void);
+
+#endif // CODEC_H
@@ -4,56 +4,18 @@
  */
 
 #include "common.h"
+#include "stemmer.h"
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <stddef.h>
 #include <stdbool.h>
 #include <string.h>
-#include <ctype.h>
 
 
-/* Helper function to check if a string ends with a given suffix. */
-bool ends_with(const char *str, const char *suffix) {
-    if (!str || !suffix) return false;
-    size_t lenstr = strlen(str);
-    size_t lensuffix = strlen(suffix);
-    if (lensuffix > lenstr) return false;
-    return strncmp(str + lenstr - lensuffix, suffix, lensuffix) == 0;
-}
-
-
-/* Stem a char in place by removing suffixes if greater than a certain length */
+/* Stem a word in place, see include/stemmer.c */
 void stem(char *word) {
-
-    /* lowercase the word */
-    for (int i = 0; word[i]; i++) {
-        word[i] = tolower(word[i]);
-    }
-
-    /* sorted from longest to shortest */
-    const char *suffixes[] = { "able", "ible", "ness", "ment", "ions", "ings", "ies", "ion", "ing", \
-            "ate", "ize", "ise", "ant", "ent", "ful", "ous", "ive", \
-            "es", "er", "or", "al", "ic", "ly", "ed", \
-            "en", "fy", "\'s", "s", NULL};
-
-    const char **suffix = suffixes;
-
-    
-    int too_short = 3; /* Minimum length of word after stemming */
-
-    
-    while (*suffix != NULL) {
-
-        /* if word ends with suffix and removing it doesn't make the word too short */
-        int result_len = strlen(word) - strlen(*suffix);
-        if (ends_with(word, *suffix) && (result_len >= too_short)) {
-            word[strlen(word) - strlen(*suffix)] = '\0'; /* Remove the suffix. */
-            break;
-        }
-
-        suffix++;
-    }
-    return;
+    stem_length(word, strlen(word));
 }
 
 /* Compare two postings based on their doc_id */
@@ -61,6 +23,13 @@ int posting_cmp(const void *a, const void *b) {
     return ((Posting *)a)->doc_id - ((Posting *)b)->doc_id;
 }
 
+/* Free a posting list array */
+void posting_list_free(PostingList *list) {
+    if (list == NULL) return;
+    free(list->postings);
+    free(list);
+}
+
 /*
 * Explicitly write an integer to a file in big-endian format.
 * Avoids conflicts with default endianness of the system.
@@ -95,10 +64,12 @@ int variable_byte_encode(int n, FILE *fp) {
     }
     buffer[0] = buffer[0] | 128; /* Set the first bit to 1 to indicate more bytes are coming */
 
-    /* Process in reverse */
-    for (int j = i - 1; j >= 0; j--) {
-        fwrite(&buffer[j], sizeof(char), 1, fp);
+    /* Process in reverse, then write all bytes at once */
+    unsigned char bytes[10];
+    for (int j = 0; j < i; j++) {
+        bytes[j] = buffer[i - 1 - j];
     }
+    fwrite(bytes, sizeof(char), i, fp);
     return i;
 }
 
@@ -112,3 +83,13 @@ int read_int_big_endian(FILE* file) {
            ((int)bytes[2] << 8) |
             (int)bytes[3];
 }
+
+/* FNV-1a, one xor and multiply per byte */
+uint32_t hash_fnv1a(const char *key, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)key[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
@@ -13,6 +13,7 @@
 #ifndef COMMON_H
 #define COMMON_H
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 
 /**
@@ -20,7 +21,6 @@
  */
 #define MAX_KEY_SIZE 60
 #define OFFSET_SIZE 4
-#define DOC_ID_SIZE 14
 
 /**
  * Define the structure of a posting 
@@ -30,6 +30,21 @@ typedef struct Posting {
     int freq;
 } Posting;
 
+/**
+ * A posting list held as a contiguous array sorted by doc_id
+ */
+typedef struct PostingList {
+    Posting *postings;
+    int size;
+} PostingList;
+
+/**
+ * Free a posting list and its postings
+ *
+ * @param list The list to free, may be NULL
+ */
+void posting_list_free(PostingList *list);
+
 /**
  * Stem the given word by removing common suffixes 
  * Lowercases the word before stemming
@@ -72,5 +87,14 @@ int variable_byte_encode(int n, FILE *fp);
  * Avoids differences in endianness between platforms
 */
 int read_int_big_endian(FILE* file);
+
+/**
+ * 32-bit FNV-1a hash of a byte string, shared by the hash tables and caches
+ *
+ * @param key The bytes to hash
+ * @param length The number of bytes
+ * @return The hash
+ */
+uint32_t hash_fnv1a(const char *key, size_t length);
 #endif
 
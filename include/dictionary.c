@@ -0,0 +1,319 @@
+/**
+ * @file dictionary.c
+ * @brief Front coded dictionary with an in-memory block index
+ */
+
+#include "dictionary.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Append a big-endian 64 bit number */
+static void put_int64(ByteBuffer *buffer, int64_t value) {
+    unsigned char bytes[8];
+    for (int i = 0; i < 8; i++) {
+        bytes[i] = (uint64_t)value >> (56 - 8 * i);
+    }
+    bytebuffer_put(buffer, bytes, sizeof(bytes));
+}
+
+/* Append a big-endian 32 bit number */
+static void put_int32(ByteBuffer *buffer, uint32_t value) {
+    unsigned char bytes[4] = { value >> 24, value >> 16, value >> 8, value };
+    bytebuffer_put(buffer, bytes, sizeof(bytes));
+}
+
+/* Load a big-endian 64 bit number */
+static int64_t get_int64(const unsigned char *bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) {
+        value = (value << 8) | bytes[i];
+    }
+    return (int64_t)value;
+}
+
+/* Load a big-endian 32 bit number */
+static uint32_t get_int32(const unsigned char *bytes) {
+    return ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) | ((uint32_t)bytes[2] << 8) | bytes[3];
+}
+
+void dict_writer_open(DictWriter *writer, FILE *fp, int64_t file_offset) {
+    memset(writer, 0, sizeof(DictWriter));
+    writer->fp = fp;
+    writer->file_offset = file_offset;
+}
+
+/* Write out the filled block */
+static void flush_block(DictWriter *writer) {
+    if (writer->block.size == 0) {
+        return;
+    }
+    fwrite(writer->block.data, 1, writer->block.size, writer->fp);
+    writer->file_offset += writer->block.size;
+    writer->block.size = 0;
+}
+
+void dict_writer_add(DictWriter *writer, const char *term, size_t length, int64_t posting_offset) {
+    if (writer->n_terms % DICT_BLOCK_TERMS == 0) {
+        /* A new block, its first term goes to the block index */
+        flush_block(writer);
+        put_int64(&writer->index, writer->file_offset);
+        put_int64(&writer->index, posting_offset);
+        bytebuffer_put_vbyte(&writer->index, length);
+        bytebuffer_put(&writer->index, term, length);
+    } else {
+        size_t prefix = 0;
+        while (prefix < length && prefix < writer->previous_length && term[prefix] == writer->previous[prefix]) {
+            prefix += 1;
+        }
+        bytebuffer_put_vbyte(&writer->block, prefix);
+        bytebuffer_put_vbyte(&writer->block, length - prefix);
+        bytebuffer_put(&writer->block, term + prefix, length - prefix);
+        bytebuffer_put_vbyte64(&writer->block, posting_offset - writer->previous_offset);
+    }
+
+    if (length + 1 > writer->previous_capacity) {
+        writer->previous_capacity = 2 * (length + 1);
+        writer->previous = (char *)realloc(writer->previous, writer->previous_capacity);
+    }
+    memcpy(writer->previous, term, length);
+    writer->previous_length = length;
+    writer->previous_offset = posting_offset;
+    if ((int)length > writer->max_length) writer->max_length = length;
+    writer->n_terms += 1;
+}
+
+void dict_writer_close(DictWriter *writer) {
+    flush_block(writer);
+    int64_t index_offset = writer->file_offset;
+    put_int64(&writer->index, index_offset);
+    put_int32(&writer->index, writer->n_terms);
+    put_int32(&writer->index, DICT_BLOCK_TERMS);
+    put_int32(&writer->index, writer->max_length);
+    fwrite(writer->index.data, 1, writer->index.size, writer->fp);
+    writer->file_offset += writer->index.size;
+
+    bytebuffer_free(&writer->block);
+    bytebuffer_free(&writer->index);
+    free(writer->previous);
+    writer->previous = NULL;
+}
+
+/* Bytes [begin, end) of the file, in the mapping or read into a malloc'd buffer */
+static const unsigned char* dict_bytes(const Dictionary *dict, int64_t begin, int64_t end, unsigned char **owned) {
+    *owned = NULL;
+    if (dict->data != NULL) {
+        return dict->data + begin;
+    }
+    *owned = (unsigned char *)malloc(end - begin + 1);
+    if (*owned == NULL || pread(dict->fd, *owned, end - begin, begin) != end - begin) {
+        free(*owned);
+        *owned = NULL;
+        return NULL;
+    }
+    return *owned;
+}
+
+bool dictionary_open(Dictionary *dict, const unsigned char *data, int fd, int64_t size, int64_t posting_size) {
+    memset(dict, 0, sizeof(Dictionary));
+    dict->data = data;
+    dict->fd = fd;
+    if (size < DICT_FOOTER_SIZE) {
+        return false;
+    }
+
+    unsigned char *owned;
+    const unsigned char *footer = dict_bytes(dict, size - DICT_FOOTER_SIZE, size, &owned);
+    if (footer == NULL) {
+        return false;
+    }
+    int64_t index_offset = get_int64(footer);
+    dict->n_terms = get_int32(footer + 8);
+    dict->block_terms = get_int32(footer + 12);
+    dict->max_length = get_int32(footer + 16);
+    free(owned);
+    if (index_offset < 0 || index_offset > size - DICT_FOOTER_SIZE || dict->n_terms < 0 || dict->block_terms <= 0
+            || dict->max_length < 0) {
+        return false;
+    }
+    dict->n_blocks = (dict->n_terms + dict->block_terms - 1) / dict->block_terms;
+
+    /* The block index, with the first terms copied out NUL terminated */
+    int64_t index_size = size - DICT_FOOTER_SIZE - index_offset;
+    const unsigned char *index = dict_bytes(dict, index_offset, size - DICT_FOOTER_SIZE, &owned);
+    dict->block_offset = (int64_t *)malloc((dict->n_blocks + 1) * sizeof(int64_t));
+    dict->block_postings = (int64_t *)malloc((dict->n_blocks + 1) * sizeof(int64_t));
+    dict->leading = (char **)malloc((dict->n_blocks + 1) * sizeof(char *));
+    dict->heap = (char *)malloc(index_size + dict->n_blocks + 1);
+    if (index == NULL || dict->block_offset == NULL || dict->block_postings == NULL || dict->leading == NULL
+            || dict->heap == NULL) {
+        free(owned);
+        dictionary_close(dict);
+        return false;
+    }
+    const unsigned char *p = index;
+    const unsigned char *end = index + index_size;
+    char *heap = dict->heap;
+    int n_read = 0;
+    for (int b = 0; b < dict->n_blocks; b++, n_read++) {
+        if (end - p < 16) break;
+        dict->block_offset[b] = get_int64(p);
+        dict->block_postings[b] = get_int64(p + 8);
+        p += 16;
+        int length = vbyte_get(&p, end);
+        if (length < 0 || length > end - p) break;
+        memcpy(heap, p, length);
+        heap[length] = '\0';
+        dict->leading[b] = heap;
+        heap += length + 1;
+        p += length;
+    }
+    free(owned);
+    if (p != end || n_read != dict->n_blocks) {
+        dictionary_close(dict);
+        return false;
+    }
+    dict->block_offset[dict->n_blocks] = index_offset;
+    dict->block_postings[dict->n_blocks] = posting_size;
+
+    /* Blocks and posting lists follow each other inside their files */
+    for (int b = 0; b < dict->n_blocks; b++) {
+        if (dict->block_offset[b] < 0 || dict->block_offset[b] > dict->block_offset[b + 1]
+                || dict->block_postings[b] < 0 || dict->block_postings[b] > dict->block_postings[b + 1]
+                || strlen(dict->leading[b]) > (size_t)dict->max_length) {
+            dictionary_close(dict);
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Position inside a block while it is scanned term by term */
+typedef struct BlockScan {
+    const unsigned char *p;
+    const unsigned char *end;
+    unsigned char *owned; /* The block read with pread */
+    char *term; /* The current term, NUL terminated */
+    int64_t offset; /* Posting offset of the current term */
+    int position; /* Of the current term in the block */
+    int count; /* Terms in the block */
+} BlockScan;
+
+/* Start at the first term of block b */
+static bool block_scan_open(const Dictionary *dict, int b, BlockScan *scan) {
+    scan->p = dict_bytes(dict, dict->block_offset[b], dict->block_offset[b + 1], &scan->owned);
+    if (scan->p == NULL) {
+        return false;
+    }
+    scan->end = scan->p + (dict->block_offset[b + 1] - dict->block_offset[b]);
+    scan->term = (char *)malloc(dict->max_length + 1);
+    if (scan->term == NULL || strlen(dict->leading[b]) > (size_t)dict->max_length) {
+        free(scan->owned);
+        free(scan->term);
+        return false;
+    }
+    strcpy(scan->term, dict->leading[b]);
+    scan->offset = dict->block_postings[b];
+    scan->position = 0;
+    scan->count = dict->n_terms - b * dict->block_terms;
+    if (scan->count > dict->block_terms) scan->count = dict->block_terms;
+    return true;
+}
+
+/* Move to the next term of the block, false at the end of the block */
+static bool block_scan_next(const Dictionary *dict, BlockScan *scan) {
+    if (scan->position + 1 >= scan->count || scan->p >= scan->end) {
+        return false;
+    }
+    int prefix = vbyte_get(&scan->p, scan->end);
+    int suffix = vbyte_get(&scan->p, scan->end);
+    if (prefix < 0 || suffix < 0 || prefix + suffix > dict->max_length || suffix > scan->end - scan->p) {
+        return false;
+    }
+    memcpy(scan->term + prefix, scan->p, suffix);
+    scan->term[prefix + suffix] = '\0';
+    scan->p += suffix;
+    scan->offset += vbyte_get64(&scan->p, scan->end);
+    scan->position += 1;
+    return true;
+}
+
+static void block_scan_close(BlockScan *scan) {
+    free(scan->owned);
+    free(scan->term);
+}
+
+/* The current term's list ends where the next term's starts */
+static int64_t block_scan_end(const Dictionary *dict, BlockScan *scan, int b) {
+    return block_scan_next(dict, scan) ? scan->offset : dict->block_postings[b + 1];
+}
+
+bool dictionary_lookup(const Dictionary *dict, const char *term, int64_t *begin, int64_t *end) {
+    /* Last block whose first term is <= the term */
+    int low = 0, high = dict->n_blocks - 1, b = -1;
+    while (low <= high) {
+        int mid = low + (high - low) / 2;
+        if (strcmp(dict->leading[mid], term) <= 0) {
+            b = mid;
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+    if (b < 0) {
+        return false;
+    }
+
+    BlockScan scan;
+    if (!block_scan_open(dict, b, &scan)) {
+        return false;
+    }
+    bool found = false;
+    do {
+        int cmp = strcmp(scan.term, term);
+        if (cmp == 0) {
+            *begin = scan.offset;
+            *end = block_scan_end(dict, &scan, b);
+            found = true;
+            break;
+        }
+        if (cmp > 0) {
+            break; /* Terms are sorted, it isn't here */
+        }
+    } while (block_scan_next(dict, &scan));
+    block_scan_close(&scan);
+    return found;
+}
+
+bool dictionary_entry(const Dictionary *dict, int i, char *term, size_t size, int64_t *begin, int64_t *end) {
+    if (i < 0 || i >= dict->n_terms || size == 0) {
+        return false;
+    }
+    int b = i / dict->block_terms;
+    BlockScan scan;
+    if (!block_scan_open(dict, b, &scan)) {
+        return false;
+    }
+    bool found = true;
+    while (found && scan.position < i % dict->block_terms) {
+        found = block_scan_next(dict, &scan);
+    }
+    if (found) {
+        strncpy(term, scan.term, size - 1);
+        term[size - 1] = '\0';
+        *begin = scan.offset;
+        *end = block_scan_end(dict, &scan, b);
+    }
+    block_scan_close(&scan);
+    return found;
+}
+
+void dictionary_close(Dictionary *dict) {
+    free(dict->block_offset);
+    free(dict->block_postings);
+    free(dict->leading);
+    free(dict->heap);
+    dict->block_offset = dict->block_postings = NULL;
+    dict->leading = NULL;
+    dict->heap = NULL;
+}
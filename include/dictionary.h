@@ -0,0 +1,133 @@
+/**
+ * @file dictionary.h
+ * @brief Front coded dictionary of the index, from version 4.
+ *
+ * The sorted terms are grouped in blocks of DICT_BLOCK_TERMS. The first
+ * term of a block is kept in the block index, the others are front coded
+ * against the term before them. After the header entry the dictionary
+ * file holds:
+ *     blocks, for each term but the first: vbyte shared prefix length,
+ *         vbyte suffix length, the suffix, vbyte64 byte length of the
+ *         previous term's posting list
+ *     block index, for each block: 8 byte file offset of the block,
+ *         8 byte posting offset of its first term, vbyte term length, term
+ *     footer: 8 byte offset of the block index, 4 byte number of terms,
+ *         4 byte terms per block, 4 byte length of the longest term
+ * Fixed width integers are big-endian. Terms have no length limit and
+ * posting offsets are 64 bit.
+ *
+ * The reader keeps the block index in memory: a lookup is a binary search
+ * over the first terms and a scan of one block, from the mapping or read
+ * with pread.
+ *
+ * @author Ubaada
+ * @date 01-04-2024
+ */
+
+#ifndef DICTIONARY_H
+#define DICTIONARY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "postings.h"
+
+#define DICT_BLOCK_TERMS 16
+#define DICT_FOOTER_SIZE 20
+
+/* Writes the blocks as they fill up, the block index on close */
+typedef struct DictWriter {
+    FILE *fp;
+    int64_t file_offset; /* Where the next block goes */
+    int n_terms;
+    int max_length; /* Longest term */
+    ByteBuffer block; /* The block being filled */
+    ByteBuffer index; /* The block index */
+    char *previous; /* The previous term */
+    size_t previous_length;
+    size_t previous_capacity;
+    int64_t previous_offset; /* Posting offset of the previous term */
+} DictWriter;
+
+/* An opened dictionary with its block index in memory */
+typedef struct Dictionary {
+    int n_terms;
+    int n_blocks;
+    int block_terms; /* Terms per block */
+    int max_length;
+    int64_t *block_offset; /* File offset of each block, and of the block index */
+    int64_t *block_postings; /* Posting offset of the first term of each block, and the posting file size */
+    char **leading; /* First term of each block */
+    char *heap; /* Memory of the first terms */
+    const unsigned char *data; /* The mapped file, NULL to read blocks with pread */
+    int fd;
+} Dictionary;
+
+/**
+ * Start writing the dictionary after the header entry
+ *
+ * @param writer The writer to open
+ * @param fp The dictionary file, positioned after the header entry
+ * @param file_offset The position of fp
+ */
+void dict_writer_open(DictWriter *writer, FILE *fp, int64_t file_offset);
+
+/**
+ * Add the next term, terms must come in strcmp order
+ *
+ * @param writer The opened writer
+ * @param term The term
+ * @param length The length of the term
+ * @param posting_offset Byte offset of the term's posting list
+ */
+void dict_writer_add(DictWriter *writer, const char *term, size_t length, int64_t posting_offset);
+
+/**
+ * Write the last block, the block index and the footer.
+ * The file stays open.
+ *
+ * @param writer The writer to close
+ */
+void dict_writer_close(DictWriter *writer);
+
+/**
+ * Open a dictionary, reading its block index into memory
+ *
+ * @param dict The dictionary to open
+ * @param data The mapped dictionary file, NULL to read with pread
+ * @param fd The dictionary file
+ * @param size The size of the dictionary file
+ * @param posting_size The size of the posting list file
+ * @return false if the dictionary is malformed
+ */
+bool dictionary_open(Dictionary *dict, const unsigned char *data, int fd, int64_t size, int64_t posting_size);
+
+/**
+ * Find the posting list of a term
+ *
+ * @param dict The opened dictionary
+ * @param term The term, NUL terminated
+ * @param begin Set to the byte offset of the posting list
+ * @param end Set to the byte offset just past the posting list
+ * @return true if the term was found
+ */
+bool dictionary_lookup(const Dictionary *dict, const char *term, int64_t *begin, int64_t *end);
+
+/**
+ * Get the term at a position in sorted order and its posting list
+ *
+ * @param dict The opened dictionary
+ * @param i The position, 0 to n_terms - 1
+ * @param term Buffer for the term, truncated to fit
+ * @param size The size of the buffer
+ * @param begin Set to the byte offset of the posting list
+ * @param end Set to the byte offset just past the posting list
+ * @return false if i is out of range
+ */
+bool dictionary_entry(const Dictionary *dict, int i, char *term, size_t size, int64_t *begin, int64_t *end);
+
+/* Free the block index */
+void dictionary_close(Dictionary *dict);
+
+#endif // DICTIONARY_H
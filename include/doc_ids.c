@@ -0,0 +1,131 @@
+/**
+ * @file doc_ids.c
+ * @brief Binary store of the external document IDs
+ */
+
+#include "doc_ids.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Store a big-endian 32 bit number in memory */
+static void put_big_endian(unsigned char *bytes, uint32_t value) {
+    bytes[0] = (value >> 24) & 0xFF;
+    bytes[1] = (value >> 16) & 0xFF;
+    bytes[2] = (value >> 8) & 0xFF;
+    bytes[3] = value & 0xFF;
+}
+
+/* Load a big-endian 32 bit number from memory */
+static uint32_t get_big_endian(const unsigned char *bytes) {
+    return ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) | ((uint32_t)bytes[2] << 8) | bytes[3];
+}
+
+bool doc_id_writer_open(DocIdWriter *writer, const char *path) {
+    memset(writer, 0, sizeof(DocIdWriter));
+    writer->fp = fopen(path, "wb");
+    if (writer->fp == NULL) {
+        printf("Error: Couldn't open file for writing\n");
+        return false;
+    }
+    /* Room for the header, filled in on close */
+    unsigned char header[DOC_IDS_HEADER_SIZE] = {0};
+    fwrite(header, sizeof(header), 1, writer->fp);
+    return true;
+}
+
+void doc_id_writer_add(DocIdWriter *writer, const char *doc_id) {
+    if (writer->n_docs == writer->capacity) {
+        writer->capacity = writer->capacity ? writer->capacity * 2 : 1024;
+        writer->offsets = (uint32_t *)realloc(writer->offsets, writer->capacity * sizeof(uint32_t));
+    }
+    writer->offsets[writer->n_docs++] = writer->heap_size;
+    size_t length = strlen(doc_id) + 1;
+    fwrite(doc_id, 1, length, writer->fp);
+    writer->heap_size += length;
+}
+
+void doc_id_writer_close(DocIdWriter *writer) {
+    unsigned char bytes[4];
+    for (int i = 0; i < writer->n_docs; i++) {
+        put_big_endian(bytes, writer->offsets[i]);
+        fwrite(bytes, sizeof(bytes), 1, writer->fp);
+    }
+
+    unsigned char header[DOC_IDS_HEADER_SIZE] = {0};
+    memcpy(header, DOC_IDS_MAGIC, strlen(DOC_IDS_MAGIC));
+    put_big_endian(header + 8, writer->n_docs);
+    put_big_endian(header + 12, writer->heap_size);
+    fseek(writer->fp, 0, SEEK_SET);
+    fwrite(header, sizeof(header), 1, writer->fp);
+
+    fclose(writer->fp);
+    free(writer->offsets);
+    writer->fp = NULL;
+    writer->offsets = NULL;
+}
+
+bool doc_id_table_open(DocIdTable *table, const unsigned char *data, size_t size) {
+    memset(table, 0, sizeof(DocIdTable));
+    if (size < DOC_IDS_HEADER_SIZE || memcmp(data, DOC_IDS_MAGIC, strlen(DOC_IDS_MAGIC)) != 0) {
+        return false;
+    }
+    uint32_t n_docs = get_big_endian(data + 8);
+    uint32_t heap_size = get_big_endian(data + 12);
+    if ((uint64_t)DOC_IDS_HEADER_SIZE + heap_size + (uint64_t)n_docs * 4 > size
+            || n_docs > INT32_MAX || (heap_size > 0 && data[DOC_IDS_HEADER_SIZE + heap_size - 1] != '\0')) {
+        return false;
+    }
+    table->n_docs = n_docs;
+    table->heap = (const char *)data + DOC_IDS_HEADER_SIZE;
+    table->heap_size = heap_size;
+    table->offsets = data + DOC_IDS_HEADER_SIZE + heap_size;
+    return true;
+}
+
+bool doc_id_table_from_text(DocIdTable *table, const char *text, size_t size) {
+    memset(table, 0, sizeof(DocIdTable));
+    int n_docs = 0;
+    for (size_t i = 0; i < size; i++) {
+        if (text[i] == '\n') n_docs += 1;
+    }
+    if (size > 0 && text[size - 1] != '\n') {
+        n_docs += 1; /* The last ID has no newline */
+    }
+
+    /* Offsets first, then the IDs with their newlines turned into NULs */
+    table->owned = (unsigned char *)malloc((size_t)n_docs * 4 + size + 1);
+    if (table->owned == NULL) {
+        return false;
+    }
+    char *heap = (char *)table->owned + (size_t)n_docs * 4;
+    memcpy(heap, text, size);
+    heap[size] = '\0';
+    uint32_t start = 0;
+    int doc = 0;
+    for (size_t i = 0; i <= size && doc < n_docs; i++) {
+        if (i == size || heap[i] == '\n') {
+            heap[i] = '\0';
+            put_big_endian(table->owned + (size_t)doc * 4, start);
+            doc += 1;
+            start = i + 1;
+        }
+    }
+    table->n_docs = n_docs;
+    table->heap = heap;
+    table->heap_size = size + 1;
+    table->offsets = table->owned;
+    return true;
+}
+
+const char* doc_id_table_get(const DocIdTable *table, int doc_index) {
+    if (doc_index < 0 || doc_index >= table->n_docs) {
+        return "";
+    }
+    uint32_t offset = get_big_endian(table->offsets + (size_t)doc_index * 4);
+    return offset < table->heap_size ? table->heap + offset : "";
+}
+
+void doc_id_table_free(DocIdTable *table) {
+    free(table->owned);
+    memset(table, 0, sizeof(DocIdTable));
+}
@@ -0,0 +1,106 @@
+/**
+ * @file doc_ids.h
+ * @brief Binary store of the external document IDs.
+ *
+ * The indexer numbers documents in the order they appear and the searcher
+ * turns those numbers back into the collection's own IDs. The store is
+ * written by the indexer next to the plain text ID list:
+ *     magic "DOCIDS" (8 bytes, NUL padded)
+ *     n_docs (4 bytes), heap size (4 bytes)
+ *     heap: every ID NUL terminated, in document order
+ *     n_docs offsets (4 bytes each) of the IDs in the heap
+ * All integers are big-endian. The searcher maps (or reads) the file once
+ * and an ID is an offset lookup, whatever its length.
+ *
+ * @author Ubaada
+ * @date 01-04-2024
+ */
+
+#ifndef DOC_IDS_H
+#define DOC_IDS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define DOC_IDS_FILE "data/doc_ids.bin"
+#define DOC_IDS_MAGIC "DOCIDS"
+#define DOC_IDS_HEADER_SIZE 16
+
+/* Streams IDs into the store, the offsets are written on close */
+typedef struct DocIdWriter {
+    FILE *fp;
+    uint32_t *offsets;
+    int n_docs;
+    int capacity;
+    uint32_t heap_size;
+} DocIdWriter;
+
+/* IDs of an opened store, in a mapping or in memory owned by the table */
+typedef struct DocIdTable {
+    int n_docs;
+    const char *heap;
+    uint32_t heap_size;
+    const unsigned char *offsets; /* n_docs big-endian offsets into heap */
+    unsigned char *owned; /* malloc'd memory of the table, NULL if mapped */
+} DocIdTable;
+
+/**
+ * Create the store
+ *
+ * @param writer The writer to open
+ * @param path The store file
+ * @return true on success, false otherwise
+ */
+bool doc_id_writer_open(DocIdWriter *writer, const char *path);
+
+/**
+ * Append the ID of the next document
+ *
+ * @param writer The opened writer
+ * @param doc_id The ID, NUL terminated
+ */
+void doc_id_writer_add(DocIdWriter *writer, const char *doc_id);
+
+/**
+ * Write the offsets and the header, and close the file
+ *
+ * @param writer The writer to close
+ */
+void doc_id_writer_close(DocIdWriter *writer);
+
+/**
+ * Open a store from its bytes, which must outlive the table
+ *
+ * @param table The table to open
+ * @param data The bytes of the store file
+ * @param size The size of the store file
+ * @return false if the bytes are not a valid store
+ */
+bool doc_id_table_open(DocIdTable *table, const unsigned char *data, size_t size);
+
+/**
+ * Build a table from a newline separated ID list, as written before
+ * the binary store existed
+ *
+ * @param table The table to fill, owns a copy of the IDs
+ * @param text The ID list
+ * @param size The size of the ID list
+ * @return false if out of memory
+ */
+bool doc_id_table_from_text(DocIdTable *table, const char *text, size_t size);
+
+/**
+ * Get the ID of a document
+ *
+ * @param table The opened table
+ * @param doc_index The document index assigned by the indexer
+ * @return The ID, NUL terminated, an empty string if out of range
+ */
+const char* doc_id_table_get(const DocIdTable *table, int doc_index);
+
+/* Free the memory owned by a table */
+void doc_id_table_free(DocIdTable *table);
+
+#endif // DOC_IDS_H
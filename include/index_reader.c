@@ -0,0 +1,358 @@
+/**
+ * @file index_reader.c
+ * @brief Memory mapped (or stdio) access to the index files
+ */
+
+#include "index_reader.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define DICT_ENTRY_SIZE (MAX_KEY_SIZE + OFFSET_SIZE)
+#define SEQUENTIAL_HINT_SIZE (64 * 1024) /* Only advise lists spanning several pages */
+
+/* Read a big-endian integer from memory */
+static int mem_int_big_endian(const unsigned char *bytes) {
+    return ((int)bytes[0] << 24) |
+           ((int)bytes[1] << 16) |
+           ((int)bytes[2] << 8) |
+            (int)bytes[3];
+}
+
+/* Map a whole file read only, with the given access pattern advice */
+static bool map_file(FILE *file, MappedFile *mapped, int advice) {
+    struct stat sb;
+    if (fstat(fileno(file), &sb) == -1) {
+        return false;
+    }
+    mapped->size = sb.st_size;
+    if (mapped->size == 0) {
+        /* Nothing to map, an empty region is fine */
+        mapped->data = NULL;
+        return true;
+    }
+    void *data = mmap(NULL, mapped->size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+    if (data == MAP_FAILED) {
+        mapped->data = NULL;
+        mapped->size = 0;
+        return false;
+    }
+    madvise(data, mapped->size, advice);
+    mapped->data = (unsigned char *)data;
+    return true;
+}
+
+/* Unmap a file mapped with map_file */
+static void unmap_file(MappedFile *mapped) {
+    if (mapped->data != NULL) {
+        munmap(mapped->data, mapped->size);
+    }
+    mapped->data = NULL;
+    mapped->size = 0;
+}
+
+/* Read a whole file into memory, NULL if it can't be read */
+static unsigned char* read_file(FILE *file, size_t *size) {
+    struct stat sb;
+    if (fstat(fileno(file), &sb) == -1) {
+        return NULL;
+    }
+    *size = sb.st_size;
+    unsigned char *data = (unsigned char *)malloc(*size + 1);
+    if (data != NULL && fread(data, 1, *size, file) != *size) {
+        free(data);
+        return NULL;
+    }
+    return data;
+}
+
+/**
+ * Open the document ID store, mapped or read into memory.
+ * Indexes without a store have their ID list read into a table instead.
+ */
+static bool open_doc_ids(IndexReader *index, bool use_mmap) {
+    FILE *file = fopen(DOC_IDS_FILE, "rb");
+    if (file != NULL) {
+        bool opened;
+        if (use_mmap && map_file(file, &index->ids, MADV_RANDOM)) {
+            opened = doc_id_table_open(&index->doc_ids, index->ids.data, index->ids.size);
+        } else {
+            size_t size;
+            unsigned char *data = read_file(file, &size);
+            opened = data != NULL && doc_id_table_open(&index->doc_ids, data, size);
+            if (opened) {
+                index->doc_ids.owned = data;
+            } else {
+                free(data);
+            }
+        }
+        fclose(file);
+        return opened;
+    }
+
+    file = fopen(ID_FILE, "rb");
+    if (file == NULL) {
+        return false;
+    }
+    size_t size;
+    unsigned char *text = read_file(file, &size);
+    fclose(file);
+    bool opened = text != NULL && doc_id_table_from_text(&index->doc_ids, (const char *)text, size);
+    free(text);
+    return opened;
+}
+
+/* Mix the identity and change times of a file into a generation, FNV-1a style */
+static uint64_t mix_file_generation(uint64_t generation, const char *path) {
+    struct stat sb;
+    uint64_t fields[7] = {0};
+    if (stat(path, &sb) == 0) {
+        fields[0] = sb.st_dev;
+        fields[1] = sb.st_ino;
+        fields[2] = sb.st_size;
+        fields[3] = sb.st_mtim.tv_sec;
+        fields[4] = sb.st_mtim.tv_nsec;
+        fields[5] = sb.st_ctim.tv_sec;
+        fields[6] = sb.st_ctim.tv_nsec;
+    }
+    for (int i = 0; i < 7; i++) {
+        generation ^= fields[i];
+        generation *= 1099511628211ull;
+    }
+    return generation;
+}
+
+uint64_t index_generation(void) {
+    const char *paths[] = { DICT_FILE, POSTING_FILE, DOC_IDS_FILE, ID_FILE, DOC_STATS_FILE };
+    uint64_t generation = 14695981039346656037ull;
+    for (size_t i = 0; i < sizeof(paths) / sizeof(paths[0]); i++) {
+        generation = mix_file_generation(generation, paths[i]);
+    }
+    return generation;
+}
+
+/* Stamp of the file at path, 0 without a trailer, false if it can't be read */
+static bool file_stamp(const char *path, uint64_t *stamp) {
+    FILE *fp = fopen(path, "rb");
+    struct stat sb;
+    if (fp == NULL || fstat(fileno(fp), &sb) == -1) {
+        if (fp) fclose(fp);
+        return false;
+    }
+    *stamp = index_stamp_read(fileno(fp), sb.st_size);
+    fclose(fp);
+    return true;
+}
+
+bool index_stamps_match(const IndexReader *index) {
+    uint64_t stamp = index->header.stamp;
+    if (index_stamp_read(fileno(index->posting_file), index->posting_size + INDEX_STAMP_SIZE) != stamp) {
+        return false;
+    }
+    /* Without doc_ids.bin the IDs came from the unstamped text list */
+    uint64_t ids_stamp = 0;
+    if (file_stamp(DOC_IDS_FILE, &ids_stamp) && ids_stamp != stamp) {
+        return false;
+    }
+    uint64_t stats_stamp = 0;
+    return !index->has_stats || (file_stamp(DOC_STATS_FILE, &stats_stamp) && stats_stamp == stamp);
+}
+
+/* Open the index files and map them */
+bool index_open(IndexReader *index, bool use_mmap) {
+    memset(index, 0, sizeof(IndexReader));
+    /* Taken first, a rebuild while opening shows up as a change later */
+    index->generation = index_generation();
+    index->dict_file = fopen(DICT_FILE, "rb");
+    index->posting_file = fopen(POSTING_FILE, "rb");
+    struct stat dict_sb, posting_sb;
+    if (index->dict_file == NULL || index->posting_file == NULL || !open_doc_ids(index, use_mmap)
+            || fstat(fileno(index->dict_file), &dict_sb) == -1
+            || fstat(fileno(index->posting_file), &posting_sb) == -1) {
+        printf("Error: Error opening file(s)\n");
+        return false;
+    }
+    index->dict_size = dict_sb.st_size / DICT_ENTRY_SIZE;
+    index->posting_size = posting_sb.st_size;
+    /* The build stamp trailer isn't part of the last list */
+    if (index_stamp_read(fileno(index->posting_file), index->posting_size) != 0) {
+        index->posting_size -= INDEX_STAMP_SIZE;
+    }
+
+    /* Versioned indexes start with a header entry, old ones with a word */
+    unsigned char entry[DICT_ENTRY_SIZE] = {0};
+    fread(entry, sizeof(entry), 1, index->dict_file);
+    if (index_header_read(entry, &index->header)) {
+        index->dict_first = 1;
+        index->dict_size -= 1;
+    }
+    if (index->header.version < INDEX_VERSION_PLAIN || index->header.version > INDEX_VERSION_FRONT_CODED) {
+        printf("Error: Unsupported index version %d\n", index->header.version);
+        return false;
+    }
+
+    if (use_mmap) {
+        /* Binary search and id lookups jump around, postings are hinted per list */
+        index->use_mmap = map_file(index->dict_file, &index->dict, MADV_RANDOM)
+                && map_file(index->posting_file, &index->postings, MADV_NORMAL);
+        if (!index->use_mmap) {
+            /* Fall back to stdio */
+            unmap_file(&index->dict);
+            unmap_file(&index->postings);
+        }
+    }
+    if (index->header.version >= INDEX_VERSION_FRONT_CODED) {
+        if (!dictionary_open(&index->dictionary, index->use_mmap ? index->dict.data : NULL,
+                             fileno(index->dict_file), dict_sb.st_size, index->posting_size)) {
+            printf("Error: Malformed dictionary\n");
+            return false;
+        }
+        index->dict_size = index->dictionary.n_terms;
+    }
+    index->has_stats = doc_stats_load(DOC_STATS_FILE, &index->stats);
+    return true;
+}
+
+/* Unmap and close the files */
+void index_close(IndexReader *index) {
+    unmap_file(&index->dict);
+    unmap_file(&index->postings);
+    unmap_file(&index->ids);
+    dictionary_close(&index->dictionary);
+    doc_id_table_free(&index->doc_ids);
+    if (index->dict_file) fclose(index->dict_file);
+    if (index->posting_file) fclose(index->posting_file);
+    index->dict_file = index->posting_file = NULL;
+    doc_stats_free(&index->stats);
+    index->has_stats = false;
+}
+
+/* Read the posting offset of the dictionary entry at position i */
+static int64_t dict_offset_at(IndexReader *index, int i) {
+    off_t entry = (off_t)(i + index->dict_first) * DICT_ENTRY_SIZE + MAX_KEY_SIZE;
+    if (index->use_mmap) {
+        return mem_int_big_endian(index->dict.data + entry);
+    }
+    unsigned char bytes[OFFSET_SIZE] = {0};
+    if (pread(fileno(index->dict_file), bytes, OFFSET_SIZE, entry) != OFFSET_SIZE) {
+        return -1;
+    }
+    return mem_int_big_endian(bytes);
+}
+
+/* Binary search the word in the dictionary */
+bool index_lookup(IndexReader *index, const char *word, int64_t *begin, int64_t *end) {
+    if (index->header.version >= INDEX_VERSION_FRONT_CODED) {
+        return dictionary_lookup(&index->dictionary, word, begin, end);
+    }
+
+    /* Fixed size entries, the words truncated to MAX_KEY_SIZE */
+    char key[MAX_KEY_SIZE + 1] = {0};
+    int low = 0, high = index->dict_size - 1;
+
+    while (low <= high) {
+        int mid = low + (high - low) / 2;
+        size_t entry = (size_t)(mid + index->dict_first) * DICT_ENTRY_SIZE;
+        const char *mid_key;
+        if (index->use_mmap) {
+            mid_key = (const char *)index->dict.data + entry;
+        } else {
+            if (pread(fileno(index->dict_file), key, MAX_KEY_SIZE, entry) != MAX_KEY_SIZE) {
+                return false;
+            }
+            mid_key = key;
+        }
+
+        int cmp = strncmp(word, mid_key, MAX_KEY_SIZE);
+        if (cmp == 0) {
+            /*
+             * get the end offset from the start of next word
+             * or from the end of the file if this is the last word
+             */
+            *begin = dict_offset_at(index, mid);
+            *end = mid < index->dict_size - 1 ? dict_offset_at(index, mid + 1) : index->posting_size;
+            return true;
+        } else if (cmp < 0) {
+            high = mid - 1;
+        } else {
+            low = mid + 1;
+        }
+    }
+    return false;
+}
+
+/* Word and posting range of entry i */
+bool index_entry(IndexReader *index, int i, char *word, size_t size, int64_t *begin, int64_t *end) {
+    if (i < 0 || i >= index->dict_size || size == 0) {
+        return false;
+    }
+    if (index->header.version >= INDEX_VERSION_FRONT_CODED) {
+        return dictionary_entry(&index->dictionary, i, word, size, begin, end);
+    }
+
+    char key[MAX_KEY_SIZE + 1] = {0};
+    size_t entry = (size_t)(i + index->dict_first) * DICT_ENTRY_SIZE;
+    if (index->use_mmap) {
+        memcpy(key, index->dict.data + entry, MAX_KEY_SIZE);
+    } else if (pread(fileno(index->dict_file), key, MAX_KEY_SIZE, entry) != MAX_KEY_SIZE) {
+        return false;
+    }
+    strncpy(word, key, size - 1);
+    word[size - 1] = '\0';
+    *begin = dict_offset_at(index, i);
+    *end = i < index->dict_size - 1 ? dict_offset_at(index, i + 1) : index->posting_size;
+    return true;
+}
+
+/* Point into the mapping, or read the posting list into a buffer */
+bool index_read_postings(IndexReader *index, int64_t begin, int64_t end, PostingBytes *bytes) {
+    /* Offsets are 64 bit, a single list is decoded with int sizes */
+    if (begin < 0 || end < begin || end > index->posting_size || end - begin > INT_MAX) {
+        return false;
+    }
+    bytes->size = end - begin;
+
+    if (index->use_mmap) {
+        bytes->data = index->postings.data + begin;
+        bytes->owned = false;
+        if (bytes->size >= SEQUENTIAL_HINT_SIZE) {
+            /* Long list, ask for read ahead over the whole range */
+            long page = sysconf(_SC_PAGESIZE);
+            uintptr_t start = (uintptr_t)bytes->data & ~(uintptr_t)(page - 1);
+            size_t length = (uintptr_t)bytes->data + bytes->size - start;
+            madvise((void *)start, length, MADV_SEQUENTIAL);
+            madvise((void *)start, length, MADV_WILLNEED);
+        }
+        return true;
+    }
+
+    bytes->data = (unsigned char *)malloc(bytes->size ? bytes->size : 1);
+    bytes->owned = true;
+    if (bytes->data == NULL) {
+        return false;
+    }
+    if (bytes->size > 0 && pread(fileno(index->posting_file), bytes->data, bytes->size, begin) != (ssize_t)bytes->size) {
+        index_release_postings(bytes);
+        return false;
+    }
+    return true;
+}
+
+/* Free the copy made by the stdio path */
+void index_release_postings(PostingBytes *bytes) {
+    if (bytes->owned) {
+        free(bytes->data);
+    }
+    bytes->data = NULL;
+    bytes->size = 0;
+    bytes->owned = false;
+}
+
+/* An offset lookup in the loaded ID table */
+const char* index_doc_id(IndexReader *index, int doc_index) {
+    return doc_id_table_get(&index->doc_ids, doc_index);
+}
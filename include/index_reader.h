@@ -0,0 +1,164 @@
+/**
+ * @file index_reader.h
+ * @brief Read only access to the index files created by the indexer.
+ *
+ * The dictionary, posting list and document ID files are memory mapped
+ * so that dictionary lookups, posting list decoding and document ID
+ * resolution are plain pointer arithmetic on the mapped regions.
+ * If mapping is disabled or fails, posting lists are read with pread
+ * and the document ID store is read into memory once.
+ * Posting offsets are 64 bit, so posting files may exceed 4 GB.
+ * Once opened, every read goes through the mappings or pread, so one
+ * index can be shared by several searching threads.
+ * The document lengths for ranking are read into memory once, if present.
+ * Version 4 dictionaries keep their block index in memory (see dictionary.h),
+ * older ones are binary searched over their fixed size entries.
+ * The generation of an index identifies the files it was opened from, so
+ * long running readers can tell when the index has been rebuilt.
+ *
+ * @author Ubaada
+ * @date 01-04-2024
+ */
+
+#ifndef INDEX_READER_H
+#define INDEX_READER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "common.h"
+#include "postings.h"
+#include "ranking.h"
+#include "doc_ids.h"
+#include "dictionary.h"
+
+#define ID_FILE "data/doc_id_list.txt"
+#define DICT_FILE "data/dict_and_offset.bin"
+#define POSTING_FILE "data/posting_list.bin"
+
+/* A read only memory mapped file */
+typedef struct MappedFile {
+    unsigned char *data;
+    size_t size;
+} MappedFile;
+
+/* The opened index */
+typedef struct IndexReader {
+    bool use_mmap;
+    /* stdio fallback */
+    FILE *dict_file;
+    FILE *posting_file;
+    /* memory mapped files */
+    MappedFile dict;
+    MappedFile postings;
+    MappedFile ids; /* The document ID store, if mapped */
+    DocIdTable doc_ids;
+    IndexHeader header; /* Format of the index */
+    Dictionary dictionary; /* The front coded dictionary, from version 4 */
+    int dict_first; /* Entry of the first word, 1 if there is a header entry */
+    int dict_size; /* Number of words in the dictionary */
+    int64_t posting_size; /* Size of the posting lists in bytes, without the stamp trailer */
+    DocStats stats; /* Document lengths, for BM25 */
+    bool has_stats; /* false for indexes built without DOC_STATS_FILE */
+    uint64_t generation; /* index_generation() when opened */
+} IndexReader;
+
+/* Bytes of a posting list, either inside the mapping or a malloc'd copy */
+typedef struct PostingBytes {
+    unsigned char *data;
+    size_t size;
+    bool owned; /* true if data must be freed */
+} PostingBytes;
+
+/**
+ * Open the index files, mapping them into memory if use_mmap is true.
+ * Falls back to stdio if mapping fails.
+ *
+ * @param index The reader to open
+ * @param use_mmap Whether to memory map the files
+ * @return true if all files were opened, false otherwise
+ */
+bool index_open(IndexReader *index, bool use_mmap);
+
+/**
+ * Identify the current index files by their inode, size and change times.
+ * Rebuilding the index, in place or by renaming new files over the old
+ * ones, gives a different generation.
+ *
+ * @return The generation of the files on disk now
+ */
+uint64_t index_generation(void);
+
+/**
+ * Check that the postings, doc IDs and doc stats on disk carry the build
+ * stamp of the opened dictionary. The indexer renames its files into
+ * place one by one, so between two renames the files on disk belong to
+ * two builds. The files are read by path: only meaningful while the
+ * generation is still that of the opened index.
+ *
+ * @param index The opened index
+ * @return true if every stamp matches (all 0 for indexes without stamps)
+ */
+bool index_stamps_match(const IndexReader *index);
+
+/**
+ * Unmap and close the index files
+ *
+ * @param index The reader to close
+ */
+void index_close(IndexReader *index);
+
+/**
+ * Binary search the dictionary for a (stemmed) word
+ *
+ * @param index The opened index
+ * @param word The word to look up
+ * @param begin Set to the byte offset of the posting list
+ * @param end Set to the byte offset just past the posting list
+ * @return true if the word was found, false otherwise
+ */
+bool index_lookup(IndexReader *index, const char *word, int64_t *begin, int64_t *end);
+
+/**
+ * Get the word and posting list range of the i-th dictionary entry
+ *
+ * @param index The opened index
+ * @param i The entry, 0 to dict_size - 1 in sorted order
+ * @param word Buffer for the word, truncated to fit
+ * @param size The size of the buffer
+ * @param begin Set to the byte offset of the posting list
+ * @param end Set to the byte offset just past the posting list
+ * @return false if i is out of range, true otherwise
+ */
+bool index_entry(IndexReader *index, int i, char *word, size_t size, int64_t *begin, int64_t *end);
+
+/**
+ * Get the bytes of the posting list in [begin, end).
+ * Hints the kernel that the range is about to be read sequentially.
+ *
+ * @param index The opened index
+ * @param begin The byte offset of the posting list
+ * @param end The byte offset just past the posting list
+ * @param bytes Set to the posting list bytes, release with index_release_postings
+ * @return true on success, false if the range is invalid, over INT_MAX bytes or unreadable
+ */
+bool index_read_postings(IndexReader *index, int64_t begin, int64_t end, PostingBytes *bytes);
+
+/**
+ * Release the bytes returned by index_read_postings
+ *
+ * @param bytes The posting list bytes
+ */
+void index_release_postings(PostingBytes *bytes);
+
+/**
+ * Get the external document ID of a document index
+ *
+ * @param index The opened index
+ * @param doc_index The document index assigned by the indexer
+ * @return The ID, NUL terminated, valid until the index is closed
+ */
+const char* index_doc_id(IndexReader *index, int doc_index);
+
+#endif // INDEX_READER_H
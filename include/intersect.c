@@ -0,0 +1,283 @@
+/**
+ * @file intersect.c
+ * @brief Scalar, SSE2 and AVX2 sorted array intersection
+ */
+
+#include "intersect.h"
+#include <string.h>
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define INTERSECT_X86 1
+#include <immintrin.h>
+#endif
+
+static IntersectFunc block_kernel = NULL;
+static IntersectFunc broadcast_kernel = NULL;
+static const char *simd_name = "scalar";
+static int gallop_ratio = INTERSECT_GALLOP_RATIO_SCALAR;
+static pthread_once_t simd_once = PTHREAD_ONCE_INIT; /* Searcher threads intersect concurrently */
+
+/* Merge a[i..] with b[j..], appending after the n matches found so far */
+static int merge_from(const uint32_t *a, int i, int n_a, const uint32_t *b, int j, int n_b,
+                      int *match_a, int *match_b, int n) {
+    while (i < n_a && j < n_b) {
+        if (a[i] < b[j]) {
+            i++;
+        } else if (a[i] > b[j]) {
+            j++;
+        } else {
+            match_a[n] = i++;
+            match_b[n] = j++;
+            n++;
+        }
+    }
+    return n;
+}
+
+int intersect_merge(const uint32_t *a, int n_a, const uint32_t *b, int n_b, int *match_a, int *match_b) {
+    return merge_from(a, 0, n_a, b, 0, n_b, match_a, match_b, 0);
+}
+
+/* First position at or after from with values[position] >= target, size if none */
+static int gallop_geq(const uint32_t *values, int size, int from, uint32_t target) {
+    if (from >= size || values[from] >= target) {
+        return from;
+    }
+    /* values[low] < target, bracket the target with doubling steps */
+    int low = from;
+    int step = 1;
+    while (low + step < size && values[low + step] < target) {
+        low += step;
+        step *= 2;
+    }
+    int high = low + step < size ? low + step : size;
+    /* Binary search (low, high] */
+    while (low + 1 < high) {
+        int mid = low + (high - low) / 2;
+        if (values[mid] < target) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+    return high;
+}
+
+int intersect_gallop(const uint32_t *a, int n_a, const uint32_t *b, int n_b, int *match_a, int *match_b) {
+    int n = 0;
+    int j = 0;
+    for (int i = 0; i < n_a && j < n_b; i++) {
+        j = gallop_geq(b, n_b, j, a[i]);
+        if (j < n_b && b[j] == a[i]) {
+            match_a[n] = i;
+            match_b[n] = j++;
+            n++;
+        }
+    }
+    return n;
+}
+
+/* Record the values of a's block at i flagged in mask, finding each in b's block at j */
+static inline int record_block(const uint32_t *a, int i, const uint32_t *b, int j, int mask,
+                               int *match_a, int *match_b, int n) {
+    while (mask != 0) {
+        int k = __builtin_ctz(mask);
+        mask &= mask - 1;
+        int t = 0;
+        while (b[j + t] != a[i + k]) t++;
+        match_a[n] = i + k;
+        match_b[n] = j + t;
+        n++;
+    }
+    return n;
+}
+
+#ifdef INTERSECT_X86
+/* 4 x 4 all against all: a block compared with the 4 rotations of b's block */
+__attribute__((target("sse2")))
+static int intersect_block_sse2(const uint32_t *a, int n_a, const uint32_t *b, int n_b, int *match_a, int *match_b) {
+    int i = 0;
+    int j = 0;
+    int n = 0;
+    while (i + 4 <= n_a && j + 4 <= n_b) {
+        __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i *)(b + j));
+        __m128i eq = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi32(va, vb),
+                         _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1)))),
+            _mm_or_si128(_mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2))),
+                         _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(2, 1, 0, 3)))));
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(eq));
+        if (mask != 0) {
+            n = record_block(a, i, b, j, mask, match_a, match_b, n);
+        }
+        uint32_t a_last = a[i + 3];
+        uint32_t b_last = b[j + 3];
+        i += a_last <= b_last ? 4 : 0;
+        j += b_last <= a_last ? 4 : 0;
+    }
+    return merge_from(a, i, n_a, b, j, n_b, match_a, match_b, n);
+}
+
+/* 8 x 8 all against all: a block compared with each value of b's block broadcast */
+__attribute__((target("avx2")))
+static int intersect_block_avx2(const uint32_t *a, int n_a, const uint32_t *b, int n_b, int *match_a, int *match_b) {
+    int i = 0;
+    int j = 0;
+    int n = 0;
+    while (i + 8 <= n_a && j + 8 <= n_b) {
+        /* Broadcasts load straight from memory, leaving the shuffle port free */
+        __m256i va = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i eq = _mm256_or_si256(
+            _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi32(va, _mm256_set1_epi32(b[j])),
+                                            _mm256_cmpeq_epi32(va, _mm256_set1_epi32(b[j + 1]))),
+                            _mm256_or_si256(_mm256_cmpeq_epi32(va, _mm256_set1_epi32(b[j + 2])),
+                                            _mm256_cmpeq_epi32(va, _mm256_set1_epi32(b[j + 3])))),
+            _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi32(va, _mm256_set1_epi32(b[j + 4])),
+                                            _mm256_cmpeq_epi32(va, _mm256_set1_epi32(b[j + 5]))),
+                            _mm256_or_si256(_mm256_cmpeq_epi32(va, _mm256_set1_epi32(b[j + 6])),
+                                            _mm256_cmpeq_epi32(va, _mm256_set1_epi32(b[j + 7])))));
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(eq));
+        if (mask != 0) {
+            n = record_block(a, i, b, j, mask, match_a, match_b, n);
+        }
+        uint32_t a_last = a[i + 7];
+        uint32_t b_last = b[j + 7];
+        i += a_last <= b_last ? 8 : 0;
+        j += b_last <= a_last ? 8 : 0;
+    }
+    return merge_from(a, i, n_a, b, j, n_b, match_a, match_b, n);
+}
+
+/* Each value of a against 4 values of b, whole blocks of b below it skipped */
+__attribute__((target("sse2")))
+static int intersect_broadcast_sse2(const uint32_t *a, int n_a, const uint32_t *b, int n_b, int *match_a, int *match_b) {
+    int i = 0;
+    int j = 0;
+    int n = 0;
+    for (; i < n_a; i++) {
+        uint32_t value = a[i];
+        while (j + 4 <= n_b && b[j + 3] < value) j += 4;
+        if (j + 4 > n_b) break;
+        __m128i eq = _mm_cmpeq_epi32(_mm_set1_epi32(value), _mm_loadu_si128((const __m128i *)(b + j)));
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(eq));
+        if (mask != 0) {
+            match_a[n] = i;
+            match_b[n] = j + __builtin_ctz(mask);
+            j = match_b[n] + 1;
+            n++;
+        }
+    }
+    return merge_from(a, i, n_a, b, j, n_b, match_a, match_b, n);
+}
+
+/* Each value of a against 8 values of b, whole blocks of b below it skipped */
+__attribute__((target("avx2")))
+static int intersect_broadcast_avx2(const uint32_t *a, int n_a, const uint32_t *b, int n_b, int *match_a, int *match_b) {
+    int i = 0;
+    int j = 0;
+    int n = 0;
+    for (; i < n_a; i++) {
+        uint32_t value = a[i];
+        while (j + 8 <= n_b && b[j + 7] < value) j += 8;
+        if (j + 8 > n_b) break;
+        __m256i eq = _mm256_cmpeq_epi32(_mm256_set1_epi32(value), _mm256_loadu_si256((const __m256i *)(b + j)));
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(eq));
+        if (mask != 0) {
+            match_a[n] = i;
+            match_b[n] = j + __builtin_ctz(mask);
+            j = match_b[n] + 1;
+            n++;
+        }
+    }
+    return merge_from(a, i, n_a, b, j, n_b, match_a, match_b, n);
+}
+#endif
+
+/* Pick the best kernels the CPU supports */
+static void select_simd(void) {
+    block_kernel = intersect_merge;
+    broadcast_kernel = intersect_merge;
+    simd_name = "scalar";
+    gallop_ratio = INTERSECT_GALLOP_RATIO_SCALAR;
+#ifdef INTERSECT_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        block_kernel = intersect_block_avx2;
+        broadcast_kernel = intersect_broadcast_avx2;
+        simd_name = "avx2";
+        gallop_ratio = INTERSECT_GALLOP_RATIO;
+    } else if (__builtin_cpu_supports("sse2")) {
+        block_kernel = intersect_block_sse2;
+        broadcast_kernel = intersect_broadcast_sse2;
+        simd_name = "sse2";
+        gallop_ratio = INTERSECT_GALLOP_RATIO;
+    }
+#endif
+}
+
+/* Force an implementation, for benchmarking */
+bool intersect_set_simd(const char *name) {
+    pthread_once(&simd_once, select_simd);
+    if (strcmp(name, "scalar") == 0) {
+        block_kernel = intersect_merge;
+        broadcast_kernel = intersect_merge;
+        simd_name = "scalar";
+        gallop_ratio = INTERSECT_GALLOP_RATIO_SCALAR;
+        return true;
+    }
+#ifdef INTERSECT_X86
+    __builtin_cpu_init();
+    if (strcmp(name, "sse2") == 0 && __builtin_cpu_supports("sse2")) {
+        block_kernel = intersect_block_sse2;
+        broadcast_kernel = intersect_broadcast_sse2;
+        simd_name = "sse2";
+        gallop_ratio = INTERSECT_GALLOP_RATIO;
+        return true;
+    }
+    if (strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2")) {
+        block_kernel = intersect_block_avx2;
+        broadcast_kernel = intersect_broadcast_avx2;
+        simd_name = "avx2";
+        gallop_ratio = INTERSECT_GALLOP_RATIO;
+        return true;
+    }
+#endif
+    return false;
+}
+
+/* Name of the implementation in use */
+const char* intersect_simd_name(void) {
+    pthread_once(&simd_once, select_simd);
+    return simd_name;
+}
+
+int intersect_block(const uint32_t *a, int n_a, const uint32_t *b, int n_b, int *match_a, int *match_b) {
+    pthread_once(&simd_once, select_simd);
+    return block_kernel(a, n_a, b, n_b, match_a, match_b);
+}
+
+int intersect_broadcast(const uint32_t *a, int n_a, const uint32_t *b, int n_b, int *match_a, int *match_b) {
+    pthread_once(&simd_once, select_simd);
+    return broadcast_kernel(a, n_a, b, n_b, match_a, match_b);
+}
+
+/* Shorter array first, then the kernel by the ratio of the lengths */
+int intersect_adaptive(const uint32_t *a, int n_a, const uint32_t *b, int n_b, int *match_a, int *match_b) {
+    if (n_a > n_b) {
+        return intersect_adaptive(b, n_b, a, n_a, match_b, match_a);
+    }
+    if (n_a == 0) {
+        return 0;
+    }
+    pthread_once(&simd_once, select_simd);
+    int ratio = n_b / n_a;
+    if (ratio >= gallop_ratio) {
+        return intersect_gallop(a, n_a, b, n_b, match_a, match_b);
+    }
+    if (ratio >= INTERSECT_BROADCAST_RATIO) {
+        return intersect_broadcast(a, n_a, b, n_b, match_a, match_b);
+    }
+    return intersect_block(a, n_a, b, n_b, match_a, match_b);
+}
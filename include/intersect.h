@@ -0,0 +1,95 @@
+/**
+ * @file intersect.h
+ * @brief Intersection kernels for increasing arrays of 32-bit doc_ids.
+ *
+ * Every kernel reports the common values as pairs of positions, one in
+ * each array, in increasing order, so the caller can fetch the freqs
+ * and scores that sit beside the doc_ids.
+ *
+ * intersect_merge: scalar merge, one comparison per step.
+ * intersect_gallop: each value of the short array gallops (1, 2, 4, ...)
+ *     through the long one, then binary searches. Best for very skewed sizes.
+ * intersect_block: a block of 4 (SSE2) or 8 (AVX2) values of each array
+ *     is compared all against all, against the rotations (SSE2) or the
+ *     broadcast values (AVX2) of the other block, and the block with the
+ *     smaller last value is advanced. Best for similar sizes.
+ * intersect_broadcast: each value of the short array is broadcast and
+ *     compared against a block of the long array, skipping whole blocks
+ *     below it. Best in between.
+ * The SIMD kernels fall back to the scalar merge on CPUs without
+ * SSE2/AVX2. The best implementation is chosen at runtime.
+ * intersect_adaptive picks the kernel from the ratio of the lengths.
+ *
+ * @author Ubaada
+ * @date 01-04-2024
+ */
+
+#ifndef INTERSECT_H
+#define INTERSECT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define INTERSECT_BROADCAST_RATIO 4 /* From this length ratio the short array is broadcast */
+#define INTERSECT_GALLOP_RATIO 1024 /* From this length ratio the short array gallops (whole decoded lists only) */
+#define INTERSECT_GALLOP_RATIO_SCALAR 32 /* The same without SIMD, as the merge does the broadcasting */
+
+/*
+ * A kernel: finds the values common to a and b.
+ * match_a and match_b need room for the smaller of n_a and n_b.
+ * Returns the number of common values.
+ */
+typedef int (*IntersectFunc)(const uint32_t *a, int n_a, const uint32_t *b, int n_b, int *match_a, int *match_b);
+
+/**
+ * Intersect with the scalar merge
+ *
+ * @param a Increasing values
+ * @param n_a The number of values of a
+ * @param b Increasing values
+ * @param n_b The number of values of b
+ * @param match_a Receives the position in a of each common value
+ * @param match_b Receives the position in b of each common value
+ * @return The number of common values
+ */
+int intersect_merge(const uint32_t *a, int n_a, const uint32_t *b, int n_b, int *match_a, int *match_b);
+
+/* Intersect by galloping the values of a through b, a being the shorter array */
+int intersect_gallop(const uint32_t *a, int n_a, const uint32_t *b, int n_b, int *match_a, int *match_b);
+
+/* Intersect with the SIMD all against all block compare */
+int intersect_block(const uint32_t *a, int n_a, const uint32_t *b, int n_b, int *match_a, int *match_b);
+
+/* Intersect by broadcasting the values of a against blocks of b, a being the shorter array */
+int intersect_broadcast(const uint32_t *a, int n_a, const uint32_t *b, int n_b, int *match_a, int *match_b);
+
+/**
+ * Intersect with the kernel suited to the lengths: the block compare
+ * for similar lengths, broadcasting from INTERSECT_BROADCAST_RATIO and
+ * galloping from INTERSECT_GALLOP_RATIO (INTERSECT_GALLOP_RATIO_SCALAR
+ * without SIMD). Against one posting block (POSTING_BLOCK_SIZE doc_ids)
+ * the ratio stays below INTERSECT_GALLOP_RATIO, where broadcasting is
+ * faster and the skip table already jumps the blocks; with SIMD the
+ * searcher gallops only through lists held decoded whole.
+ * Either array may be the shorter.
+ * Parameters as intersect_merge.
+ */
+int intersect_adaptive(const uint32_t *a, int n_a, const uint32_t *b, int n_b, int *match_a, int *match_b);
+
+/**
+ * Force the SIMD implementation of the block and broadcast kernels.
+ * The default is the best one the CPU supports.
+ *
+ * @param name "scalar", "sse2" or "avx2"
+ * @return false if the implementation is unknown or not supported by the CPU
+ */
+bool intersect_set_simd(const char *name);
+
+/**
+ * Get the name of the SIMD implementation in use
+ *
+ * @return "scalar", "sse2" or "avx2"
+ */
+const char* intersect_simd_name(void);
+
+#endif // INTERSECT_H
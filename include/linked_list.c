@@ -11,12 +11,34 @@ LinkedList* linkedlist_create(int (*cmp)(const void *, const void *)){
     list->head = NULL;
     list->tail = NULL;
     list->cmp = cmp;
+    list->arena = NULL;
     return list;
 }
 
+/* Create a linked list in an arena */
+LinkedList* linkedlist_create_arena(int (*cmp)(const void *, const void *), Arena *arena) {
+    LinkedList *list = (LinkedList *)arena_alloc(arena, sizeof(LinkedList));
+    list->head = NULL;
+    list->tail = NULL;
+    list->cmp = cmp;
+    list->arena = arena;
+    return list;
+}
+
+/* Allocate a node from the arena or the heap */
+static Node* alloc_node(LinkedList *list) {
+    if (list->arena != NULL) {
+        return (Node *)arena_alloc(list->arena, sizeof(Node));
+    }
+    return (Node *)malloc(sizeof(Node));
+}
+
 
 /* Delete the linked list */
 void linkedlist_delete(LinkedList *list) {
+    if (list->arena != NULL) {
+        return; /* Released with the arena */
+    }
     Node *current = list->head;
     while (current != NULL) {
         Node *toDelete = current;
@@ -29,7 +51,7 @@ void linkedlist_delete(LinkedList *list) {
 
 /* Add node on top of the linked list */
 bool linkedlist_add_head(LinkedList *list, void *data) {
-    Node *newNode = (Node *)malloc(sizeof(Node));
+    Node *newNode = alloc_node(list);
     if (newNode == NULL) {
         return false;
     }
@@ -46,7 +68,7 @@ bool linkedlist_add_head(LinkedList *list, void *data) {
 
 /* Add node at the end of the linked list */
 bool linkedlist_add_tail(LinkedList *list, void *data) {
-    Node *newNode = (Node *)malloc(sizeof(Node));
+    Node *newNode = alloc_node(list);
     if (newNode == NULL) {
         return false;
     }
@@ -73,8 +95,10 @@ bool linkedlist_delete_node(LinkedList *list, void *data) {
         if (list->cmp((*indirect)->data, data) == 0) {
             Node *toDelete = *indirect;
             *indirect = (*indirect)->next;
-            free(toDelete->data); // Assuming data was dynamically allocated
-            free(toDelete);
+            if (list->arena == NULL) {
+                free(toDelete->data); // Assuming data was dynamically allocated
+                free(toDelete);
+            }
             return true;
         }
         indirect = &(*indirect)->next;
@@ -14,6 +14,7 @@
 #define LINKED_LIST_H
 
 #include <stdbool.h>
+#include "arena.h"
 
 /* Define a node of the linked list */
 typedef struct Node {
@@ -26,6 +27,7 @@ typedef struct LinkedList {
     Node *head;                      
     Node *tail;  
     int (*cmp)(const void *, const void *); /* Function pointer for comparing two nodes */
+    Arena *arena; /* Nodes come from here if set, instead of malloc */
 } LinkedList;
 
 
@@ -39,6 +41,17 @@ typedef struct LinkedList {
  */
 LinkedList* linkedlist_create(int (*cmp)(const void *, const void *));
 
+/** 
+ * Create a linked list in an arena. The list and its nodes are allocated
+ * from the arena and released with it, linkedlist_delete does nothing.
+ * The data added should live in the arena too.
+ * 
+ * @param cmp A function pointer to compare two elements.
+ * @param arena The arena to allocate from.
+ * @return A pointer to the newly created linked list.
+ */
+LinkedList* linkedlist_create_arena(int (*cmp)(const void *, const void *), Arena *arena);
+
 /** 
  * Delete the linked list and free all associated memory.
  * 
@@ -0,0 +1,176 @@
+/**
+ * @file posting_cache.c
+ * @brief CLOCK cache of decoded posting lists
+ */
+
+#include "posting_cache.h"
+#include "common.h"
+#include <stdlib.h>
+#include <string.h>
+
+bool posting_cache_init(PostingCache *cache, size_t budget) {
+    memset(cache, 0, sizeof(PostingCache));
+    cache->budget = budget;
+    cache->n_buckets = POSTING_CACHE_BUCKETS;
+    cache->buckets = (CachedPostings **)calloc(cache->n_buckets, sizeof(CachedPostings *));
+    cache->capacity = 256;
+    cache->clock = (CachedPostings **)malloc(cache->capacity * sizeof(CachedPostings *));
+    atomic_init(&cache->hits, 0);
+    atomic_init(&cache->misses, 0);
+    atomic_init(&cache->evictions, 0);
+    if (cache->buckets == NULL || cache->clock == NULL || pthread_rwlock_init(&cache->lock, NULL) != 0) {
+        free(cache->buckets);
+        free(cache->clock);
+        return false;
+    }
+    return true;
+}
+
+/* The entry of a word in its bucket, NULL if absent. Needs a lock held. */
+static CachedPostings* find_entry(PostingCache *cache, const char *word, uint32_t hash) {
+    CachedPostings *entry = cache->buckets[hash & (cache->n_buckets - 1)];
+    while (entry != NULL && (entry->hash != hash || strcmp(entry->word, word) != 0)) {
+        entry = entry->next;
+    }
+    return entry;
+}
+
+CachedPostings* posting_cache_get(PostingCache *cache, const char *word) {
+    uint32_t hash = hash_fnv1a(word, strlen(word));
+    pthread_rwlock_rdlock(&cache->lock);
+    CachedPostings *entry = find_entry(cache, word, hash);
+    if (entry != NULL) {
+        /* Held before the lock goes, so an eviction can't free it */
+        atomic_fetch_add_explicit(&entry->refs, 1, memory_order_relaxed);
+        atomic_store_explicit(&entry->referenced, true, memory_order_relaxed);
+    }
+    pthread_rwlock_unlock(&cache->lock);
+    atomic_fetch_add_explicit(entry != NULL ? &cache->hits : &cache->misses, 1, memory_order_relaxed);
+    return entry;
+}
+
+void posting_cache_release(CachedPostings *entry) {
+    if (atomic_fetch_sub_explicit(&entry->refs, 1, memory_order_acq_rel) == 1) {
+        decoded_postings_free(&entry->list);
+        free(entry->word);
+        free(entry);
+    }
+}
+
+/* Take an entry out of its hash bucket. Needs the write lock. */
+static void unlink_entry(PostingCache *cache, CachedPostings *entry) {
+    CachedPostings **link = &cache->buckets[entry->hash & (cache->n_buckets - 1)];
+    while (*link != entry) {
+        link = &(*link)->next;
+    }
+    *link = entry->next;
+}
+
+/* Double the buckets once there are more entries than buckets. Needs the write lock. */
+static void grow_buckets(PostingCache *cache) {
+    int n_buckets = cache->n_buckets * 2;
+    CachedPostings **buckets = (CachedPostings **)calloc(n_buckets, sizeof(CachedPostings *));
+    if (buckets == NULL) {
+        return; /* Longer chains, still correct */
+    }
+    for (int i = 0; i < cache->n_entries; i++) {
+        CachedPostings *entry = cache->clock[i];
+        entry->next = buckets[entry->hash & (n_buckets - 1)];
+        buckets[entry->hash & (n_buckets - 1)] = entry;
+    }
+    free(cache->buckets);
+    cache->buckets = buckets;
+    cache->n_buckets = n_buckets;
+}
+
+/* Sweep the hand until bytes more fit the budget. Needs the write lock. */
+static void make_room(PostingCache *cache, size_t bytes) {
+    while (cache->n_entries > 0 && cache->used + bytes > cache->budget) {
+        if (cache->hand >= cache->n_entries) {
+            cache->hand = 0;
+        }
+        CachedPostings *entry = cache->clock[cache->hand];
+        if (atomic_exchange_explicit(&entry->referenced, false, memory_order_relaxed)) {
+            cache->hand += 1; /* Second chance */
+            continue;
+        }
+        /* The last entry takes its place in the clock */
+        unlink_entry(cache, entry);
+        cache->clock[cache->hand] = cache->clock[--cache->n_entries];
+        cache->used -= entry->bytes;
+        atomic_fetch_add_explicit(&cache->evictions, 1, memory_order_relaxed);
+        posting_cache_release(entry);
+    }
+}
+
+CachedPostings* posting_cache_put(PostingCache *cache, const char *word, DecodedPostings *list) {
+    CachedPostings *entry = (CachedPostings *)malloc(sizeof(CachedPostings));
+    entry->list = *list;
+    entry->word = strdup(word);
+    entry->hash = hash_fnv1a(word, strlen(word));
+    entry->bytes = decoded_postings_bytes(list) + sizeof(CachedPostings) + strlen(word) + 1;
+    atomic_init(&entry->refs, 1);
+    atomic_init(&entry->referenced, false);
+    entry->next = NULL;
+    if (entry->bytes > cache->budget) {
+        return entry; /* Used once by the caller only */
+    }
+
+    pthread_rwlock_wrlock(&cache->lock);
+    CachedPostings *existing = find_entry(cache, word, entry->hash);
+    if (existing != NULL) {
+        atomic_fetch_add_explicit(&existing->refs, 1, memory_order_relaxed);
+        pthread_rwlock_unlock(&cache->lock);
+        posting_cache_release(entry);
+        return existing;
+    }
+    make_room(cache, entry->bytes);
+    if (cache->n_entries == cache->capacity) {
+        cache->capacity *= 2;
+        cache->clock = (CachedPostings **)realloc(cache->clock, cache->capacity * sizeof(CachedPostings *));
+    }
+    if (cache->n_entries >= cache->n_buckets) {
+        grow_buckets(cache);
+    }
+    cache->clock[cache->n_entries++] = entry;
+    entry->next = cache->buckets[entry->hash & (cache->n_buckets - 1)];
+    cache->buckets[entry->hash & (cache->n_buckets - 1)] = entry;
+    cache->used += entry->bytes;
+    atomic_fetch_add_explicit(&entry->refs, 1, memory_order_relaxed); /* The cache's hold */
+    pthread_rwlock_unlock(&cache->lock);
+    return entry;
+}
+
+void posting_cache_report(PostingCache *cache, FILE *out) {
+    long hits = atomic_load(&cache->hits);
+    long misses = atomic_load(&cache->misses);
+    pthread_rwlock_rdlock(&cache->lock);
+    fprintf(out, "  cache:      %ld hits, %ld misses (%.1f%% hits), %ld evictions, %d words in %.1f of %.1f MB\n",
+            hits, misses, hits + misses > 0 ? 100.0 * hits / (hits + misses) : 0, atomic_load(&cache->evictions),
+            cache->n_entries, cache->used / (1024.0 * 1024.0), cache->budget / (1024.0 * 1024.0));
+    pthread_rwlock_unlock(&cache->lock);
+}
+
+void posting_cache_clear(PostingCache *cache) {
+    pthread_rwlock_wrlock(&cache->lock);
+    for (int i = 0; i < cache->n_entries; i++) {
+        posting_cache_release(cache->clock[i]);
+    }
+    memset(cache->buckets, 0, cache->n_buckets * sizeof(CachedPostings *));
+    cache->n_entries = 0;
+    cache->used = 0;
+    cache->hand = 0;
+    pthread_rwlock_unlock(&cache->lock);
+}
+
+void posting_cache_free(PostingCache *cache) {
+    for (int i = 0; i < cache->n_entries; i++) {
+        posting_cache_release(cache->clock[i]);
+    }
+    free(cache->clock);
+    free(cache->buckets);
+    pthread_rwlock_destroy(&cache->lock);
+    cache->clock = NULL;
+    cache->buckets = NULL;
+    cache->n_entries = 0;
+}
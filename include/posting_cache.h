@@ -0,0 +1,114 @@
+/**
+ * @file posting_cache.h
+ * @brief Cache of decoded posting lists of hot words, for the searcher.
+ *
+ * Entries are a word and its posting list decoded whole (DecodedPostings),
+ * kept within a byte budget. Eviction follows the CLOCK algorithm: a hit
+ * sets the entry's reference bit, and the hand sweeps the entries, giving
+ * a referenced entry a second chance and evicting the first one without.
+ * Hits only take the read lock, so queries on several threads are served
+ * concurrently; inserts take the write lock. Entries are reference
+ * counted, an entry evicted while a query reads it is freed on release.
+ *
+ * @author Ubaada
+ * @date 01-04-2024
+ */
+
+#ifndef POSTING_CACHE_H
+#define POSTING_CACHE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "postings.h"
+
+#define POSTING_CACHE_BUCKETS 1024 /* Initial hash buckets, doubled as entries are added */
+
+/* A cached word and its decoded posting list */
+typedef struct CachedPostings {
+    DecodedPostings list;
+    char *word;
+    uint32_t hash;
+    size_t bytes; /* Memory charged to the budget */
+    atomic_int refs; /* The cache while the entry is in it, and every reader */
+    atomic_bool referenced; /* CLOCK bit, set on every hit */
+    struct CachedPostings *next; /* Next entry of the hash bucket */
+} CachedPostings;
+
+typedef struct PostingCache {
+    pthread_rwlock_t lock;
+    size_t budget; /* Bytes the entries may take */
+    size_t used;
+    CachedPostings **buckets;
+    int n_buckets; /* A power of two */
+    CachedPostings **clock; /* The entries in the order the hand visits them */
+    int n_entries;
+    int capacity;
+    int hand;
+    atomic_long hits;
+    atomic_long misses;
+    atomic_long evictions;
+} PostingCache;
+
+/**
+ * Create an empty cache
+ *
+ * @param cache The cache
+ * @param budget Bytes the decoded lists may take
+ * @return false if out of memory
+ */
+bool posting_cache_init(PostingCache *cache, size_t budget);
+
+/**
+ * Find a word, counting a hit or a miss
+ *
+ * @param cache The cache
+ * @param word The (stemmed) word
+ * @return The entry, held until posting_cache_release, NULL on a miss
+ */
+CachedPostings* posting_cache_get(PostingCache *cache, const char *word);
+
+/**
+ * Add the decoded list of a word after a miss. Evicts entries until it
+ * fits the budget; a list larger than the whole budget isn't kept, but
+ * is still returned for the caller to use.
+ * If another thread added the word meanwhile, its entry is returned and
+ * the given list is freed.
+ *
+ * @param cache The cache
+ * @param word The (stemmed) word
+ * @param list The decoded list, owned by the cache from here on
+ * @return The entry, held until posting_cache_release
+ */
+CachedPostings* posting_cache_put(PostingCache *cache, const char *word, DecodedPostings *list);
+
+/**
+ * Let go of an entry returned by posting_cache_get or posting_cache_put
+ *
+ * @param entry The entry
+ */
+void posting_cache_release(CachedPostings *entry);
+
+/**
+ * Print the hit rate and memory use of the cache
+ *
+ * @param cache The cache
+ * @param out The stream to print to
+ */
+void posting_cache_report(PostingCache *cache, FILE *out);
+
+/**
+ * Drop every entry, as when the index has changed. Lists still in use
+ * are freed when released.
+ *
+ * @param cache The cache
+ */
+void posting_cache_clear(PostingCache *cache);
+
+/* Free every entry and the cache */
+void posting_cache_free(PostingCache *cache);
+
+#endif // POSTING_CACHE_H
@@ -0,0 +1,611 @@
+/**
+ * @file postings.c
+ * @brief Encoding and decoding of the on-disk posting lists
+ */
+
+#include "postings.h"
+#include "codec.h"
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+
+#define HEADER_MAGIC_OFFSET 1
+#define HEADER_VERSION_OFFSET 8
+#define HEADER_BLOCK_SIZE_OFFSET 12
+#define HEADER_CODEC_OFFSET 16
+#define HEADER_STAMP_OFFSET 20
+
+/* Store an integer big-endian in memory */
+static void put_int_big_endian(unsigned char *bytes, int value) {
+    bytes[0] = (value >> 24) & 0xFF;
+    bytes[1] = (value >> 16) & 0xFF;
+    bytes[2] = (value >> 8) & 0xFF;
+    bytes[3] = value & 0xFF;
+}
+
+/* Load a big-endian integer from memory */
+static int get_int_big_endian(const unsigned char *bytes) {
+    return (int)(((uint32_t)bytes[0] << 24) |
+                 ((uint32_t)bytes[1] << 16) |
+                 ((uint32_t)bytes[2] << 8) |
+                  (uint32_t)bytes[3]);
+}
+
+/* Store a 64 bit number big-endian in memory */
+static void put_stamp(unsigned char *bytes, uint64_t stamp) {
+    put_int_big_endian(bytes, (int)(stamp >> 32));
+    put_int_big_endian(bytes + 4, (int)(stamp & 0xFFFFFFFF));
+}
+
+/* Load a 64 bit big-endian number from memory */
+static uint64_t get_stamp(const unsigned char *bytes) {
+    return ((uint64_t)(uint32_t)get_int_big_endian(bytes) << 32) | (uint32_t)get_int_big_endian(bytes + 4);
+}
+
+/* Header entry: NUL, magic, version, block size, codec, stamp, zero padding */
+void index_header_write(FILE *fp_dict, const IndexHeader *header) {
+    unsigned char entry[MAX_KEY_SIZE + OFFSET_SIZE] = {0};
+    memcpy(entry + HEADER_MAGIC_OFFSET, INDEX_MAGIC, strlen(INDEX_MAGIC));
+    put_int_big_endian(entry + HEADER_VERSION_OFFSET, header->version);
+    put_int_big_endian(entry + HEADER_BLOCK_SIZE_OFFSET, header->block_size);
+    put_int_big_endian(entry + HEADER_CODEC_OFFSET, header->codec);
+    put_stamp(entry + HEADER_STAMP_OFFSET, header->stamp);
+    fwrite(entry, sizeof(entry), 1, fp_dict);
+}
+
+/* A word never starts with NUL, so a leading NUL marks the header */
+bool index_header_read(const unsigned char *entry, IndexHeader *header) {
+    if (entry[0] != '\0' || memcmp(entry + HEADER_MAGIC_OFFSET, INDEX_MAGIC, strlen(INDEX_MAGIC)) != 0) {
+        header->version = INDEX_VERSION_PLAIN;
+        header->block_size = 0;
+        header->codec = CODEC_VBYTE;
+        header->stamp = 0;
+        return false;
+    }
+    header->version = get_int_big_endian(entry + HEADER_VERSION_OFFSET);
+    header->block_size = get_int_big_endian(entry + HEADER_BLOCK_SIZE_OFFSET);
+    header->codec = get_int_big_endian(entry + HEADER_CODEC_OFFSET);
+    header->stamp = get_stamp(entry + HEADER_STAMP_OFFSET); /* Zero padding before stamps */
+    return true;
+}
+
+void index_stamp_append(FILE *fp, uint64_t stamp) {
+    unsigned char trailer[INDEX_STAMP_SIZE] = {0};
+    memcpy(trailer, INDEX_STAMP_MAGIC, strlen(INDEX_STAMP_MAGIC));
+    put_stamp(trailer + 8, stamp);
+    fwrite(trailer, sizeof(trailer), 1, fp);
+}
+
+uint64_t index_stamp_read(int fd, int64_t size) {
+    unsigned char trailer[INDEX_STAMP_SIZE];
+    if (size < INDEX_STAMP_SIZE || pread(fd, trailer, sizeof(trailer), size - INDEX_STAMP_SIZE) != INDEX_STAMP_SIZE
+            || memcmp(trailer, INDEX_STAMP_MAGIC, strlen(INDEX_STAMP_MAGIC)) != 0) {
+        return 0;
+    }
+    return get_stamp(trailer + 8);
+}
+
+/* Make room for at least extra more bytes */
+void bytebuffer_reserve(ByteBuffer *buffer, size_t extra) {
+    if (buffer->size + extra <= buffer->capacity) {
+        return;
+    }
+    size_t capacity = buffer->capacity ? buffer->capacity : 256;
+    while (capacity < buffer->size + extra) {
+        capacity *= 2;
+    }
+    unsigned char *data = (unsigned char *)realloc(buffer->data, capacity);
+    if (data == NULL) {
+        printf("Error: Out of memory\n");
+        exit(1);
+    }
+    buffer->data = data;
+    buffer->capacity = capacity;
+}
+
+/* Same byte layout as variable_byte_encode: 7 bits per byte, most
+ * significant group first, high bit set on the final byte */
+void bytebuffer_put_vbyte(ByteBuffer *buffer, int n) {
+    unsigned char bytes[5];
+    int i = 0;
+    unsigned int value = (unsigned int)n;
+    do {
+        bytes[i++] = value & 127;
+        value >>= 7;
+    } while (value > 0);
+    bytes[0] |= 128;
+
+    bytebuffer_reserve(buffer, i);
+    while (i > 0) {
+        buffer->data[buffer->size++] = bytes[--i];
+    }
+}
+
+/* Same as bytebuffer_put_vbyte, up to 10 bytes */
+void bytebuffer_put_vbyte64(ByteBuffer *buffer, uint64_t value) {
+    unsigned char bytes[10];
+    int i = 0;
+    do {
+        bytes[i++] = value & 127;
+        value >>= 7;
+    } while (value > 0);
+    bytes[0] |= 128;
+
+    bytebuffer_reserve(buffer, i);
+    while (i > 0) {
+        buffer->data[buffer->size++] = bytes[--i];
+    }
+}
+
+/* Append raw bytes */
+void bytebuffer_put(ByteBuffer *buffer, const void *bytes, size_t size) {
+    bytebuffer_reserve(buffer, size);
+    memcpy(buffer->data + buffer->size, bytes, size);
+    buffer->size += size;
+}
+
+/* Free the buffer memory */
+void bytebuffer_free(ByteBuffer *buffer) {
+    free(buffer->data);
+    buffer->data = NULL;
+    buffer->size = 0;
+    buffer->capacity = 0;
+}
+
+/* Decode one integer, stops at the end of the data */
+int vbyte_get(const unsigned char **p, const unsigned char *end) {
+    const unsigned char *q = *p;
+    unsigned int res = 0; /* Corrupt data may overflow, wrap instead */
+    while (q < end && !(*q & 128)) {
+        res = (res | *q) << 7;
+        q++;
+    }
+    if (q < end) {
+        res |= *q ^ 128;
+        q++;
+    }
+    *p = q;
+    return (int)res;
+}
+
+int64_t vbyte_get64(const unsigned char **p, const unsigned char *end) {
+    const unsigned char *q = *p;
+    uint64_t res = 0;
+    while (q < end && !(*q & 128)) {
+        res = (res | *q) << 7;
+        q++;
+    }
+    if (q < end) {
+        res |= *q ^ 128;
+        q++;
+    }
+    *p = q;
+    return (int64_t)res;
+}
+
+/* Upper bound of tf / (tf + norm) over some postings, rounded up a step
+ * past the largest so float rounding in the searcher stays below it */
+static int upper_bound(const int *docs, const int *freqs, int n, const float *norm) {
+    float max = 0;
+    for (int i = 0; i < n; i++) {
+        float bound = freqs[i] / (freqs[i] + norm[docs[i]]);
+        if (bound > max) max = bound;
+    }
+    int steps = (int)(max * BLOCK_MAX_SCALE) + 1;
+    return steps < BLOCK_MAX_SCALE ? steps : BLOCK_MAX_SCALE;
+}
+
+/* Skip table first, then the blocks */
+void encode_posting_blocks(const int *docs, const int *freqs, int n, const IndexHeader *header,
+                           const float *norm, ByteBuffer *out) {
+    int block_size = header->block_size;
+    int n_blocks = (n + block_size - 1) / block_size;
+    bool block_max = header->version >= INDEX_VERSION_BLOCK_MAX;
+    ByteBuffer blocks = {0};
+    int *lengths = (int *)malloc((n_blocks + 1) * sizeof(int));
+    int *maxima = (int *)malloc((n_blocks + 1) * sizeof(int));
+    uint32_t *values = (uint32_t *)malloc(block_size * sizeof(uint32_t));
+
+    /* Encode the blocks first, the skip table needs their lengths */
+    int prev_doc = 0;
+    for (int b = 0; b < n_blocks; b++) {
+        int first = b * block_size;
+        int count = n - first < block_size ? n - first : block_size;
+        size_t start = blocks.size;
+        for (int i = 0; i < count; i++) {
+            values[i] = docs[first + i] - prev_doc;
+            prev_doc = docs[first + i];
+        }
+        codec_encode(header->codec, values, count, &blocks);
+        for (int i = 0; i < count; i++) {
+            values[i] = freqs[first + i];
+        }
+        codec_encode(header->codec, values, count, &blocks);
+        lengths[b] = blocks.size - start;
+        if (block_max) {
+            maxima[b] = upper_bound(docs + first, freqs + first, count, norm);
+        }
+    }
+
+    bytebuffer_put_vbyte(out, n);
+    if (block_max) {
+        int list_max = 0;
+        for (int b = 0; b < n_blocks; b++) {
+            if (maxima[b] > list_max) list_max = maxima[b];
+        }
+        bytebuffer_put_vbyte(out, list_max);
+    }
+    prev_doc = 0;
+    for (int b = 0; b < n_blocks; b++) {
+        int last = (b + 1) * block_size < n ? (b + 1) * block_size - 1 : n - 1;
+        bytebuffer_put_vbyte(out, docs[last] - prev_doc);
+        bytebuffer_put_vbyte(out, lengths[b]);
+        if (block_max) {
+            bytebuffer_put_vbyte(out, maxima[b]);
+        }
+        prev_doc = docs[last];
+    }
+    bytebuffer_put(out, blocks.data, blocks.size);
+
+    free(values);
+    free(maxima);
+    free(lengths);
+    bytebuffer_free(&blocks);
+}
+
+/* Version 1: interleaved (doc_id delta, freq) pairs */
+PostingList* decode_posting_list(const unsigned char *data, int size) {
+    PostingList* list = (PostingList *)malloc(sizeof(PostingList));
+    /* Each posting takes at least two bytes, one for id and one for freq */
+    list->postings = (Posting *)malloc((size / 2 + 1) * sizeof(Posting));
+    list->size = 0;
+
+    int res = 0;
+    int is_id = 1; /* First number is ID then freq alternatively */
+    int prev_id = 0; /* For delta encoding */
+    for (int i = 0; i < size; i++) {
+        if (!(data[i] & 128)) {
+            /* keep adding offset byte and current byte
+             * leading bit is 0 it will remove itself when added
+             */
+            res = (res | (int)data[i]) << 7;
+        } else {
+            /* Final byte of a number
+             * Unset leading 1 and add
+             */
+            res = (res | (data[i] ^ 128));
+            if (is_id) {
+                prev_id += res;
+                list->postings[list->size].doc_id = prev_id;
+                is_id = 0;
+            } else {
+                list->postings[list->size].freq = res;
+                list->size += 1;
+                is_id = 1;
+            }
+            res = 0;
+        }
+    }
+
+    return list;
+}
+
+/* Open a cursor, reading the skip table (or for version 1, the whole list) */
+bool posting_cursor_open(PostingCursor *cursor, const unsigned char *data, int size, const IndexHeader *header) {
+    memset(cursor, 0, sizeof(PostingCursor));
+    cursor->data = data;
+    cursor->size = size;
+    cursor->block = -1;
+
+    if (header->version == INDEX_VERSION_PLAIN) {
+        /* No skip table, the whole list is one block decoded up front */
+        PostingList *list = decode_posting_list(data, size);
+        cursor->n_postings = list->size;
+        cursor->block_size = list->size;
+        cursor->n_blocks = list->size > 0 ? 1 : 0;
+        cursor->block_last_doc = (int *)malloc(sizeof(int));
+        cursor->block_offset = (int *)malloc(sizeof(int));
+        cursor->docs = (int *)malloc((list->size + 1) * sizeof(int));
+        cursor->freqs = (int *)malloc((list->size + 1) * sizeof(int));
+        for (int i = 0; i < list->size; i++) {
+            cursor->docs[i] = list->postings[i].doc_id;
+            cursor->freqs[i] = list->postings[i].freq;
+        }
+        cursor->block_last_doc[0] = list->size > 0 ? list->postings[list->size - 1].doc_id : 0;
+        cursor->block_offset[0] = 0;
+        cursor->block = 0;
+        cursor->block_count = list->size;
+        posting_list_free(list);
+        return true;
+    }
+
+    bool block_max = header->version >= INDEX_VERSION_BLOCK_MAX;
+    if (header->version < INDEX_VERSION_BLOCKS || header->version > INDEX_VERSION_FRONT_CODED || header->block_size <= 0
+            || header->codec < 0 || header->codec >= CODEC_COUNT) {
+        return false;
+    }
+
+    const unsigned char *p = data;
+    const unsigned char *end = data + size;
+    cursor->n_postings = vbyte_get(&p, end);
+    if (block_max) {
+        cursor->list_max = vbyte_get(&p, end);
+    }
+    cursor->block_size = header->block_size;
+    cursor->codec = header->codec;
+    cursor->n_blocks = (cursor->n_postings + cursor->block_size - 1) / cursor->block_size;
+    cursor->block_last_doc = (int *)malloc((cursor->n_blocks + 1) * sizeof(int));
+    cursor->block_offset = (int *)malloc((cursor->n_blocks + 1) * sizeof(int));
+    cursor->docs = (int *)malloc(cursor->block_size * sizeof(int));
+    cursor->freqs = (int *)malloc(cursor->block_size * sizeof(int));
+    if (block_max) {
+        cursor->block_max = (int *)malloc((cursor->n_blocks + 1) * sizeof(int));
+    }
+
+    int last_doc = 0;
+    int *lengths = cursor->block_offset; /* Lengths first, turned into offsets below */
+    for (int b = 0; b < cursor->n_blocks; b++) {
+        last_doc += vbyte_get(&p, end);
+        cursor->block_last_doc[b] = last_doc;
+        lengths[b] = vbyte_get(&p, end);
+        if (block_max) {
+            cursor->block_max[b] = vbyte_get(&p, end);
+        }
+    }
+
+    int offset = p - data;
+    for (int b = 0; b < cursor->n_blocks; b++) {
+        int length = lengths[b];
+        cursor->block_offset[b] = offset;
+        offset += length;
+    }
+    if (offset > size) {
+        posting_cursor_close(cursor);
+        return false;
+    }
+    return true;
+}
+
+/* Point the cursor at the arrays of the decoded list */
+void posting_cursor_open_decoded(PostingCursor *cursor, const DecodedPostings *list) {
+    memset(cursor, 0, sizeof(PostingCursor));
+    cursor->n_postings = list->n_postings;
+    cursor->block_size = list->block_size;
+    cursor->n_blocks = list->n_blocks;
+    cursor->list_max = list->list_max;
+    cursor->block_last_doc = list->block_last_doc;
+    cursor->block_max = list->block_max;
+    cursor->docs = list->docs;
+    cursor->freqs = list->freqs;
+    cursor->block = -1;
+    cursor->shared = true;
+}
+
+/* Free the cursor buffers */
+void posting_cursor_close(PostingCursor *cursor) {
+    if (cursor->shared) {
+        /* The arrays belong to the decoded list */
+        memset(cursor, 0, sizeof(PostingCursor));
+        return;
+    }
+    free(cursor->block_last_doc);
+    free(cursor->block_offset);
+    free(cursor->docs);
+    free(cursor->freqs);
+    free(cursor->block_max);
+    cursor->block_last_doc = cursor->block_offset = cursor->docs = cursor->freqs = NULL;
+    cursor->block_max = NULL;
+}
+
+/* Decode block b of a version 2 list into the given arrays, returns its number of postings */
+static int decode_block_into(const PostingCursor *cursor, int b, uint32_t *docs, uint32_t *freqs) {
+    const unsigned char *p = cursor->data + cursor->block_offset[b];
+    const unsigned char *end = cursor->data + cursor->size;
+    int count = cursor->n_postings - b * cursor->block_size;
+    if (count > cursor->block_size) {
+        count = cursor->block_size;
+    }
+
+    /* Deltas then freqs, the deltas are turned into doc_ids in place */
+    p = codec_decode(cursor->codec, p, end, count, docs);
+    codec_decode(cursor->codec, p, end, count, freqs);
+    uint32_t doc = b > 0 ? cursor->block_last_doc[b - 1] : 0;
+    for (int i = 0; i < count; i++) {
+        doc += docs[i];
+        docs[i] = doc;
+    }
+    return count;
+}
+
+/* Decode block b of a version 2 list into the cursor buffers */
+static void decode_block(PostingCursor *cursor, int b) {
+    if (cursor->shared) {
+        /* Already decoded, slide the block window along the whole list */
+        int from = cursor->block < 0 ? 0 : cursor->block;
+        int count = cursor->n_postings - b * cursor->block_size;
+        cursor->docs += (b - from) * cursor->block_size;
+        cursor->freqs += (b - from) * cursor->block_size;
+        cursor->block = b;
+        cursor->block_count = count < cursor->block_size ? count : cursor->block_size;
+        cursor->position = 0;
+        return;
+    }
+    int count = decode_block_into(cursor, b, (uint32_t *)cursor->docs, (uint32_t *)cursor->freqs);
+    cursor->block = b;
+    cursor->block_count = count;
+    cursor->position = 0;
+}
+
+/* Skip blocks using the skip table, then gallop inside the block */
+bool posting_cursor_next_geq(PostingCursor *cursor, int target, Posting *found) {
+    if (cursor->n_blocks == 0) {
+        return false;
+    }
+
+    int b = cursor->block < 0 ? 0 : cursor->block;
+    if (cursor->block_last_doc[b] < target) {
+        b = gallop_search(cursor->block_last_doc, cursor->n_blocks, b, target);
+        if (b == cursor->n_blocks) {
+            cursor->block = cursor->n_blocks - 1;
+            cursor->position = cursor->block_count;
+            return false;
+        }
+    }
+    if (b != cursor->block) {
+        decode_block(cursor, b);
+    }
+
+    cursor->position = gallop_search(cursor->docs, cursor->block_count, cursor->position, target);
+    if (cursor->position == cursor->block_count) {
+        return false; /* Only possible when the target is past the last block */
+    }
+    found->doc_id = cursor->docs[cursor->position];
+    found->freq = cursor->freqs[cursor->position];
+    return true;
+}
+
+/* The stored list maximum, or the trivial bound */
+float posting_cursor_list_max(const PostingCursor *cursor) {
+    return cursor->block_max != NULL ? cursor->list_max / (float)BLOCK_MAX_SCALE : 1;
+}
+
+/* Shallow move along the skip table, the decoded block stays as it is */
+float posting_cursor_block_max(PostingCursor *cursor, int target, int *last_doc) {
+    int b = cursor->block > cursor->shallow_block ? cursor->block : cursor->shallow_block;
+    b = gallop_search(cursor->block_last_doc, cursor->n_blocks, b, target);
+    if (b == cursor->n_blocks) {
+        *last_doc = INT_MAX;
+        return 0;
+    }
+    cursor->shallow_block = b;
+    *last_doc = cursor->block_last_doc[b];
+    return cursor->block_max != NULL ? cursor->block_max[b] / (float)BLOCK_MAX_SCALE : 1;
+}
+
+/* Decode all blocks into a posting array */
+PostingList* posting_cursor_decode_all(PostingCursor *cursor) {
+    PostingList *list = (PostingList *)malloc(sizeof(PostingList));
+    list->postings = (Posting *)malloc((cursor->n_postings + 1) * sizeof(Posting));
+    list->size = 0;
+    for (int b = 0; b < cursor->n_blocks; b++) {
+        if (b != cursor->block) {
+            decode_block(cursor, b);
+        }
+        for (int i = 0; i < cursor->block_count; i++) {
+            list->postings[list->size].doc_id = cursor->docs[i];
+            list->postings[list->size].freq = cursor->freqs[i];
+            list->size += 1;
+        }
+    }
+    cursor->position = 0;
+    return list;
+}
+
+/* Decode a block into the cursor buffers unless it is the current one */
+int posting_cursor_load_block(PostingCursor *cursor, int b, const uint32_t **docs, const uint32_t **freqs) {
+    if (b != cursor->block) {
+        decode_block(cursor, b);
+    }
+    cursor->position = 0;
+    *docs = (const uint32_t *)cursor->docs;
+    *freqs = (const uint32_t *)cursor->freqs;
+    return cursor->block_count;
+}
+
+/* The blocks of a decoded list follow each other, so block b starts the rest */
+int posting_cursor_load_rest(PostingCursor *cursor, int b, const uint32_t **docs, const uint32_t **freqs) {
+    if (!cursor->shared) {
+        return -1;
+    }
+    posting_cursor_load_block(cursor, b, docs, freqs);
+    return cursor->n_postings - b * cursor->block_size;
+}
+
+/* Blocks straight into the arrays, decoded or version 1 blocks copied from the cursor */
+int posting_cursor_decode_into(PostingCursor *cursor, uint32_t *docs, uint32_t *freqs) {
+    for (int b = 0; b < cursor->n_blocks; b++) {
+        size_t at = (size_t)b * cursor->block_size;
+        if (cursor->shared || b == cursor->block) {
+            if (b != cursor->block) {
+                decode_block(cursor, b);
+            }
+            memcpy(docs + at, cursor->docs, cursor->block_count * sizeof(uint32_t));
+            memcpy(freqs + at, cursor->freqs, cursor->block_count * sizeof(uint32_t));
+        } else {
+            decode_block_into(cursor, b, docs + at, freqs + at);
+        }
+    }
+    cursor->position = 0;
+    return cursor->n_postings;
+}
+
+/* Every block through the cursor buffers, the skip table copied */
+void decoded_postings_init(DecodedPostings *list, PostingCursor *cursor) {
+    list->n_postings = cursor->n_postings;
+    list->block_size = cursor->block_size;
+    list->n_blocks = cursor->n_blocks;
+    list->list_max = cursor->list_max;
+    list->block_last_doc = (int *)malloc((list->n_blocks + 1) * sizeof(int));
+    memcpy(list->block_last_doc, cursor->block_last_doc, list->n_blocks * sizeof(int));
+    list->block_max = NULL;
+    if (cursor->block_max != NULL) {
+        list->block_max = (int *)malloc((list->n_blocks + 1) * sizeof(int));
+        memcpy(list->block_max, cursor->block_max, list->n_blocks * sizeof(int));
+    }
+    list->docs = (int *)malloc((list->n_postings + 1) * sizeof(int));
+    list->freqs = (int *)malloc((list->n_postings + 1) * sizeof(int));
+    for (int b = 0; b < cursor->n_blocks; b++) {
+        if (b != cursor->block) {
+            decode_block(cursor, b);
+        }
+        memcpy(list->docs + b * list->block_size, cursor->docs, cursor->block_count * sizeof(int));
+        memcpy(list->freqs + b * list->block_size, cursor->freqs, cursor->block_count * sizeof(int));
+    }
+    cursor->position = 0;
+}
+
+/* The arrays and the struct */
+size_t decoded_postings_bytes(const DecodedPostings *list) {
+    size_t skip = (list->block_max != NULL ? 2 : 1) * (size_t)list->n_blocks;
+    return sizeof(DecodedPostings) + (skip + 2 * (size_t)list->n_postings) * sizeof(int);
+}
+
+void decoded_postings_free(DecodedPostings *list) {
+    free(list->block_last_doc);
+    free(list->block_max);
+    free(list->docs);
+    free(list->freqs);
+    list->block_last_doc = list->block_max = list->docs = list->freqs = NULL;
+}
+
+/* Exponential search followed by binary search */
+int gallop_search(const int *docs, int size, int from, int target) {
+    if (from >= size || docs[from] >= target) {
+        return from;
+    }
+
+    /* docs[low] < target, grow the step until docs[high] >= target */
+    int low = from;
+    int step = 1;
+    int high = from + step;
+    while (high < size && docs[high] < target) {
+        low = high;
+        step *= 2;
+        high = from + step;
+    }
+    if (high > size) {
+        high = size;
+    }
+
+    /* Binary search in (low, high] */
+    while (low + 1 < high) {
+        int mid = low + (high - low) / 2;
+        if (docs[mid] < target) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+    return high;
+}
@@ -0,0 +1,351 @@
+/**
+ * @file postings.h
+ * @brief On-disk posting list format shared by the indexer and the searcher.
+ *
+ * Version 1 (no header): each posting list is one unbroken stream of
+ * variable byte encoded (doc_id delta, freq) pairs.
+ *
+ * Version 2 (block format): a header entry is written at the start of the
+ * dictionary file and every posting list is laid out as
+ *     vbyte n_postings
+ *     skip table, for each block: vbyte (last doc_id - previous last doc_id)
+ *                                 vbyte block length in bytes
+ *     blocks of POSTING_BLOCK_SIZE postings, each holding the doc_id
+ *     deltas followed by the freqs of the block, encoded with the codec
+ *     named in the header (vbyte or Stream VByte, see codec.h)
+ * The skip table lets the reader jump over whole blocks without decoding them.
+ *
+ * Version 3 (block-max) is version 2 with score upper bounds for dynamic
+ * pruning: a vbyte list maximum after n_postings and a vbyte block maximum
+ * after each block length in the skip table. Both bound tf / (tf + norm)
+ * over their postings, norm being the BM25 length normalisation of the
+ * document (see ranking.h), quantised upwards to BLOCK_MAX_SCALE steps.
+ * The searcher multiplies them by idf * (k1 + 1) to bound the BM25 score.
+ *
+ * Version 4 keeps the version 3 posting lists and replaces the fixed size
+ * dictionary entries after the header with a front coded dictionary
+ * (see dictionary.h), lifting the limits on term length and offsets.
+ *
+ * @author Ubaada
+ * @date 01-04-2024
+ */
+
+#ifndef POSTINGS_H
+#define POSTINGS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "common.h"
+
+#define INDEX_MAGIC "WSJIDX"
+#define INDEX_VERSION_PLAIN 1 /* Legacy format, no header */
+#define INDEX_VERSION_BLOCKS 2
+#define INDEX_VERSION_BLOCK_MAX 3
+#define INDEX_VERSION_FRONT_CODED 4 /* Block-max postings, front coded dictionary */
+#define BLOCK_MAX_SCALE 65535 /* Steps of a stored upper bound between 0 and 1 */
+#define POSTING_BLOCK_SIZE 128
+#define INDEX_STAMP_MAGIC "WSJSTAMP"
+#define INDEX_STAMP_SIZE 16 /* Trailer of the other index files: magic, 8 byte stamp */
+
+/*
+ * Index header, stored as the first dictionary entry.
+ * The entry starts with a NUL byte so it can't be mistaken for a word.
+ */
+typedef struct IndexHeader {
+    int version;
+    int block_size; /* Postings per block */
+    int codec; /* PostingCodec of the blocks */
+    uint64_t stamp; /* Build stamp, also in the trailer of the other files, 0 if none */
+} IndexHeader;
+
+/* Growable byte buffer used to encode a posting list before writing it */
+typedef struct ByteBuffer {
+    unsigned char *data;
+    size_t size;
+    size_t capacity;
+} ByteBuffer;
+
+/*
+ * Cursor over one encoded posting list.
+ * Blocks are decoded lazily, one at a time, as the cursor moves forward.
+ */
+typedef struct PostingCursor {
+    const unsigned char *data;
+    int size; /* Size of the encoded data in bytes */
+    int n_postings; /* Document frequency of the word */
+    int block_size;
+    int codec;
+    int n_blocks;
+    int *block_last_doc; /* Skip table: last doc_id in each block */
+    int *block_offset; /* Skip table: byte offset of each block in data */
+    int block; /* Currently decoded block, -1 if none */
+    int block_count; /* Number of postings in the decoded block */
+    int position; /* Position of the cursor in the decoded block */
+    int *docs; /* Decoded doc_ids of the current block */
+    int *freqs; /* Decoded freqs of the current block */
+    int list_max; /* Upper bound of the list in BLOCK_MAX_SCALE steps */
+    int *block_max; /* Upper bound of each block, NULL before version 3 */
+    int shallow_block; /* Block of the last posting_cursor_block_max */
+    bool shared; /* Reads a DecodedPostings, the arrays aren't the cursor's */
+} PostingCursor;
+
+/*
+ * A posting list decoded whole along with its skip table, as kept in
+ * the searcher's posting cache. Read only once built, any number of
+ * cursors may read it at the same time.
+ */
+typedef struct DecodedPostings {
+    int n_postings;
+    int block_size;
+    int n_blocks;
+    int list_max;
+    int *block_last_doc;
+    int *block_max; /* NULL before version 3 */
+    int *docs;
+    int *freqs;
+} DecodedPostings;
+
+/**
+ * Write the index header as a dictionary entry
+ *
+ * @param fp_dict The dictionary file
+ * @param header The header to write
+ */
+void index_header_write(FILE *fp_dict, const IndexHeader *header);
+
+/**
+ * Read the index header from the first dictionary entry.
+ * Dictionaries without a header are reported as INDEX_VERSION_PLAIN.
+ *
+ * @param entry The first MAX_KEY_SIZE + OFFSET_SIZE bytes of the dictionary
+ * @param header Filled with the header
+ * @return true if the entry is a header, false if it is a word
+ */
+bool index_header_read(const unsigned char *entry, IndexHeader *header);
+
+/**
+ * Append the build stamp trailer to an index file, so a reader can tell
+ * that it belongs with the dictionary of the same build
+ *
+ * @param fp The file, open for appending
+ * @param stamp The stamp of the build
+ */
+void index_stamp_append(FILE *fp, uint64_t stamp);
+
+/**
+ * Read the build stamp trailer at the end of an index file
+ *
+ * @param fd The open file
+ * @param size The size of the file
+ * @return The stamp, 0 if the file has no trailer
+ */
+uint64_t index_stamp_read(int fd, int64_t size);
+
+/**
+ * Make room for at least extra more bytes in a buffer
+ *
+ * @param buffer The buffer to grow
+ * @param extra The number of bytes that will be appended
+ */
+void bytebuffer_reserve(ByteBuffer *buffer, size_t extra);
+
+/**
+ * Append a variable byte encoded integer to a buffer.
+ * Same encoding as variable_byte_encode.
+ *
+ * @param buffer The buffer to append to
+ * @param n The integer to encode
+ */
+void bytebuffer_put_vbyte(ByteBuffer *buffer, int n);
+
+/* Append a 64 bit variable byte encoded integer, read with vbyte_get64 */
+void bytebuffer_put_vbyte64(ByteBuffer *buffer, uint64_t value);
+
+/**
+ * Append raw bytes to a buffer
+ *
+ * @param buffer The buffer to append to
+ * @param bytes The bytes to append
+ * @param size The number of bytes
+ */
+void bytebuffer_put(ByteBuffer *buffer, const void *bytes, size_t size);
+
+/**
+ * Free the memory of a buffer
+ *
+ * @param buffer The buffer to free
+ */
+void bytebuffer_free(ByteBuffer *buffer);
+
+/**
+ * Decode one variable byte encoded integer
+ *
+ * @param p Pointer to the read position, advanced past the integer
+ * @param end End of the readable data
+ * @return The decoded integer
+ */
+int vbyte_get(const unsigned char **p, const unsigned char *end);
+
+/* Decode one 64 bit variable byte encoded integer, like vbyte_get */
+int64_t vbyte_get64(const unsigned char **p, const unsigned char *end);
+
+/**
+ * Encode a posting list in the block format
+ *
+ * @param docs The doc_ids, increasing
+ * @param freqs The frequencies
+ * @param n The number of postings
+ * @param header The index header, gives the version, block size and codec
+ * @param norm BM25 length normalisation of every document, for the
+ *             upper bounds of version 3, NULL otherwise
+ * @param out The buffer to append the encoded list to
+ */
+void encode_posting_blocks(const int *docs, const int *freqs, int n, const IndexHeader *header,
+                           const float *norm, ByteBuffer *out);
+
+/**
+ * Decode a version 1 posting list (one vbyte stream) into an array
+ *
+ * @param data The encoded data
+ * @param size The size of the data
+ * @return A posting list array
+ */
+PostingList* decode_posting_list(const unsigned char *data, int size);
+
+/**
+ * Open a cursor over an encoded posting list
+ *
+ * @param cursor The cursor to open
+ * @param data The encoded posting list, must outlive the cursor
+ * @param size The size of the data
+ * @param header The index header, gives the format version
+ * @return true on success, false on a corrupt list
+ */
+bool posting_cursor_open(PostingCursor *cursor, const unsigned char *data, int size, const IndexHeader *header);
+
+/**
+ * Open a cursor over a decoded list. The cursor reads the list in place,
+ * blocks cost nothing to "decode".
+ *
+ * @param cursor The cursor to open
+ * @param list The decoded list, must outlive the cursor
+ */
+void posting_cursor_open_decoded(PostingCursor *cursor, const DecodedPostings *list);
+
+/**
+ * Decode every block of an opened cursor's list, keeping the skip table
+ *
+ * @param list Filled with the decoded list, free with decoded_postings_free
+ * @param cursor The opened cursor
+ */
+void decoded_postings_init(DecodedPostings *list, PostingCursor *cursor);
+
+/**
+ * Memory held by a decoded list
+ *
+ * @param list The decoded list
+ * @return The size in bytes
+ */
+size_t decoded_postings_bytes(const DecodedPostings *list);
+
+/* Free the arrays of a decoded list */
+void decoded_postings_free(DecodedPostings *list);
+
+/**
+ * Free the buffers of a cursor
+ *
+ * @param cursor The cursor to close
+ */
+void posting_cursor_close(PostingCursor *cursor);
+
+/**
+ * Move the cursor to the first posting with doc_id >= target.
+ * Whole blocks whose last doc_id is below the target are skipped
+ * without being decoded. The cursor never moves backwards.
+ *
+ * @param cursor The cursor
+ * @param target The doc_id to look for
+ * @param found Set to the posting the cursor stopped at
+ * @return false if the list is exhausted, true otherwise
+ */
+bool posting_cursor_next_geq(PostingCursor *cursor, int target, Posting *found);
+
+/**
+ * Upper bound of tf / (tf + norm) over the whole list
+ *
+ * @param cursor The cursor
+ * @return The bound, 1 if the index has no block maxima
+ */
+float posting_cursor_list_max(const PostingCursor *cursor);
+
+/**
+ * Upper bound of tf / (tf + norm) over the block that would hold target,
+ * found from the skip table without decoding or moving the cursor.
+ * Targets must not decrease between calls.
+ *
+ * @param cursor The cursor
+ * @param target The doc_id to look for
+ * @param last_doc Set to the last doc_id of the block, INT_MAX past the list
+ * @return The bound, 1 if the index has no block maxima, 0 past the list
+ */
+float posting_cursor_block_max(PostingCursor *cursor, int target, int *last_doc);
+
+/**
+ * Decode the whole list into an array, regardless of cursor position
+ *
+ * @param cursor The cursor
+ * @return A posting list array
+ */
+PostingList* posting_cursor_decode_all(PostingCursor *cursor);
+
+/**
+ * Decode block b, the cursor moving to its first posting, and get its
+ * doc_ids and freqs. Blocks must not decrease between calls.
+ *
+ * @param cursor The cursor
+ * @param b The block, 0 to n_blocks - 1
+ * @param docs Set to the doc_ids of the block, valid until the cursor moves to another block
+ * @param freqs Set to the freqs of the block
+ * @return The number of postings in the block
+ */
+int posting_cursor_load_block(PostingCursor *cursor, int b, const uint32_t **docs, const uint32_t **freqs);
+
+/**
+ * Get the doc_ids and freqs of a list held decoded (from the posting cache)
+ * from block b to its end, the cursor moving to the first posting of b.
+ *
+ * @param cursor The cursor, open on a decoded list
+ * @param b The block, 0 to n_blocks - 1
+ * @param docs Set to the doc_ids from block b on
+ * @param freqs Set to the freqs from block b on
+ * @return The number of postings from block b on, -1 if the list isn't held decoded
+ */
+int posting_cursor_load_rest(PostingCursor *cursor, int b, const uint32_t **docs, const uint32_t **freqs);
+
+/**
+ * Decode the whole list into caller's arrays, one doc_id and freq array
+ * (struct of arrays), regardless of cursor position. Blocks are decoded
+ * in place in the arrays, without going through the cursor buffers.
+ *
+ * @param cursor The cursor
+ * @param docs Receives the doc_ids, room for cursor->n_postings
+ * @param freqs Receives the freqs, room for cursor->n_postings
+ * @return The number of postings, cursor->n_postings
+ */
+int posting_cursor_decode_into(PostingCursor *cursor, uint32_t *docs, uint32_t *freqs);
+
+/**
+ * Find the first position at or after from with docs[position] >= target.
+ * Gallops (1, 2, 4, ...) ahead to bracket the target then binary searches.
+ *
+ * @param docs Increasing doc_ids
+ * @param size The number of doc_ids
+ * @param from The position to start from
+ * @param target The doc_id to look for
+ * @return The position found, size if all doc_ids are smaller
+ */
+int gallop_search(const int *docs, int size, int from, int target);
+
+#endif // POSTINGS_H
@@ -0,0 +1,68 @@
+/**
+ * @file query_buffers.c
+ * @brief Aligned, growable struct of arrays for query evaluation
+ */
+
+#include "query_buffers.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Aligned memory for n elements of the given size, padded to whole cache lines */
+static void* aligned_array(int n, size_t size) {
+    size_t bytes = (n * size + QUERY_BUFFER_ALIGN - 1) / QUERY_BUFFER_ALIGN * QUERY_BUFFER_ALIGN;
+    return aligned_alloc(QUERY_BUFFER_ALIGN, bytes);
+}
+
+bool query_buffers_reserve(QueryBuffers *buffers, int n) {
+    if (n <= buffers->capacity) {
+        return true;
+    }
+    /* Grow geometrically so a run of larger lists settles quickly */
+    int capacity = buffers->capacity > 0 ? buffers->capacity : QUERY_BUFFER_MIN;
+    while (capacity < n) {
+        capacity = capacity > INT32_MAX / 2 ? n : capacity * 2;
+    }
+    query_buffers_free(buffers);
+    buffers->docs = (uint32_t *)aligned_array(capacity, sizeof(uint32_t));
+    buffers->freqs = (uint32_t *)aligned_array(capacity, sizeof(uint32_t));
+    buffers->scores = (float *)aligned_array(capacity, sizeof(float));
+    buffers->ranked = (ScoredDoc *)aligned_array(capacity, sizeof(ScoredDoc));
+    buffers->match_a = (int *)aligned_array(capacity, sizeof(int));
+    buffers->match_b = (int *)aligned_array(capacity, sizeof(int));
+    if (buffers->docs == NULL || buffers->freqs == NULL || buffers->scores == NULL || buffers->ranked == NULL
+            || buffers->match_a == NULL || buffers->match_b == NULL) {
+        query_buffers_free(buffers);
+        return false;
+    }
+    buffers->capacity = capacity;
+    return true;
+}
+
+void query_buffers_free(QueryBuffers *buffers) {
+    free(buffers->docs);
+    free(buffers->freqs);
+    free(buffers->scores);
+    free(buffers->ranked);
+    free(buffers->match_a);
+    free(buffers->match_b);
+    memset(buffers, 0, sizeof(QueryBuffers));
+}
+
+bool query_buffer_pool_init(QueryBufferPool *pool, int n_threads) {
+    pool->buffers = (QueryBuffers *)calloc(n_threads, sizeof(QueryBuffers));
+    pool->n_buffers = pool->buffers != NULL ? n_threads : 0;
+    return pool->buffers != NULL;
+}
+
+QueryBuffers* query_buffer_pool_get(QueryBufferPool *pool, int thread) {
+    return &pool->buffers[thread];
+}
+
+void query_buffer_pool_free(QueryBufferPool *pool) {
+    for (int i = 0; i < pool->n_buffers; i++) {
+        query_buffers_free(&pool->buffers[i]);
+    }
+    free(pool->buffers);
+    pool->buffers = NULL;
+    pool->n_buffers = 0;
+}
@@ -0,0 +1,80 @@
+/**
+ * @file query_buffers.h
+ * @brief Reusable arrays the searcher evaluates a query in.
+ *
+ * The candidates of a conjunctive query are held as a struct of arrays:
+ * doc_ids, freqs and running scores in separate cache line aligned
+ * arrays, filled by decoding the rarest posting list straight into them
+ * and compacted in place as each longer list filters them (see
+ * intersect.h for the kernels and their match positions). The arrays
+ * are sized from the document frequency read from the encoded list and
+ * only grow, so a thread reuses them query after query without
+ * allocating per posting or per query. A pool holds one set per thread.
+ *
+ * @author Ubaada
+ * @date 01-04-2024
+ */
+
+#ifndef QUERY_BUFFERS_H
+#define QUERY_BUFFERS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "topk.h"
+
+#define QUERY_BUFFER_ALIGN 64 /* Cache line, and wide enough for any SIMD load */
+#define QUERY_BUFFER_MIN 1024 /* Smallest capacity allocated */
+
+/* The arrays of one thread */
+typedef struct QueryBuffers {
+    uint32_t *docs; /* Candidate doc_ids, increasing */
+    uint32_t *freqs; /* Freqs of the rarest list's postings */
+    float *scores; /* Running score of each candidate */
+    ScoredDoc *ranked; /* Results being sorted for printing */
+    int *match_a; /* Positions of the matches an intersection kernel finds */
+    int *match_b;
+    int capacity; /* Entries of each array */
+} QueryBuffers;
+
+/* One set of arrays per worker thread */
+typedef struct QueryBufferPool {
+    QueryBuffers *buffers;
+    int n_buffers;
+} QueryBufferPool;
+
+/**
+ * Make room for n entries in every array. The contents are not kept
+ * when the arrays grow.
+ *
+ * @param buffers The arrays, zero initialised before first use
+ * @param n The number of entries needed
+ * @return false if out of memory
+ */
+bool query_buffers_reserve(QueryBuffers *buffers, int n);
+
+/* Free the arrays */
+void query_buffers_free(QueryBuffers *buffers);
+
+/**
+ * Create a pool of empty buffers, nothing is allocated until a
+ * thread reserves room
+ *
+ * @param pool The pool
+ * @param n_threads The number of threads, one set of arrays each
+ * @return false if out of memory
+ */
+bool query_buffer_pool_init(QueryBufferPool *pool, int n_threads);
+
+/**
+ * Get the arrays of a thread
+ *
+ * @param pool The pool
+ * @param thread The thread, 0 to n_threads - 1
+ * @return The arrays, only ever used by that thread
+ */
+QueryBuffers* query_buffer_pool_get(QueryBufferPool *pool, int thread);
+
+/* Free every set of arrays and the pool */
+void query_buffer_pool_free(QueryBufferPool *pool);
+
+#endif // QUERY_BUFFERS_H
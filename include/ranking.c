@@ -0,0 +1,93 @@
+/**
+ * @file ranking.c
+ * @brief Document length statistics and BM25 scoring
+ */
+
+#include "ranking.h"
+#include "common.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+void doc_stats_init(DocStats *stats, uint32_t *lengths, int n_docs) {
+    stats->n_docs = n_docs;
+    stats->lengths = lengths;
+    stats->total_length = 0;
+    for (int i = 0; i < n_docs; i++) {
+        stats->total_length += lengths[i];
+    }
+    stats->avg_length = n_docs > 0 ? (float)((double)stats->total_length / n_docs) : 0;
+
+    stats->norm = (float *)malloc(((size_t)n_docs + 1) * sizeof(float));
+    for (int i = 0; i < n_docs; i++) {
+        float relative = stats->avg_length > 0 ? lengths[i] / stats->avg_length : 1;
+        stats->norm[i] = BM25_K1 * (1 - BM25_B + BM25_B * relative);
+    }
+}
+
+bool doc_stats_write(const char *path, const DocStats *stats) {
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL) {
+        printf("Error: Couldn't open file for writing\n");
+        return false;
+    }
+    write_int_big_endian(fp, stats->n_docs);
+    write_int_big_endian(fp, (int)(stats->total_length >> 32));
+    write_int_big_endian(fp, (int)(stats->total_length & 0xFFFFFFFF));
+    for (int i = 0; i < stats->n_docs; i++) {
+        write_int_big_endian(fp, (int)stats->lengths[i]);
+    }
+    fclose(fp);
+    return true;
+}
+
+/* Read a big-endian 32 bit number from a buffer */
+static uint32_t load_big_endian(const unsigned char *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+bool doc_stats_load(const char *path, DocStats *stats) {
+    memset(stats, 0, sizeof(DocStats));
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return false;
+    }
+    unsigned char header[12];
+    if (fread(header, sizeof(header), 1, fp) != 1) {
+        fclose(fp);
+        return false;
+    }
+    int n_docs = (int)load_big_endian(header);
+    int64_t total_length = ((int64_t)load_big_endian(header + 4) << 32) | load_big_endian(header + 8);
+
+    /* Read the lengths in one go and convert them in place */
+    uint32_t *lengths = n_docs >= 0 ? (uint32_t *)malloc(((size_t)n_docs + 1) * sizeof(uint32_t)) : NULL;
+    if (lengths == NULL || fread(lengths, sizeof(uint32_t), n_docs, fp) != (size_t)n_docs) {
+        fclose(fp);
+        free(lengths);
+        return false;
+    }
+    fclose(fp);
+    for (int i = 0; i < n_docs; i++) {
+        lengths[i] = load_big_endian((const unsigned char *)&lengths[i]);
+    }
+
+    doc_stats_init(stats, lengths, n_docs);
+    if (stats->total_length != total_length) {
+        doc_stats_free(stats);
+        return false;
+    }
+    return true;
+}
+
+void doc_stats_free(DocStats *stats) {
+    free(stats->lengths);
+    free(stats->norm);
+    stats->lengths = NULL;
+    stats->norm = NULL;
+    stats->n_docs = 0;
+}
+
+float bm25_idf(int n_docs, int df) {
+    return logf(1 + (n_docs - df + 0.5f) / (df + 0.5f));
+}
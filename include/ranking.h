@@ -0,0 +1,96 @@
+/**
+ * @file ranking.h
+ * @brief Document length statistics and BM25 scoring.
+ *
+ * The indexer writes the length (tokens indexed) of every document to
+ * data/doc_stats.bin, next to the document ID list, all big-endian:
+ *     n_docs (4 bytes), total length (8 bytes), n_docs lengths (4 bytes each)
+ * The searcher loads the file once and keeps the length normalisation of
+ * BM25 as a dense array indexed by document, so scoring a posting is a
+ * table lookup and a few flops. The IDF of a term comes from the length
+ * of its posting list.
+ *
+ * @author Ubaada
+ * @date 01-04-2024
+ */
+
+#ifndef RANKING_H
+#define RANKING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define DOC_STATS_FILE "data/doc_stats.bin"
+#define BM25_K1 1.2f /* Term frequency saturation */
+#define BM25_B 0.75f /* Document length normalisation */
+
+/* Ranking models of the searcher */
+typedef enum RankingModel {
+    RANK_BM25 = 0,
+    RANK_FREQ = 1, /* Sum of the term frequencies */
+} RankingModel;
+
+/* Statistics of the collection, loaded from DOC_STATS_FILE */
+typedef struct DocStats {
+    int n_docs;
+    int64_t total_length; /* Tokens in the collection */
+    float avg_length;
+    uint32_t *lengths; /* Tokens of each document */
+    float *norm; /* k1 * (1 - b + b * length / avg_length) of each document */
+} DocStats;
+
+/**
+ * Fill the statistics from the document lengths and precompute
+ * the BM25 length normalisation
+ *
+ * @param stats The statistics to fill
+ * @param lengths The length of each document, in document order,
+ *                a malloc'd array now owned by the statistics
+ * @param n_docs The number of documents
+ */
+void doc_stats_init(DocStats *stats, uint32_t *lengths, int n_docs);
+
+/**
+ * Write the document lengths
+ *
+ * @param path The statistics file
+ * @param stats The statistics to write
+ * @return true on success, false otherwise
+ */
+bool doc_stats_write(const char *path, const DocStats *stats);
+
+/**
+ * Load the document lengths and precompute the BM25 length normalisation
+ *
+ * @param path The statistics file
+ * @param stats The statistics to fill
+ * @return true on success, false if the file is missing or malformed
+ */
+bool doc_stats_load(const char *path, DocStats *stats);
+
+/* Free the arrays of the statistics */
+void doc_stats_free(DocStats *stats);
+
+/**
+ * Inverse document frequency of a term, never negative
+ *
+ * @param n_docs Documents in the collection
+ * @param df Documents containing the term, the posting list length
+ * @return log(1 + (N - df + 0.5) / (df + 0.5))
+ */
+float bm25_idf(int n_docs, int df);
+
+/**
+ * BM25 score of one term in one document
+ *
+ * @param idf The IDF of the term
+ * @param tf The frequency of the term in the document
+ * @param norm The length normalisation of the document, DocStats.norm
+ * @return The score
+ */
+static inline float bm25_score(float idf, int tf, float norm) {
+    return idf * tf * (BM25_K1 + 1) / (tf + norm);
+}
+
+#endif // RANKING_H
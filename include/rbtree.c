@@ -11,6 +11,7 @@ void rb_initialize(RBTree *tree) {
     
     tree->nil->left = tree->nil->right = tree->nil->parent = tree->nil;
     tree->root = tree->nil;
+    tree->arena = NULL;
 }
 
 /* Create a new tree */
@@ -23,6 +24,23 @@ RBTree* rb_create() {
     return tree;
 }
 
+/* Create a new tree with nodes from an arena */
+RBTree* rb_create_arena(Arena *arena) {
+    RBTree *tree = rb_create();
+    if (tree != NULL) {
+        tree->arena = arena;
+    }
+    return tree;
+}
+
+/* Allocate a node from the arena or the heap */
+static RBTreeNode* rb_alloc_node(RBTree *tree) {
+    if (tree->arena != NULL) {
+        return (RBTreeNode *)arena_alloc(tree->arena, sizeof(RBTreeNode));
+    }
+    return (RBTreeNode *)malloc(sizeof(RBTreeNode));
+}
+
 
 
 /* Rotate left */
@@ -105,7 +123,7 @@ static void rb_insert_fixup(RBTree *tree, RBTreeNode *z) {
 
 /* Insert a new node into the tree */
 void rb_insert(RBTree *tree, char* key, void *value) {
-    RBTreeNode *newNode = (RBTreeNode *)malloc(sizeof(RBTreeNode));
+    RBTreeNode *newNode = rb_alloc_node(tree);
     // Zero out the key array
     memset(newNode->key, 0, MAX_KEY_SIZE);
     strcpy(newNode->key, key);
@@ -244,7 +262,9 @@ void rb_delete(RBTree *tree, RBTreeNode *z) {
         rb_delete_fixup(tree, x);
     }
 
-    free(z); // Finally, free the memory of the node being removed
+    if (tree->arena == NULL) {
+        free(z); // Finally, free the memory of the node being removed
+    }
 }
 
 /* Search for a node with the given key */
@@ -278,11 +298,9 @@ RBTreeNode* rb_maximum(RBTree *tree, RBTreeNode *node) {
 
 /* Find the successor and predecessor of a node */
 RBTreeNode* rb_successor(RBTree *tree, RBTreeNode *node) {
-    RBTreeNode* minNode = NULL;
-     if (node->right != tree->nil) {
-         minNode = rb_minimum(tree, node->right);
-     }
-     return minNode;
+    if (node->right != tree->nil) {
+        return rb_minimum(tree, node->right);
+    }
 
     RBTreeNode *parent = node->parent;
     while (parent != tree->nil && node == parent->right) {
@@ -324,7 +342,7 @@ int rb_insert_or_check(RBTree *tree, char* key, void *value) {
     }
 
     // Key not found, proceed with insertion
-    z = (RBTreeNode *)malloc(sizeof(RBTreeNode));
+    z = rb_alloc_node(tree);
     strncpy(z->key, key, MAX_KEY_SIZE - 1); // Copy with bounds checking
     z->key[MAX_KEY_SIZE - 1] = '\0'; // Ensure null-termination
     z->value = value;
@@ -377,7 +395,9 @@ static void rb_destroy_helper(RBTree *tree, RBTreeNode *node) {
 
 
 void rb_destroy(RBTree *tree) {
-    rb_destroy_helper(tree, tree->root);
+    if (tree->arena == NULL) {
+        rb_destroy_helper(tree, tree->root); // Arena nodes go with the arena
+    }
     free(tree->nil); // Also free the sentinel node
     tree->root = tree->nil = NULL; // Set root and nil to NULL to mark the tree as destroyed
 }
@@ -2,6 +2,7 @@
 #define RBTREE_H
 
 #include "common.h"
+#include "arena.h"
 
 typedef enum { RED, BLACK } RBColor;
 
@@ -20,11 +21,16 @@ typedef struct RBTreeNode {
 typedef struct RBTree {
     RBTreeNode *root;
     RBTreeNode *nil; // Sentinel node to represent leaves
+    Arena *arena; // Nodes come from here if set, instead of malloc
 } RBTree;
 
 /* Create a new tree */
 RBTree* rb_create();
 
+/* Create a new tree whose nodes are allocated from an arena
+   and released with it (rb_destroy doesn't free them) */
+RBTree* rb_create_arena(Arena *arena);
+
 /* Node insertion */
 void rb_insert(RBTree *tree, char* key, void *value); //<-- Change to char *key
 
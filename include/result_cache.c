@@ -0,0 +1,167 @@
+/**
+ * @file result_cache.c
+ * @brief LRU cache of ranked query results
+ */
+
+#include "result_cache.h"
+#include "common.h"
+#include <stdlib.h>
+#include <string.h>
+
+bool result_cache_init(ResultCache *cache, size_t budget) {
+    memset(cache, 0, sizeof(ResultCache));
+    cache->budget = budget;
+    cache->n_buckets = RESULT_CACHE_BUCKETS;
+    cache->buckets = (CachedResults **)calloc(cache->n_buckets, sizeof(CachedResults *));
+    if (cache->buckets == NULL || pthread_mutex_init(&cache->lock, NULL) != 0) {
+        free(cache->buckets);
+        return false;
+    }
+    return true;
+}
+
+/* Take an entry out of the recency list. Needs the lock. */
+static void unlink_recent(ResultCache *cache, CachedResults *entry) {
+    if (entry->newer != NULL) entry->newer->older = entry->older;
+    else cache->newest = entry->older;
+    if (entry->older != NULL) entry->older->newer = entry->newer;
+    else cache->oldest = entry->newer;
+    entry->newer = entry->older = NULL;
+}
+
+/* Put an entry at the head of the recency list. Needs the lock. */
+static void push_recent(ResultCache *cache, CachedResults *entry) {
+    entry->older = cache->newest;
+    entry->newer = NULL;
+    if (cache->newest != NULL) cache->newest->newer = entry;
+    cache->newest = entry;
+    if (cache->oldest == NULL) cache->oldest = entry;
+}
+
+/* Remove and free an entry. Needs the lock. */
+static void remove_entry(ResultCache *cache, CachedResults *entry) {
+    CachedResults **link = &cache->buckets[entry->hash & (cache->n_buckets - 1)];
+    while (*link != entry) {
+        link = &(*link)->next;
+    }
+    *link = entry->next;
+    unlink_recent(cache, entry);
+    cache->used -= entry->bytes;
+    cache->n_entries -= 1;
+    free(entry->key);
+    free(entry->results);
+    free(entry);
+}
+
+/* Drop every entry once the index has changed. Needs the lock. */
+static void check_generation(ResultCache *cache, uint64_t generation) {
+    if (generation == cache->generation) {
+        return;
+    }
+    if (cache->n_entries > 0) {
+        cache->invalidations += 1;
+    }
+    while (cache->oldest != NULL) {
+        remove_entry(cache, cache->oldest);
+    }
+    cache->generation = generation;
+}
+
+int result_cache_get(ResultCache *cache, const char *key, uint64_t generation, ScoredDoc **results) {
+    uint32_t hash = hash_fnv1a(key, strlen(key));
+    int n = -1;
+    pthread_mutex_lock(&cache->lock);
+    check_generation(cache, generation);
+    CachedResults *entry = cache->buckets[hash & (cache->n_buckets - 1)];
+    while (entry != NULL && (entry->hash != hash || strcmp(entry->key, key) != 0)) {
+        entry = entry->next;
+    }
+    if (entry != NULL) {
+        unlink_recent(cache, entry);
+        push_recent(cache, entry);
+        n = entry->n_results;
+        *results = (ScoredDoc *)malloc((n + 1) * sizeof(ScoredDoc));
+        memcpy(*results, entry->results, n * sizeof(ScoredDoc));
+        cache->hits += 1;
+    } else {
+        cache->misses += 1;
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return n;
+}
+
+/* Double the buckets once there are more entries than buckets. Needs the lock. */
+static void grow_buckets(ResultCache *cache) {
+    int n_buckets = cache->n_buckets * 2;
+    CachedResults **buckets = (CachedResults **)calloc(n_buckets, sizeof(CachedResults *));
+    if (buckets == NULL) {
+        return; /* Longer chains, still correct */
+    }
+    for (CachedResults *entry = cache->newest; entry != NULL; entry = entry->older) {
+        entry->next = buckets[entry->hash & (n_buckets - 1)];
+        buckets[entry->hash & (n_buckets - 1)] = entry;
+    }
+    free(cache->buckets);
+    cache->buckets = buckets;
+    cache->n_buckets = n_buckets;
+}
+
+void result_cache_put(ResultCache *cache, const char *key, uint64_t generation, const ScoredDoc *results, int n_results) {
+    size_t bytes = sizeof(CachedResults) + strlen(key) + 1 + (size_t)n_results * sizeof(ScoredDoc);
+    if (bytes > cache->budget) {
+        return;
+    }
+    uint32_t hash = hash_fnv1a(key, strlen(key));
+
+    pthread_mutex_lock(&cache->lock);
+    check_generation(cache, generation);
+    CachedResults *entry = cache->buckets[hash & (cache->n_buckets - 1)];
+    while (entry != NULL && (entry->hash != hash || strcmp(entry->key, key) != 0)) {
+        entry = entry->next;
+    }
+    if (entry != NULL) {
+        /* Another thread ran the same query meanwhile */
+        pthread_mutex_unlock(&cache->lock);
+        return;
+    }
+    while (cache->oldest != NULL && cache->used + bytes > cache->budget) {
+        remove_entry(cache, cache->oldest);
+        cache->evictions += 1;
+    }
+
+    entry = (CachedResults *)calloc(1, sizeof(CachedResults));
+    entry->key = strdup(key);
+    entry->hash = hash;
+    entry->results = (ScoredDoc *)malloc((n_results + 1) * sizeof(ScoredDoc));
+    memcpy(entry->results, results, n_results * sizeof(ScoredDoc));
+    entry->n_results = n_results;
+    entry->bytes = bytes;
+    if (cache->n_entries >= cache->n_buckets) {
+        grow_buckets(cache);
+    }
+    entry->next = cache->buckets[hash & (cache->n_buckets - 1)];
+    cache->buckets[hash & (cache->n_buckets - 1)] = entry;
+    push_recent(cache, entry);
+    cache->used += bytes;
+    cache->n_entries += 1;
+    pthread_mutex_unlock(&cache->lock);
+}
+
+void result_cache_report(ResultCache *cache, FILE *out) {
+    pthread_mutex_lock(&cache->lock);
+    long lookups = cache->hits + cache->misses;
+    fprintf(out, "  results:    %ld hits, %ld misses (%.1f%% hits), %ld evictions, %ld invalidations,"
+            " %d queries in %.1f of %.1f MB\n", cache->hits, cache->misses,
+            lookups > 0 ? 100.0 * cache->hits / lookups : 0, cache->evictions, cache->invalidations,
+            cache->n_entries, cache->used / (1024.0 * 1024.0), cache->budget / (1024.0 * 1024.0));
+    pthread_mutex_unlock(&cache->lock);
+}
+
+void result_cache_free(ResultCache *cache) {
+    while (cache->oldest != NULL) {
+        remove_entry(cache, cache->oldest);
+    }
+    free(cache->buckets);
+    cache->buckets = NULL;
+    pthread_mutex_destroy(&cache->lock);
+}
@@ -0,0 +1,99 @@
+/**
+ * @file result_cache.h
+ * @brief Cache of the ranked results of whole queries, for the searcher.
+ *
+ * Keyed by the normalised query (stemmed, sorted and deduplicated words
+ * and the options that change the results), the value is the ranked list
+ * of document indexes and scores that was printed. Entries are kept
+ * within a byte budget, least recently used first out. Every entry is
+ * stamped with the generation of the index it was computed on; a lookup
+ * with another generation empties the cache.
+ *
+ * @author Ubaada
+ * @date 01-04-2024
+ */
+
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "topk.h"
+
+#define RESULT_CACHE_BUCKETS 1024 /* Initial hash buckets, doubled as entries are added */
+
+/* The results of one query */
+typedef struct CachedResults {
+    char *key;
+    uint32_t hash;
+    ScoredDoc *results; /* Best first */
+    int n_results;
+    size_t bytes; /* Memory charged to the budget */
+    struct CachedResults *newer; /* Recency list, most recent at the head */
+    struct CachedResults *older;
+    struct CachedResults *next; /* Next entry of the hash bucket */
+} CachedResults;
+
+typedef struct ResultCache {
+    pthread_mutex_t lock;
+    size_t budget; /* Bytes the entries may take */
+    size_t used;
+    uint64_t generation; /* Of the index the entries were computed on */
+    CachedResults **buckets;
+    int n_buckets; /* A power of two */
+    int n_entries;
+    CachedResults *newest;
+    CachedResults *oldest;
+    long hits;
+    long misses;
+    long evictions;
+    long invalidations; /* Times the index changed under the cache */
+} ResultCache;
+
+/**
+ * Create an empty cache
+ *
+ * @param cache The cache
+ * @param budget Bytes the entries may take
+ * @return false if out of memory
+ */
+bool result_cache_init(ResultCache *cache, size_t budget);
+
+/**
+ * Look up a query, counting a hit or a miss
+ *
+ * @param cache The cache
+ * @param key The normalised query
+ * @param generation The generation of the index being searched
+ * @param results Set to a malloc'd copy of the results on a hit
+ * @return The number of results, -1 on a miss
+ */
+int result_cache_get(ResultCache *cache, const char *key, uint64_t generation, ScoredDoc **results);
+
+/**
+ * Add the results of a query after a miss, evicting the least recently
+ * used entries to fit. Results larger than the whole budget aren't kept.
+ *
+ * @param cache The cache
+ * @param key The normalised query
+ * @param generation The generation of the index the results come from
+ * @param results The results, best first, copied
+ * @param n_results The number of results
+ */
+void result_cache_put(ResultCache *cache, const char *key, uint64_t generation, const ScoredDoc *results, int n_results);
+
+/**
+ * Print the hit rate and memory use of the cache
+ *
+ * @param cache The cache
+ * @param out The stream to print to
+ */
+void result_cache_report(ResultCache *cache, FILE *out);
+
+/* Free every entry and the cache */
+void result_cache_free(ResultCache *cache);
+
+#endif // RESULT_CACHE_H
@@ -0,0 +1,63 @@
+/**
+ * @file spsc_queue.c
+ * @brief Bounded lock-free single producer, single consumer queue
+ */
+
+#include "spsc_queue.h"
+#include <stdlib.h>
+#include <sched.h>
+
+bool spsc_queue_init(SpscQueue *queue, size_t capacity) {
+    size_t rounded = 1;
+    while (rounded < capacity) {
+        rounded *= 2;
+    }
+    queue->slots = (void **)calloc(rounded, sizeof(void *));
+    queue->capacity = rounded;
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+    return queue->slots != NULL;
+}
+
+bool spsc_queue_push(SpscQueue *queue, void *item) {
+    size_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+    if (tail - head == queue->capacity) {
+        return false;
+    }
+    queue->slots[tail & (queue->capacity - 1)] = item;
+    /* Publish the item before the new tail */
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+void* spsc_queue_pop(SpscQueue *queue) {
+    size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+    if (head == tail) {
+        return NULL;
+    }
+    void *item = queue->slots[head & (queue->capacity - 1)];
+    /* Hand the slot back to the producer after reading it */
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+    return item;
+}
+
+void spsc_queue_push_wait(SpscQueue *queue, void *item) {
+    while (!spsc_queue_push(queue, item)) {
+        sched_yield();
+    }
+}
+
+void* spsc_queue_pop_wait(SpscQueue *queue) {
+    void *item;
+    while ((item = spsc_queue_pop(queue)) == NULL) {
+        sched_yield();
+    }
+    return item;
+}
+
+void spsc_queue_free(SpscQueue *queue) {
+    free(queue->slots);
+    queue->slots = NULL;
+}
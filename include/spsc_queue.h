@@ -0,0 +1,59 @@
+/**
+ * @file spsc_queue.h
+ * @brief Bounded lock-free queue between one producer and one consumer thread.
+ *
+ * A ring of pointers with atomic head and tail indexes. The producer only
+ * writes the tail and the consumer only writes the head, so no locks are
+ * needed. The waiting variants yield the CPU while the queue is full/empty.
+ *
+ * @author Ubaada
+ * @date 01-04-2024
+ */
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct SpscQueue {
+    void **slots;
+    size_t capacity; /* Power of two */
+    _Atomic size_t head; /* Next slot to pop, written by the consumer */
+    _Atomic size_t tail; /* Next slot to push, written by the producer */
+} SpscQueue;
+
+/**
+ * Create an empty queue
+ *
+ * @param queue The queue
+ * @param capacity The number of items it holds, rounded up to a power of two
+ * @return true on success, false if out of memory
+ */
+bool spsc_queue_init(SpscQueue *queue, size_t capacity);
+
+/**
+ * Push an item (producer thread)
+ *
+ * @return false if the queue is full
+ */
+bool spsc_queue_push(SpscQueue *queue, void *item);
+
+/**
+ * Pop an item (consumer thread)
+ *
+ * @return The item, NULL if the queue is empty
+ */
+void* spsc_queue_pop(SpscQueue *queue);
+
+/* Push, yielding until there is room */
+void spsc_queue_push_wait(SpscQueue *queue, void *item);
+
+/* Pop, yielding until there is an item */
+void* spsc_queue_pop_wait(SpscQueue *queue);
+
+/* Free the slots, the items belong to the caller */
+void spsc_queue_free(SpscQueue *queue);
+
+#endif // SPSC_QUEUE_H
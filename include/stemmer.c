@@ -0,0 +1,133 @@
+/**
+ * @file stemmer.c
+ * @brief Suffix stripping stemmer with a reverse trie
+ */
+
+#include "stemmer.h"
+#include "common.h"
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+#include <pthread.h>
+
+#define STEM_TRIE_NODES 128 /* Enough for the reversed suffixes */
+#define STEM_MAX_SUFFIX 4 /* Longest suffix */
+
+/* sorted from longest to shortest */
+static const char *SUFFIXES[] = { "able", "ible", "ness", "ment", "ions", "ings", "ies", "ion", "ing", \
+        "ate", "ize", "ise", "ant", "ent", "ful", "ous", "ive", \
+        "es", "er", "or", "al", "ic", "ly", "ed", \
+        "en", "fy", "\'s", "s", NULL};
+
+/* Reverse trie of the suffixes, node 0 is the root and 0 means no child */
+static unsigned char stem_trie[STEM_TRIE_NODES][256];
+static bool stem_terminal[STEM_TRIE_NODES]; /* A whole suffix ends here */
+static pthread_once_t stem_trie_once = PTHREAD_ONCE_INIT;
+
+/* Add every suffix to the trie, last byte first */
+static void build_stem_trie(void) {
+    int n_nodes = 1;
+    for (const char **suffix = SUFFIXES; *suffix != NULL; suffix++) {
+        int node = 0;
+        for (int i = strlen(*suffix) - 1; i >= 0; i--) {
+            unsigned char c = (*suffix)[i];
+            if (stem_trie[node][c] == 0) {
+                stem_trie[node][c] = n_nodes++;
+            }
+            node = stem_trie[node][c];
+        }
+        stem_terminal[node] = true;
+    }
+}
+
+size_t stem_length(char *word, size_t length) {
+    pthread_once(&stem_trie_once, build_stem_trie);
+
+    /* lowercase the word, ASCII only like tolower in the C locale */
+    for (size_t i = 0; i < length; i++) {
+        if ((unsigned char)(word[i] - 'A') <= 'Z' - 'A') {
+            word[i] += 'a' - 'A';
+        }
+    }
+    if (length <= STEM_MIN_LENGTH) {
+        return length;
+    }
+
+    /* Walk back from the last byte, the deepest suffix that leaves
+     * STEM_MIN_LENGTH characters wins. At most one suffix of each
+     * length can match, so this is the first match of the sorted list. */
+    size_t max_suffix = length - STEM_MIN_LENGTH;
+    if (max_suffix > STEM_MAX_SUFFIX) max_suffix = STEM_MAX_SUFFIX;
+    size_t best = 0;
+    int node = 0;
+    for (size_t k = 1; k <= max_suffix; k++) {
+        node = stem_trie[node][(unsigned char)word[length - k]];
+        if (node == 0) {
+            break;
+        }
+        if (stem_terminal[node]) {
+            best = k;
+        }
+    }
+    length -= best;
+    word[length] = '\0';
+    return length;
+}
+
+/* Helper function to check if a string ends with a given suffix. */
+static bool ends_with(const char *str, const char *suffix) {
+    if (!str || !suffix) return false;
+    size_t lenstr = strlen(str);
+    size_t lensuffix = strlen(suffix);
+    if (lensuffix > lenstr) return false;
+    return strncmp(str + lenstr - lensuffix, suffix, lensuffix) == 0;
+}
+
+/* Stem a char in place by removing suffixes if greater than a certain length */
+void stem_reference(char *word) {
+
+    /* lowercase the word */
+    for (int i = 0; word[i]; i++) {
+        word[i] = tolower(word[i]);
+    }
+
+    const char **suffix = SUFFIXES;
+
+    int too_short = STEM_MIN_LENGTH; /* Minimum length of word after stemming */
+
+    while (*suffix != NULL) {
+
+        /* if word ends with suffix and removing it doesn't make the word too short */
+        int result_len = strlen(word) - strlen(*suffix);
+        if (ends_with(word, *suffix) && (result_len >= too_short)) {
+            word[strlen(word) - strlen(*suffix)] = '\0'; /* Remove the suffix. */
+            break;
+        }
+
+        suffix++;
+    }
+}
+
+size_t stem_cached(StemCache *cache, char *word, size_t length) {
+    if (length >= STEM_CACHE_WORD) {
+        return stem_length(word, length);
+    }
+
+    /* Hash of the word as given */
+    uint32_t hash = hash_fnv1a(word, length);
+
+    StemCacheEntry *entry = &cache->entries[hash & (STEM_CACHE_SIZE - 1)];
+    if (entry->hash == hash && entry->length == length && memcmp(entry->word, word, length) == 0) {
+        cache->hits += 1;
+        memcpy(word, entry->stemmed, entry->stemmed_length + 1);
+        return entry->stemmed_length;
+    }
+
+    cache->misses += 1;
+    entry->hash = hash;
+    entry->length = length;
+    memcpy(entry->word, word, length);
+    entry->stemmed_length = stem_length(word, length);
+    memcpy(entry->stemmed, word, entry->stemmed_length + 1);
+    return entry->stemmed_length;
+}
@@ -0,0 +1,68 @@
+/**
+ * @file stemmer.h
+ * @brief Suffix stripping stemmer driven by a reverse trie of the suffixes.
+ *
+ * The word is lowercased and measured in one pass, then its last bytes
+ * are walked back through a trie of the reversed suffixes. The longest
+ * suffix that leaves at least STEM_MIN_LENGTH characters is removed, which
+ * is what trying the suffixes from longest to shortest did. stem() in
+ * common.h uses this stemmer.
+ *
+ * @author Ubaada
+ * @date 01-04-2024
+ */
+
+#ifndef STEMMER_H
+#define STEMMER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define STEM_MIN_LENGTH 3 /* Minimum length of word after stemming */
+#define STEM_CACHE_SIZE 4096 /* Entries of a StemCache, a power of two */
+#define STEM_CACHE_WORD 24 /* Longer words bypass the cache */
+
+/**
+ * Stem a word in place: lowercase it and remove its suffix
+ *
+ * @param word The word, NUL terminated, shortened in place
+ * @param length The length of the word
+ * @return The length of the stemmed word
+ */
+size_t stem_length(char *word, size_t length);
+
+/**
+ * The stemmer as first written, a suffix at a time with strlen and
+ * ends_with. Kept as the reference for the differential check in bench.
+ *
+ * @param word The word to stem in place
+ */
+void stem_reference(char *word);
+
+/* An entry of the cache, a word as given and as stemmed */
+typedef struct StemCacheEntry {
+    uint32_t hash;
+    uint8_t length; /* 0 if the entry is empty */
+    uint8_t stemmed_length;
+    char word[STEM_CACHE_WORD];
+    char stemmed[STEM_CACHE_WORD];
+} StemCacheEntry;
+
+/* Direct mapped memo of stemmed words, one per thread */
+typedef struct StemCache {
+    StemCacheEntry entries[STEM_CACHE_SIZE];
+    size_t hits;
+    size_t misses;
+} StemCache;
+
+/**
+ * Stem a word through a cache of recent words
+ *
+ * @param cache The cache, zero initialised before first use
+ * @param word The word, NUL terminated, shortened in place
+ * @param length The length of the word
+ * @return The length of the stemmed word
+ */
+size_t stem_cached(StemCache *cache, char *word, size_t length);
+
+#endif // STEMMER_H
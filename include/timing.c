@@ -0,0 +1,78 @@
+/**
+ * @file timing.c
+ * @brief Wall clock timing and latency statistics
+ */
+
+#include "timing.h"
+#include <stdlib.h>
+#include <time.h>
+
+/* Current time of the monotonic clock in seconds */
+double time_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* Initialize an empty set of samples */
+void latency_stats_init(LatencyStats *stats) {
+    stats->samples = NULL;
+    stats->count = 0;
+    stats->capacity = 0;
+    stats->total = 0;
+}
+
+/* Add a sample, growing the sample array when full */
+void latency_stats_add(LatencyStats *stats, double seconds) {
+    if (stats->count == stats->capacity) {
+        size_t capacity = stats->capacity ? stats->capacity * 2 : 1024;
+        double *samples = (double *)realloc(stats->samples, capacity * sizeof(double));
+        if (samples == NULL) {
+            return;
+        }
+        stats->samples = samples;
+        stats->capacity = capacity;
+    }
+    stats->samples[stats->count++] = seconds;
+    stats->total += seconds;
+}
+
+/* Compare two doubles for qsort */
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Nearest rank percentile */
+double latency_stats_percentile(LatencyStats *stats, double p) {
+    if (stats->count == 0) {
+        return 0;
+    }
+    qsort(stats->samples, stats->count, sizeof(double), cmp_double);
+    size_t rank = (size_t)(p / 100.0 * stats->count + 0.5);
+    if (rank == 0) rank = 1;
+    if (rank > stats->count) rank = stats->count;
+    return stats->samples[rank - 1];
+}
+
+/* Print count, throughput and latency percentiles in milliseconds */
+void latency_stats_report(LatencyStats *stats, const char *label, double wall_seconds, FILE *out) {
+    double p50 = latency_stats_percentile(stats, 50);
+    double p99 = latency_stats_percentile(stats, 99);
+    double max = stats->count ? stats->samples[stats->count - 1] : 0;
+    double mean = stats->count ? stats->total / stats->count : 0;
+
+    fprintf(out, "%s: %zu queries in %.3f s\n", label, stats->count, wall_seconds);
+    fprintf(out, "  throughput: %.1f queries/sec (wall), %.1f queries/sec (busy)\n",
+            wall_seconds > 0 ? stats->count / wall_seconds : 0,
+            stats->total > 0 ? stats->count / stats->total : 0);
+    fprintf(out, "  latency:    mean %.3f ms, p50 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+            mean * 1e3, p50 * 1e3, p99 * 1e3, max * 1e3);
+}
+
+/* Free the samples */
+void latency_stats_free(LatencyStats *stats) {
+    free(stats->samples);
+    latency_stats_init(stats);
+}
@@ -0,0 +1,75 @@
+/**
+ * @file timing.h
+ * @brief Wall clock timing and latency statistics.
+ *
+ * Used by the long running modes of the search engine to report
+ * throughput (queries per second) and latency percentiles.
+ *
+ * @author Ubaada
+ * @date 01-04-2024
+ */
+
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/* Collected latency samples in seconds */
+typedef struct LatencyStats {
+    double *samples;
+    size_t count;
+    size_t capacity;
+    double total; /* Sum of all samples */
+} LatencyStats;
+
+/**
+ * Get the current time from a monotonic clock
+ *
+ * @return The time in seconds
+ */
+double time_now(void);
+
+/**
+ * Initialize an empty set of latency samples
+ *
+ * @param stats The stats to initialize
+ */
+void latency_stats_init(LatencyStats *stats);
+
+/**
+ * Record one latency sample
+ *
+ * @param stats The stats to add to
+ * @param seconds The measured latency in seconds
+ */
+void latency_stats_add(LatencyStats *stats, double seconds);
+
+/**
+ * Get a percentile of the recorded samples (nearest rank).
+ * Sorts the samples in place.
+ *
+ * @param stats The recorded stats
+ * @param p The percentile between 0 and 100
+ * @return The latency in seconds, 0 if there are no samples
+ */
+double latency_stats_percentile(LatencyStats *stats, double p);
+
+/**
+ * Print throughput and latency percentiles
+ *
+ * @param stats The recorded stats
+ * @param label A label printed in front of the report
+ * @param wall_seconds Wall clock time the samples were collected over
+ * @param out The stream to print to
+ */
+void latency_stats_report(LatencyStats *stats, const char *label, double wall_seconds, FILE *out);
+
+/**
+ * Free the recorded samples
+ *
+ * @param stats The stats to free
+ */
+void latency_stats_free(LatencyStats *stats);
+
+#endif // TIMING_H
@@ -0,0 +1,587 @@
+/**
+ * @file tokenizer.c
+ * @brief Streaming tokenizer of the WSJ XML collection
+ */
+
+#include "tokenizer.h"
+#include "common.h"
+#include "stemmer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "postings.h"
+
+#if defined(__x86_64__)
+#define TOKENIZER_X86 1
+#include <immintrin.h>
+#endif
+
+#define READ_SIZE (1 << 16) /* Bytes read from the file at a time */
+
+/* Finds the first byte of a class in n bytes, n if there is none */
+typedef size_t (*ScanFunc)(const char *p, size_t n);
+
+/* Scanners in use, see tokenizer_set_scanner */
+static ScanFunc scan_interesting;
+static ScanFunc scan_word_end;
+static ScanFunc scan_id_end;
+static bool scan_bytewise; /* Run the byte at a time loop instead */
+static const char *scanner_name;
+static pthread_once_t scanner_once = PTHREAD_ONCE_INIT;
+
+static void select_scanner(void);
+
+void tokenizer_init(Tokenizer *tokenizer, TokenSink sink, void *context) {
+    pthread_once(&scanner_once, select_scanner);
+    memset(tokenizer, 0, sizeof(Tokenizer));
+    tokenizer->is_first_doc = true;
+    tokenizer->stem = true;
+    tokenizer->sink = sink;
+    tokenizer->context = context;
+}
+
+/* ASCII letters and digits, isalnum of the C locale */
+static inline bool is_alnum(unsigned char c) {
+    return (unsigned char)(c - '0') <= 9 || (unsigned char)((c | 0x20) - 'a') <= 25;
+}
+
+/**
+ * Run one byte through the tokenizer.
+ * Scan byte by byte to form a word until a non-alphanumeric char is found.
+ * Unless the char is between < and >, then it is a tag.
+ * If the tag is DOC, then the next word is a document ID.
+ *
+ * @param t The tokenizer
+ * @param c The byte
+ * @param back4 The byte 4 before it
+ */
+static inline void tokenizer_step(Tokenizer *t, char c, unsigned char back4) {
+    if (c == '<') {
+        t->is_angle_start = true;
+    } else if (c == '>' && t->is_angle_start) {
+        t->is_angle_end = true;
+    }
+    /**
+     * STOP string building If current char is not alphanumeric
+     * But allow '-' if it is a doc id
+     */
+    if (!is_alnum(c) && !(t->is_doc_id && c == '-')) {
+        if (t->word_index == 0) {
+            /* word is empty, skip */
+            return;
+        }
+        t->word[t->word_index] = '\0';
+        if (t->is_angle_start && t->is_angle_end) {
+            /* tag between < and > */
+            t->is_angle_start = false;
+            t->is_angle_end = false;
+            /* so it only triggers for opening tag <DOC>
+             * not both opening and closing tag
+             */
+            if (strncmp(t->word, "DOC", t->word_index) == 0 && back4 == '<') {
+                if (!t->is_first_doc) {
+                    t->sink(t->context, "", 0);
+                } else {
+                    t->is_first_doc = false;
+                }
+                t->is_doc_id = true;
+            }
+        } else {
+            /* word, if it is a doc id, don't stem */
+            int length = t->word_index;
+            if (t->is_doc_id) {
+                t->is_doc_id = false;
+            } else if (t->stem) {
+                length = stem_length(t->word, length);
+            }
+            t->sink(t->context, t->word, length);
+        }
+        t->word_index = 0;
+    } else if (t->word_index < MAX_TOKEN_SIZE - 1) {
+        /* add char to word */
+        t->word[t->word_index++] = c;
+    }
+}
+
+/* Reference tokenizer, every byte through tokenizer_step */
+static void tokenizer_feed_bytewise(Tokenizer *t, const char *data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        /* The byte 4 back, in this buffer or the previous one */
+        unsigned char back4 = t->recent[t->offset & 3];
+        t->recent[t->offset & 3] = (unsigned char)data[i];
+        t->offset += 1;
+        tokenizer_step(t, data[i], back4);
+    }
+}
+
+/*
+ * Portable scanners, a byte at a time.
+ * Interesting bytes can start a word or change the tag state, all other
+ * bytes outside a word are skipped. Inside a word, the word ends at the
+ * first byte that isn't alphanumeric ('-' is allowed in document IDs).
+ */
+static size_t scan_interesting_scalar(const char *p, size_t n) {
+    size_t i = 0;
+    while (i < n && !is_alnum(p[i]) && p[i] != '<' && p[i] != '>' && p[i] != '-') i++;
+    return i;
+}
+
+static size_t scan_word_end_scalar(const char *p, size_t n) {
+    size_t i = 0;
+    while (i < n && is_alnum(p[i])) i++;
+    return i;
+}
+
+static size_t scan_id_end_scalar(const char *p, size_t n) {
+    size_t i = 0;
+    while (i < n && (is_alnum(p[i]) || p[i] == '-')) i++;
+    return i;
+}
+
+#ifdef TOKENIZER_X86
+/* Bytes in [lo, lo + span], unsigned */
+#define SSE2_IN_RANGE(x, lo, span) \
+    _mm_cmpeq_epi8(_mm_min_epu8(_mm_sub_epi8(x, _mm_set1_epi8(lo)), _mm_set1_epi8(span)), \
+                   _mm_sub_epi8(x, _mm_set1_epi8(lo)))
+
+/* Mask of the alphanumeric bytes of 16 */
+static inline __m128i alnum_sse2(__m128i x) {
+    __m128i digit = SSE2_IN_RANGE(x, '0', 9);
+    __m128i alpha = SSE2_IN_RANGE(_mm_or_si128(x, _mm_set1_epi8(0x20)), 'a', 25);
+    return _mm_or_si128(digit, alpha);
+}
+
+/* 16 bytes at a time, the first set bit of the class mask is the answer */
+static size_t scan_interesting_sse2(const char *p, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(p + i));
+        __m128i tag = _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('<')), _mm_cmpeq_epi8(x, _mm_set1_epi8('>')));
+        __m128i mask = _mm_or_si128(_mm_or_si128(alnum_sse2(x), tag), _mm_cmpeq_epi8(x, _mm_set1_epi8('-')));
+        unsigned bits = _mm_movemask_epi8(mask);
+        if (bits != 0) {
+            return i + __builtin_ctz(bits);
+        }
+    }
+    return i + scan_interesting_scalar(p + i, n - i);
+}
+
+static size_t scan_word_end_sse2(const char *p, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(p + i));
+        unsigned bits = ~_mm_movemask_epi8(alnum_sse2(x)) & 0xFFFF;
+        if (bits != 0) {
+            return i + __builtin_ctz(bits);
+        }
+    }
+    return i + scan_word_end_scalar(p + i, n - i);
+}
+
+static size_t scan_id_end_sse2(const char *p, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(p + i));
+        __m128i mask = _mm_or_si128(alnum_sse2(x), _mm_cmpeq_epi8(x, _mm_set1_epi8('-')));
+        unsigned bits = ~_mm_movemask_epi8(mask) & 0xFFFF;
+        if (bits != 0) {
+            return i + __builtin_ctz(bits);
+        }
+    }
+    return i + scan_id_end_scalar(p + i, n - i);
+}
+
+/* The same with 32 bytes at a time */
+#define AVX2_IN_RANGE(x, lo, span) \
+    _mm256_cmpeq_epi8(_mm256_min_epu8(_mm256_sub_epi8(x, _mm256_set1_epi8(lo)), _mm256_set1_epi8(span)), \
+                      _mm256_sub_epi8(x, _mm256_set1_epi8(lo)))
+
+__attribute__((target("avx2")))
+static inline __m256i alnum_avx2(__m256i x) {
+    __m256i digit = AVX2_IN_RANGE(x, '0', 9);
+    __m256i alpha = AVX2_IN_RANGE(_mm256_or_si256(x, _mm256_set1_epi8(0x20)), 'a', 25);
+    return _mm256_or_si256(digit, alpha);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_interesting_avx2(const char *p, size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(p + i));
+        __m256i tag = _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('<')),
+                                      _mm256_cmpeq_epi8(x, _mm256_set1_epi8('>')));
+        __m256i mask = _mm256_or_si256(_mm256_or_si256(alnum_avx2(x), tag), _mm256_cmpeq_epi8(x, _mm256_set1_epi8('-')));
+        unsigned bits = _mm256_movemask_epi8(mask);
+        if (bits != 0) {
+            return i + __builtin_ctz(bits);
+        }
+    }
+    return i + scan_interesting_sse2(p + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_word_end_avx2(const char *p, size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(p + i));
+        unsigned bits = ~(unsigned)_mm256_movemask_epi8(alnum_avx2(x));
+        if (bits != 0) {
+            return i + __builtin_ctz(bits);
+        }
+    }
+    return i + scan_word_end_sse2(p + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_id_end_avx2(const char *p, size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(p + i));
+        __m256i mask = _mm256_or_si256(alnum_avx2(x), _mm256_cmpeq_epi8(x, _mm256_set1_epi8('-')));
+        unsigned bits = ~(unsigned)_mm256_movemask_epi8(mask);
+        if (bits != 0) {
+            return i + __builtin_ctz(bits);
+        }
+    }
+    return i + scan_id_end_sse2(p + i, n - i);
+}
+#endif
+
+/* Pick the widest scanner the CPU supports */
+static void select_scanner(void) {
+    scan_bytewise = false;
+    scan_interesting = scan_interesting_scalar;
+    scan_word_end = scan_word_end_scalar;
+    scan_id_end = scan_id_end_scalar;
+    scanner_name = "scalar";
+#ifdef TOKENIZER_X86
+    /* SSE2 is part of x86-64 */
+    scan_interesting = scan_interesting_sse2;
+    scan_word_end = scan_word_end_sse2;
+    scan_id_end = scan_id_end_sse2;
+    scanner_name = "sse2";
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        scan_interesting = scan_interesting_avx2;
+        scan_word_end = scan_word_end_avx2;
+        scan_id_end = scan_id_end_avx2;
+        scanner_name = "avx2";
+    }
+#endif
+}
+
+/* Force a scanner, for benchmarking. Call before tokenizing. */
+bool tokenizer_set_scanner(const char *name) {
+    pthread_once(&scanner_once, select_scanner);
+    if (strcmp(name, "bytewise") == 0) {
+        scan_bytewise = true;
+        scanner_name = "bytewise";
+        return true;
+    }
+    if (strcmp(name, "scalar") == 0) {
+        scan_bytewise = false;
+        scan_interesting = scan_interesting_scalar;
+        scan_word_end = scan_word_end_scalar;
+        scan_id_end = scan_id_end_scalar;
+        scanner_name = "scalar";
+        return true;
+    }
+#ifdef TOKENIZER_X86
+    if (strcmp(name, "sse2") == 0) {
+        scan_bytewise = false;
+        scan_interesting = scan_interesting_sse2;
+        scan_word_end = scan_word_end_sse2;
+        scan_id_end = scan_id_end_sse2;
+        scanner_name = "sse2";
+        return true;
+    }
+    __builtin_cpu_init();
+    if (strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2")) {
+        scan_bytewise = false;
+        scan_interesting = scan_interesting_avx2;
+        scan_word_end = scan_word_end_avx2;
+        scan_id_end = scan_id_end_avx2;
+        scanner_name = "avx2";
+        return true;
+    }
+#endif
+    return false;
+}
+
+const char* tokenizer_scanner_name(void) {
+    pthread_once(&scanner_once, select_scanner);
+    return scanner_name;
+}
+
+/**
+ * Tokenize a buffer a span at a time. Outside a word the bytes up to the
+ * next interesting one are skipped, inside a word the bytes up to its end
+ * are copied. Only the bytes in between go through tokenizer_step, which
+ * gives the same result as feeding every byte.
+ */
+void tokenizer_feed(Tokenizer *tokenizer, const char *data, size_t size) {
+    Tokenizer *t = tokenizer;
+    if (scan_bytewise) {
+        tokenizer_feed_bytewise(t, data, size);
+        return;
+    }
+
+    size_t i = 0;
+    while (i < size) {
+        if (t->word_index == 0) {
+            i += scan_interesting(data + i, size - i);
+        } else {
+            size_t n = t->is_doc_id ? scan_id_end(data + i, size - i) : scan_word_end(data + i, size - i);
+            size_t room = MAX_TOKEN_SIZE - 1 - t->word_index;
+            memcpy(t->word + t->word_index, data + i, n < room ? n : room);
+            t->word_index += n < room ? n : room;
+            i += n;
+        }
+        if (i >= size) {
+            break;
+        }
+        /* The byte 4 back, in this buffer or the previous one */
+        unsigned char back4 = i >= 4 ? (unsigned char)data[i - 4] : t->recent[(t->offset + i) & 3];
+        tokenizer_step(t, data[i], back4);
+        i += 1;
+    }
+
+    /* Keep the last 4 bytes for the next buffer */
+    for (size_t j = size > 4 ? size - 4 : 0; j < size; j++) {
+        t->recent[(t->offset + j) & 3] = (unsigned char)data[j];
+    }
+    t->offset += size;
+}
+
+int tokenize_file(const char *path, TokenSink sink, void *context) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        printf("Error: File not found\n");
+        return 1;
+    }
+
+    char *buffer = (char *)malloc(READ_SIZE);
+    if (buffer == NULL) {
+        printf("Error: Out of memory\n");
+        fclose(file);
+        return 1;
+    }
+    Tokenizer tokenizer;
+    tokenizer_init(&tokenizer, sink, context);
+    size_t bytes_read;
+    while ((bytes_read = fread(buffer, 1, READ_SIZE, file)) > 0) {
+        tokenizer_feed(&tokenizer, buffer, bytes_read);
+    }
+    free(buffer);
+    fclose(file);
+    return 0;
+}
+
+/* A chunk of the XML for the parallel tokenizer, starting at a <DOC> tag */
+typedef struct TokenChunk {
+    const char *start;
+    const char *end;
+    Tokenizer tokenizer; /* State at the end of the chunk */
+    ByteBuffer text; /* Word stream of the chunk */
+    bool done;
+} TokenChunk;
+
+/* Chunks shared by the worker threads and the thread passing on the output */
+typedef struct ParallelTokenizer {
+    const char *data; /* The mapped file */
+    TokenChunk *chunks;
+    int n_chunks;
+    int next_chunk; /* Next chunk for a worker to take */
+    int emitted; /* Chunks handed to the sink so far */
+    int window; /* Chunks that may be tokenized ahead of the sink */
+    pthread_mutex_t lock;
+    pthread_cond_t chunk_done;
+    pthread_cond_t chunk_emitted;
+} ParallelTokenizer;
+
+/* Append a token to a word stream buffer as a line */
+static void append_line(void *context, const char *token, int length) {
+    ByteBuffer *text = (ByteBuffer *)context;
+    bytebuffer_reserve(text, length + 1);
+    memcpy(text->data + text->size, token, length);
+    text->data[text->size + length] = '\n';
+    text->size += length + 1;
+}
+
+/**
+ * Set up a tokenizer to start at a chunk as if the file had been
+ * tokenized up to there, assuming nothing is left over from the
+ * previous document (no open word or tag, the first <DOC> seen)
+ */
+static void tokenizer_start_chunk(Tokenizer *tokenizer, const char *data, const TokenChunk *chunk, ByteBuffer *text) {
+    size_t offset = chunk->start - data;
+    tokenizer_init(tokenizer, append_line, text);
+    tokenizer->is_first_doc = offset == 0;
+    for (size_t k = 1; k <= 4 && k <= offset; k++) {
+        tokenizer->recent[(offset - k) & 3] = (unsigned char)data[offset - k];
+    }
+    tokenizer->offset = offset;
+}
+
+/* Check if a tokenizer ended in the state tokenizer_start_chunk assumes */
+static bool tokenizer_is_clean(const Tokenizer *tokenizer) {
+    return tokenizer->word_index == 0 && !tokenizer->is_angle_start && !tokenizer->is_angle_end
+        && !tokenizer->is_doc_id && !tokenizer->is_first_doc;
+}
+
+/* Worker thread, tokenizes the next chunk while it is within the window */
+static void* tokenize_chunks_thread(void *arg) {
+    ParallelTokenizer *pt = (ParallelTokenizer *)arg;
+    while (true) {
+        pthread_mutex_lock(&pt->lock);
+        while (pt->next_chunk < pt->n_chunks && pt->next_chunk >= pt->emitted + pt->window) {
+            pthread_cond_wait(&pt->chunk_emitted, &pt->lock);
+        }
+        if (pt->next_chunk >= pt->n_chunks) {
+            pthread_mutex_unlock(&pt->lock);
+            return NULL;
+        }
+        TokenChunk *chunk = &pt->chunks[pt->next_chunk++];
+        pthread_mutex_unlock(&pt->lock);
+
+        tokenizer_start_chunk(&chunk->tokenizer, pt->data, chunk, &chunk->text);
+        tokenizer_feed(&chunk->tokenizer, chunk->start, chunk->end - chunk->start);
+
+        pthread_mutex_lock(&pt->lock);
+        chunk->done = true;
+        pthread_cond_broadcast(&pt->chunk_done);
+        pthread_mutex_unlock(&pt->lock);
+    }
+}
+
+/* Find the next "<DOC>" from start, NULL if there is none */
+static const char* find_doc_tag(const char *start, const char *end) {
+    const char *p = start;
+    while (end - p >= 5) {
+        p = memchr(p, '<', end - p - 4);
+        if (p == NULL) {
+            return NULL;
+        }
+        if (memcmp(p, "<DOC>", 5) == 0) {
+            return p;
+        }
+        p += 1;
+    }
+    return NULL;
+}
+
+/**
+ * Split the file into chunks of about TOKENIZE_CHUNK_SIZE bytes,
+ * each after the first starting at a <DOC> tag
+ *
+ * @return The number of chunks
+ */
+static int split_chunks(const char *data, size_t size, TokenChunk **chunks) {
+    int capacity = size / TOKENIZE_CHUNK_SIZE + 2;
+    *chunks = (TokenChunk *)calloc(capacity, sizeof(TokenChunk));
+    if (*chunks == NULL) {
+        printf("Error: Out of memory\n");
+        exit(1);
+    }
+
+    int n = 0;
+    const char *start = data;
+    const char *end = data + size;
+    while (start < end) {
+        const char *split = end;
+        if ((size_t)(end - start) > TOKENIZE_CHUNK_SIZE) {
+            const char *found = find_doc_tag(start + TOKENIZE_CHUNK_SIZE, end);
+            if (found != NULL) {
+                split = found;
+            }
+        }
+        (*chunks)[n].start = start;
+        (*chunks)[n].end = split;
+        n += 1;
+        start = split;
+    }
+    return n;
+}
+
+int tokenize_file_parallel(const char *path, int n_threads, TextSink sink, void *context) {
+    int fd = open(path, O_RDONLY);
+    struct stat sb;
+    if (fd == -1 || fstat(fd, &sb) == -1) {
+        printf("Error: File not found\n");
+        if (fd != -1) close(fd);
+        return 1;
+    }
+    size_t size = sb.st_size;
+    if (size == 0) {
+        close(fd);
+        return 0;
+    }
+    void *mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        printf("Error: Couldn't map file\n");
+        return 1;
+    }
+
+    ParallelTokenizer pt;
+    memset(&pt, 0, sizeof(pt));
+    pt.data = (const char *)mapped;
+    pt.n_chunks = split_chunks(pt.data, size, &pt.chunks);
+    pt.window = n_threads * TOKENIZE_WINDOW;
+    pthread_mutex_init(&pt.lock, NULL);
+    pthread_cond_init(&pt.chunk_done, NULL);
+    pthread_cond_init(&pt.chunk_emitted, NULL);
+
+    pthread_t *threads = (pthread_t *)malloc(n_threads * sizeof(pthread_t));
+    for (int i = 0; i < n_threads; i++) {
+        if (pthread_create(&threads[i], NULL, tokenize_chunks_thread, &pt) != 0) {
+            printf("Error: Couldn't create thread\n");
+            exit(1);
+        }
+    }
+
+    /* Pass the chunks on in order. A chunk whose previous chunk didn't end
+     * in the state it was tokenized from is tokenized again, continuing
+     * from the actual state, so the output matches a single pass. */
+    Tokenizer state;
+    for (int i = 0; i < pt.n_chunks; i++) {
+        TokenChunk *chunk = &pt.chunks[i];
+        pthread_mutex_lock(&pt.lock);
+        while (!chunk->done) {
+            pthread_cond_wait(&pt.chunk_done, &pt.lock);
+        }
+        pthread_mutex_unlock(&pt.lock);
+
+        if (i > 0 && !tokenizer_is_clean(&state)) {
+            chunk->text.size = 0;
+            state.sink = append_line;
+            state.context = &chunk->text;
+            tokenizer_feed(&state, chunk->start, chunk->end - chunk->start);
+        } else {
+            state = chunk->tokenizer;
+        }
+        sink(context, (const char *)chunk->text.data, chunk->text.size);
+        bytebuffer_free(&chunk->text);
+
+        pthread_mutex_lock(&pt.lock);
+        pt.emitted += 1;
+        pthread_cond_broadcast(&pt.chunk_emitted);
+        pthread_mutex_unlock(&pt.lock);
+    }
+
+    for (int i = 0; i < n_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    pthread_mutex_destroy(&pt.lock);
+    pthread_cond_destroy(&pt.chunk_done);
+    pthread_cond_destroy(&pt.chunk_emitted);
+    free(pt.chunks);
+    munmap(mapped, size);
+    return 0;
+}
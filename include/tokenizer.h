@@ -0,0 +1,120 @@
+/**
+ * @file tokenizer.h
+ * @brief Streaming tokenizer of the WSJ XML collection.
+ *
+ * Turns the XML into the word stream of the parser: the ID of each
+ * document followed by its stemmed words, with an empty token between
+ * documents. Tokens are handed to a sink as they are found, so the
+ * stream can be written out (parser) or indexed in-process (indexer).
+ *
+ * Spans of bytes that can't change the state (the rest of a word, the
+ * gaps between words) are found 16 or 32 bytes at a time with SSE2/AVX2
+ * class masks, picked at run time, with a scalar fallback.
+ *
+ * tokenize_file_parallel maps the file, splits it at <DOC> tags into
+ * chunks and tokenizes the chunks on worker threads. The word stream of
+ * each chunk is handed on in file order, so the output is the same as
+ * tokenizing the file from start to end.
+ *
+ * @author Ubaada
+ * @date 01-04-2024
+ */
+
+#ifndef TOKENIZER_H
+#define TOKENIZER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define MAX_TOKEN_SIZE 255 /* Longer words are truncated to MAX_TOKEN_SIZE - 1 bytes */
+#define TOKENIZE_CHUNK_SIZE (1 << 20) /* Bytes of XML per chunk of the parallel tokenizer */
+#define TOKENIZE_WINDOW 4 /* Chunks per thread tokenized ahead of the output */
+
+/**
+ * Receives the tokens in order
+ *
+ * @param context The context given to tokenizer_init
+ * @param token The token, NUL terminated, valid during the call only
+ * @param length The length of the token, 0 between documents
+ */
+typedef void (*TokenSink)(void *context, const char *token, int length);
+
+/**
+ * Receives the word stream of the parallel tokenizer in order,
+ * a token per line with an empty line between documents
+ *
+ * @param context The context given to tokenize_file_parallel
+ * @param text The lines of a chunk, each ending with a newline
+ * @param size The number of bytes
+ */
+typedef void (*TextSink)(void *context, const char *text, size_t size);
+
+/* Tokenizer state, kept between buffers */
+typedef struct Tokenizer {
+    char word[MAX_TOKEN_SIZE];
+    int word_index;
+    bool is_angle_start; /* A '<' was seen */
+    bool is_angle_end; /* A '>' followed it, the next word ends a tag */
+    bool is_doc_id; /* The next word is a document ID */
+    bool is_first_doc;
+    bool stem; /* Stem words, true unless turned off to time the scanning alone */
+    unsigned char recent[4]; /* The last 4 bytes, to look back across buffers */
+    size_t offset; /* Bytes fed so far */
+    TokenSink sink;
+    void *context;
+} Tokenizer;
+
+/**
+ * Start tokenizing a collection
+ *
+ * @param tokenizer The tokenizer
+ * @param sink Receives the tokens
+ * @param context Passed to the sink
+ */
+void tokenizer_init(Tokenizer *tokenizer, TokenSink sink, void *context);
+
+/**
+ * Tokenize the next part of the collection
+ *
+ * @param tokenizer The tokenizer
+ * @param data The bytes
+ * @param size The number of bytes
+ */
+void tokenizer_feed(Tokenizer *tokenizer, const char *data, size_t size);
+
+/**
+ * Force a scanner: "bytewise" (every byte through the state machine),
+ * "scalar", "sse2" or "avx2". For benchmarks, call before tokenizing.
+ *
+ * @param name The scanner
+ * @return false if unknown or not supported by the CPU
+ */
+bool tokenizer_set_scanner(const char *name);
+
+/**
+ * Get the name of the scanner in use
+ */
+const char* tokenizer_scanner_name(void);
+
+/**
+ * Tokenize a whole file
+ *
+ * @param path The XML file
+ * @param sink Receives the tokens
+ * @param context Passed to the sink
+ * @return 0 on success, 1 if the file can't be read
+ */
+int tokenize_file(const char *path, TokenSink sink, void *context);
+
+/**
+ * Tokenize a whole file with worker threads
+ *
+ * @param path The XML file
+ * @param n_threads The number of worker threads
+ * @param sink Receives the word stream, chunk by chunk in file order
+ * @param context Passed to the sink
+ * @return 0 on success, 1 if the file can't be read
+ */
+int tokenize_file_parallel(const char *path, int n_threads, TextSink sink, void *context);
+
+#endif // TOKENIZER_H
@@ -0,0 +1,76 @@
+/**
+ * @file topk.c
+ * @brief Bounded min-heap of the best scored documents
+ */
+
+#include "topk.h"
+#include <stdlib.h>
+
+/* Check if document a ranks below document b */
+static inline bool ranks_below(const ScoredDoc *a, const ScoredDoc *b) {
+    return a->score < b->score || (a->score == b->score && a->doc_id > b->doc_id);
+}
+
+/* Move the document at i down to its place among the first n */
+static void sift_down(ScoredDoc *heap, int n, int i) {
+    ScoredDoc doc = heap[i];
+    while (true) {
+        int child = 2 * i + 1;
+        if (child >= n) break;
+        if (child + 1 < n && ranks_below(&heap[child + 1], &heap[child])) {
+            child += 1;
+        }
+        if (!ranks_below(&heap[child], &doc)) break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = doc;
+}
+
+bool topk_init(TopK *topk, int k) {
+    topk->heap = (ScoredDoc *)malloc(k * sizeof(ScoredDoc));
+    topk->size = 0;
+    topk->k = k;
+    return topk->heap != NULL;
+}
+
+bool topk_push(TopK *topk, int doc_id, float score) {
+    ScoredDoc doc = { doc_id, score };
+    if (topk->size < topk->k) {
+        /* Not full, sift the document up from the bottom */
+        int i = topk->size++;
+        while (i > 0 && ranks_below(&doc, &topk->heap[(i - 1) / 2])) {
+            topk->heap[i] = topk->heap[(i - 1) / 2];
+            i = (i - 1) / 2;
+        }
+        topk->heap[i] = doc;
+        return true;
+    }
+    if (!ranks_below(&topk->heap[0], &doc)) {
+        return false;
+    }
+    /* Replace the worst document */
+    topk->heap[0] = doc;
+    sift_down(topk->heap, topk->size, 0);
+    return true;
+}
+
+float topk_threshold(const TopK *topk) {
+    return topk->size < topk->k ? -1 : topk->heap[0].score;
+}
+
+int topk_sort(TopK *topk) {
+    /* Heap sort, the worst document goes to the back each round */
+    for (int n = topk->size - 1; n > 0; n--) {
+        ScoredDoc worst = topk->heap[0];
+        topk->heap[0] = topk->heap[n];
+        topk->heap[n] = worst;
+        sift_down(topk->heap, n, 0);
+    }
+    return topk->size;
+}
+
+void topk_free(TopK *topk) {
+    free(topk->heap);
+    topk->heap = NULL;
+}
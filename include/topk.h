@@ -0,0 +1,68 @@
+/**
+ * @file topk.h
+ * @brief The k best scored documents, kept in a bounded min-heap.
+ *
+ * The root of the heap is the worst document kept, a new document only
+ * needs to beat it. Documents rank by score, higher first, and equal
+ * scores by document index, lower first (the order a stable sort of
+ * the documents in index order gives).
+ *
+ * @author Ubaada
+ * @date 01-04-2024
+ */
+
+#ifndef TOPK_H
+#define TOPK_H
+
+#include <stdbool.h>
+
+typedef struct ScoredDoc {
+    int doc_id; /* Document index */
+    float score;
+} ScoredDoc;
+
+typedef struct TopK {
+    ScoredDoc *heap; /* Worst document at heap[0] */
+    int size;
+    int k;
+} TopK;
+
+/**
+ * Create an empty top-k
+ *
+ * @param topk The top-k
+ * @param k The number of documents to keep, at least 1
+ * @return false if out of memory
+ */
+bool topk_init(TopK *topk, int k);
+
+/**
+ * Offer a document
+ *
+ * @param topk The top-k
+ * @param doc_id The document index
+ * @param score Its score
+ * @return true if the document was kept
+ */
+bool topk_push(TopK *topk, int doc_id, float score);
+
+/**
+ * Score a document must beat to be kept once the top-k is full
+ *
+ * @param topk The top-k
+ * @return The score of the worst document kept, -1 while not full
+ */
+float topk_threshold(const TopK *topk);
+
+/**
+ * Sort the documents kept best first, the heap is used up
+ *
+ * @param topk The top-k
+ * @return The number of documents, in topk->heap
+ */
+int topk_sort(TopK *topk);
+
+/* Free the heap */
+void topk_free(TopK *topk);
+
+#endif // TOPK_H
@@ -0,0 +1,125 @@
+/**
+ * @file vocabulary.c
+ * @brief Open addressing (linear probing) hash table of terms
+ */
+
+#include "vocabulary.h"
+#include "common.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define VOCAB_MAX_LOAD 0.5 /* Grow the table above this fraction of used slots */
+
+/* Allocate zeroed slots, exits if out of memory */
+static VocabSlot* vocab_alloc_slots(size_t capacity) {
+    VocabSlot *slots = (VocabSlot *)calloc(capacity, sizeof(VocabSlot));
+    if (slots == NULL) {
+        printf("Error: Out of memory\n");
+        exit(1);
+    }
+    return slots;
+}
+
+Vocabulary* vocab_create(Arena *arena) {
+    Vocabulary *vocab = (Vocabulary *)malloc(sizeof(Vocabulary));
+    if (vocab == NULL) {
+        return NULL;
+    }
+    vocab->capacity = VOCAB_INITIAL_CAPACITY;
+    vocab->slots = vocab_alloc_slots(vocab->capacity);
+    vocab->size = 0;
+    vocab->arena = arena;
+    return vocab;
+}
+
+/* Double the table, rehashing with the stored hashes */
+static void vocab_grow(Vocabulary *vocab) {
+    size_t capacity = vocab->capacity * 2;
+    VocabSlot *slots = vocab_alloc_slots(capacity);
+    for (size_t i = 0; i < vocab->capacity; i++) {
+        if (vocab->slots[i].term == NULL) {
+            continue;
+        }
+        size_t j = vocab->slots[i].hash & (capacity - 1);
+        while (slots[j].term != NULL) {
+            j = (j + 1) & (capacity - 1);
+        }
+        slots[j] = vocab->slots[i];
+    }
+    free(vocab->slots);
+    vocab->slots = slots;
+    vocab->capacity = capacity;
+}
+
+/* Slot holding the term, or the empty slot where it would go */
+static size_t vocab_probe(const Vocabulary *vocab, const char *key, size_t length, uint32_t hash) {
+    size_t mask = vocab->capacity - 1;
+    size_t i = hash & mask;
+    while (vocab->slots[i].term != NULL) {
+        const VocabTerm *term = vocab->slots[i].term;
+        if (vocab->slots[i].hash == hash && term->length == length && memcmp(term->key, key, length) == 0) {
+            break;
+        }
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+VocabTerm* vocab_find(const Vocabulary *vocab, const char *key, size_t length) {
+    uint32_t hash = hash_fnv1a(key, length);
+    return vocab->slots[vocab_probe(vocab, key, length, hash)].term;
+}
+
+VocabTerm* vocab_find_or_add(Vocabulary *vocab, const char *key, size_t length, bool *added) {
+    uint32_t hash = hash_fnv1a(key, length);
+    size_t i = vocab_probe(vocab, key, length, hash);
+    if (vocab->slots[i].term != NULL) {
+        *added = false;
+        return vocab->slots[i].term;
+    }
+
+    /* Intern the term next to its value and hash */
+    VocabTerm *term = (VocabTerm *)arena_alloc(vocab->arena, sizeof(VocabTerm) + length + 1);
+    term->value = NULL;
+    term->hash = hash;
+    term->length = (uint32_t)length;
+    memcpy(term->key, key, length);
+    term->key[length] = '\0';
+
+    vocab->slots[i].hash = hash;
+    vocab->slots[i].term = term;
+    vocab->size += 1;
+    if (vocab->size > vocab->capacity * VOCAB_MAX_LOAD) {
+        vocab_grow(vocab);
+    }
+    *added = true;
+    return term;
+}
+
+/* qsort comparator of term pointers */
+static int vocab_term_cmp(const void *a, const void *b) {
+    return strcmp((*(VocabTerm * const *)a)->key, (*(VocabTerm * const *)b)->key);
+}
+
+VocabTerm** vocab_sorted(const Vocabulary *vocab) {
+    VocabTerm **terms = (VocabTerm **)malloc((vocab->size + 1) * sizeof(VocabTerm *));
+    if (terms == NULL) {
+        printf("Error: Out of memory\n");
+        exit(1);
+    }
+    size_t n = 0;
+    for (size_t i = 0; i < vocab->capacity; i++) {
+        if (vocab->slots[i].term != NULL) {
+            terms[n++] = vocab->slots[i].term;
+        }
+    }
+    qsort(terms, n, sizeof(VocabTerm *), vocab_term_cmp);
+    return terms;
+}
+
+void vocab_destroy(Vocabulary *vocab) {
+    if (vocab == NULL) return;
+    free(vocab->slots);
+    free(vocab);
+}
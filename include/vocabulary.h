@@ -0,0 +1,89 @@
+/**
+ * @file vocabulary.h
+ * @brief Open addressing hash table of the terms seen while indexing.
+ *
+ * Each term is interned once in an arena together with its hash and a
+ * value slot (the posting list). The table itself only holds the hash and
+ * a pointer per slot, so a probe compares hashes before touching a key.
+ * Terms are unordered, vocab_sorted sorts them once for writing.
+ *
+ * @author Ubaada
+ * @date 01-04-2024
+ */
+
+#ifndef VOCABULARY_H
+#define VOCABULARY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "arena.h"
+
+#define VOCAB_INITIAL_CAPACITY 1024 /* Slots of a new table, a power of two */
+
+/* An interned term, allocated from the arena of the vocabulary */
+typedef struct VocabTerm {
+    void *value; /* Attached by the caller, NULL for a new term */
+    uint32_t hash;
+    uint32_t length;
+    char key[]; /* NUL terminated */
+} VocabTerm;
+
+/* A slot of the table, term is NULL when empty */
+typedef struct VocabSlot {
+    uint32_t hash;
+    VocabTerm *term;
+} VocabSlot;
+
+typedef struct Vocabulary {
+    VocabSlot *slots;
+    size_t capacity; /* Power of two */
+    size_t size; /* Terms in the table */
+    Arena *arena; /* Terms are interned here */
+} Vocabulary;
+
+/**
+ * Create an empty vocabulary
+ *
+ * @param arena The arena the terms are interned in
+ * @return The vocabulary, NULL if out of memory
+ */
+Vocabulary* vocab_create(Arena *arena);
+
+/**
+ * Find a term, adding it if it isn't in the vocabulary yet
+ *
+ * @param vocab The vocabulary
+ * @param key The term, need not be NUL terminated
+ * @param length The length of the term
+ * @param added Set to true if the term was added
+ * @return The term
+ */
+VocabTerm* vocab_find_or_add(Vocabulary *vocab, const char *key, size_t length, bool *added);
+
+/**
+ * Find a term
+ *
+ * @param vocab The vocabulary
+ * @param key The term, need not be NUL terminated
+ * @param length The length of the term
+ * @return The term, NULL if it isn't in the vocabulary
+ */
+VocabTerm* vocab_find(const Vocabulary *vocab, const char *key, size_t length);
+
+/**
+ * List the terms in strcmp order
+ *
+ * @param vocab The vocabulary
+ * @return An array of vocab->size terms to free() after use
+ */
+VocabTerm** vocab_sorted(const Vocabulary *vocab);
+
+/**
+ * Free the table, the terms go with the arena
+ *
+ * @param vocab The vocabulary, may be NULL
+ */
+void vocab_destroy(Vocabulary *vocab);
+
+#endif // VOCABULARY_H
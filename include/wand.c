@@ -0,0 +1,157 @@
+/**
+ * @file wand.c
+ * @brief Exhaustive and Block-Max WAND disjunctive top-k retrieval
+ */
+
+#include "wand.h"
+#include "ranking.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+
+#define NO_DOC INT_MAX /* Current document of an exhausted cursor */
+
+/* A term while the query runs */
+typedef struct TermState {
+    QueryTerm *term;
+    Posting current; /* doc_id NO_DOC once exhausted */
+    float max_score; /* Upper bound of the term's score in any document */
+} TermState;
+
+/* Move a term to its first document >= target */
+static inline void advance(TermState *state, int target) {
+    if (!posting_cursor_next_geq(state->term->cursor, target, &state->current)) {
+        state->current.doc_id = NO_DOC;
+    }
+}
+
+/* Open every term at its first document, the states sized for the query, NULL if out of memory */
+static TermState* start_terms(QueryTerm *terms, int n_terms, WandStats *stats) {
+    TermState *states = (TermState *)malloc((n_terms + 1) * sizeof(TermState));
+    if (states == NULL) {
+        printf("Error: Out of memory\n");
+        return NULL;
+    }
+    for (int i = 0; i < n_terms; i++) {
+        states[i].term = &terms[i];
+        states[i].max_score = terms[i].idf * (BM25_K1 + 1) * posting_cursor_list_max(terms[i].cursor);
+        advance(&states[i], 0);
+        stats->n_postings += terms[i].cursor->n_postings;
+    }
+    return states;
+}
+
+/**
+ * Score a document from every term positioned on it, in term order,
+ * and move those terms past it
+ */
+static void score_document(TermState *states, int n_terms, int doc, const float *norm, TopK *topk, WandStats *stats) {
+    float score = 0;
+    for (int i = 0; i < n_terms; i++) {
+        if (states[i].current.doc_id == doc) {
+            score += bm25_score(states[i].term->idf, states[i].current.freq, norm[doc]);
+            advance(&states[i], doc + 1);
+        }
+    }
+    topk_push(topk, doc, score);
+    stats->n_scored += 1;
+}
+
+void or_query_exhaustive(QueryTerm *terms, int n_terms, const float *norm, TopK *topk, WandStats *stats) {
+    TermState *states = start_terms(terms, n_terms, stats);
+    if (states == NULL) {
+        return;
+    }
+
+    while (true) {
+        int doc = NO_DOC;
+        for (int i = 0; i < n_terms; i++) {
+            if (states[i].current.doc_id < doc) doc = states[i].current.doc_id;
+        }
+        if (doc == NO_DOC) {
+            break;
+        }
+        score_document(states, n_terms, doc, norm, topk, stats);
+    }
+    free(states);
+}
+
+void or_query_wand(QueryTerm *terms, int n_terms, const float *norm, TopK *topk, WandStats *stats) {
+    TermState *states = start_terms(terms, n_terms, stats);
+    TermState **order = (TermState **)malloc((n_terms + 1) * sizeof(TermState *)); /* Terms by current document */
+    if (states == NULL || order == NULL) {
+        free(states);
+        free(order);
+        return;
+    }
+    for (int i = 0; i < n_terms; i++) {
+        order[i] = &states[i];
+    }
+
+    while (true) {
+        /* Insertion sort, the order changes little between rounds */
+        for (int i = 1; i < n_terms; i++) {
+            TermState *state = order[i];
+            int j = i;
+            while (j > 0 && order[j - 1]->current.doc_id > state->current.doc_id) {
+                order[j] = order[j - 1];
+                j--;
+            }
+            order[j] = state;
+        }
+
+        /* Pivot: the first term where the upper bounds so far beat the threshold */
+        float threshold = topk_threshold(topk);
+        float bound = 0;
+        int pivot = -1;
+        for (int i = 0; i < n_terms && order[i]->current.doc_id != NO_DOC; i++) {
+            bound += order[i]->max_score;
+            if (bound > threshold) {
+                pivot = i;
+                break;
+            }
+        }
+        if (pivot < 0) {
+            break; /* No document left can make it into the top-k */
+        }
+        int pivot_doc = order[pivot]->current.doc_id;
+        while (pivot + 1 < n_terms && order[pivot + 1]->current.doc_id == pivot_doc) {
+            pivot += 1;
+        }
+
+        /* Tighter bound from the blocks holding the pivot document */
+        float block_bound = 0;
+        int block_end = NO_DOC;
+        for (int i = 0; i <= pivot; i++) {
+            int last_doc;
+            float block_max = posting_cursor_block_max(order[i]->term->cursor, pivot_doc, &last_doc);
+            block_bound += order[i]->term->idf * (BM25_K1 + 1) * block_max;
+            if (last_doc < block_end) block_end = last_doc;
+        }
+
+        if (block_bound > threshold) {
+            if (order[0]->current.doc_id == pivot_doc) {
+                score_document(states, n_terms, pivot_doc, norm, topk, stats);
+            } else {
+                /* No document before the pivot can make it */
+                for (int i = 0; i < pivot && order[i]->current.doc_id < pivot_doc; i++) {
+                    advance(order[i], pivot_doc);
+                }
+            }
+        } else {
+            /* Until the end of the smallest block, or the next term's
+             * document, only these blocks can score and they fall short */
+            int next = block_end + 1;
+            if (pivot + 1 < n_terms && order[pivot + 1]->current.doc_id < next) {
+                next = order[pivot + 1]->current.doc_id;
+            }
+            for (int i = 0; i <= pivot; i++) {
+                if (order[i]->current.doc_id < next) {
+                    advance(order[i], next);
+                }
+            }
+        }
+    }
+    free(order);
+    free(states);
+}
@@ -0,0 +1,60 @@
+/**
+ * @file wand.h
+ * @brief Top-k disjunctive (OR) retrieval with BM25, exhaustive or with
+ * Block-Max WAND dynamic pruning.
+ *
+ * Both walk the posting lists document at a time in doc_id order and add
+ * up the scores of a document in query term order, so they find the same
+ * documents with the same scores. Block-Max WAND orders the cursors by
+ * their current document and picks as pivot the first document whose
+ * list upper bounds could beat the k-th best score so far. The block
+ * maxima of the pivot's blocks are checked next (a shallow move along the
+ * skip tables) and if they can't beat it either, the cursors jump past
+ * the end of the smallest of those blocks without decoding anything.
+ *
+ * @author Ubaada
+ * @date 01-04-2024
+ */
+
+#ifndef WAND_H
+#define WAND_H
+
+#include "postings.h"
+#include "topk.h"
+
+/* A query term: the cursor over its posting list and its IDF */
+typedef struct QueryTerm {
+    PostingCursor *cursor;
+    float idf;
+} QueryTerm;
+
+/* Work done by one query */
+typedef struct WandStats {
+    long n_scored; /* Documents fully scored */
+    long n_postings; /* Postings of all query terms */
+} WandStats;
+
+/**
+ * Score every document that holds any of the terms
+ *
+ * @param terms The query terms, their cursors fresh
+ * @param n_terms The number of terms
+ * @param norm BM25 length normalisation of every document
+ * @param topk Receives the best documents, initialised by the caller
+ * @param stats Work counters, added to
+ */
+void or_query_exhaustive(QueryTerm *terms, int n_terms, const float *norm, TopK *topk, WandStats *stats);
+
+/**
+ * Find the same documents as or_query_exhaustive, skipping documents and
+ * blocks whose upper bounds can't make it into the top-k
+ *
+ * @param terms The query terms, their cursors fresh
+ * @param n_terms The number of terms
+ * @param norm BM25 length normalisation of every document
+ * @param topk Receives the best documents, initialised by the caller
+ * @param stats Work counters, added to
+ */
+void or_query_wand(QueryTerm *terms, int n_terms, const float *norm, TopK *topk, WandStats *stats);
+
+#endif // WAND_H
@@ -0,0 +1,112 @@
+/**
+ * @file work_pool.c
+ * @brief Work-stealing thread pool over a range of items
+ */
+
+#include "work_pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+/* The chunks of one worker, the owner pops the front, thieves the back */
+typedef struct WorkDeque {
+    pthread_mutex_t lock;
+    int *chunks;
+    int head;
+    int tail;
+} WorkDeque;
+
+typedef struct WorkPool {
+    WorkDeque *deques;
+    int n_workers;
+    int n_items;
+    int chunk_size;
+    WorkFunc work;
+    void *context;
+} WorkPool;
+
+typedef struct Worker {
+    WorkPool *pool;
+    int id;
+} Worker;
+
+/* Take a chunk from the front (own deque) or the back (stealing), -1 if empty */
+static int deque_take(WorkDeque *deque, bool steal) {
+    int chunk = -1;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->head < deque->tail) {
+        chunk = steal ? deque->chunks[--deque->tail] : deque->chunks[deque->head++];
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return chunk;
+}
+
+/* Own chunks first, then the other workers' in turn */
+static int next_chunk(WorkPool *pool, int id) {
+    int chunk = deque_take(&pool->deques[id], false);
+    for (int i = 1; chunk == -1 && i < pool->n_workers; i++) {
+        chunk = deque_take(&pool->deques[(id + i) % pool->n_workers], true);
+    }
+    return chunk;
+}
+
+static void* worker_main(void *arg) {
+    Worker *worker = (Worker *)arg;
+    WorkPool *pool = worker->pool;
+    int chunk;
+    while ((chunk = next_chunk(pool, worker->id)) != -1) {
+        int first = chunk * pool->chunk_size;
+        int last = first + pool->chunk_size < pool->n_items ? first + pool->chunk_size : pool->n_items;
+        for (int item = first; item < last; item++) {
+            pool->work(pool->context, item, worker->id);
+        }
+    }
+    return NULL;
+}
+
+bool work_pool_run(int n_items, int chunk_size, int n_workers, WorkFunc work, void *context) {
+    if (n_workers <= 1) {
+        for (int item = 0; item < n_items; item++) {
+            work(context, item, 0);
+        }
+        return true;
+    }
+
+    /* Deal the chunks round robin, each deque holds them in increasing order */
+    int n_chunks = (n_items + chunk_size - 1) / chunk_size;
+    WorkPool pool = { NULL, n_workers, n_items, chunk_size, work, context };
+    pool.deques = (WorkDeque *)calloc(n_workers, sizeof(WorkDeque));
+    for (int w = 0; w < n_workers; w++) {
+        pthread_mutex_init(&pool.deques[w].lock, NULL);
+        pool.deques[w].chunks = (int *)malloc((n_chunks / n_workers + 1) * sizeof(int));
+    }
+    for (int c = 0; c < n_chunks; c++) {
+        WorkDeque *deque = &pool.deques[c % n_workers];
+        deque->chunks[deque->tail++] = c;
+    }
+
+    pthread_t threads[WORK_POOL_MAX_THREADS];
+    Worker workers[WORK_POOL_MAX_THREADS];
+    int n_started = 0;
+    for (; n_started < n_workers && n_started < WORK_POOL_MAX_THREADS; n_started++) {
+        workers[n_started].pool = &pool;
+        workers[n_started].id = n_started;
+        if (pthread_create(&threads[n_started], NULL, worker_main, &workers[n_started]) != 0) {
+            break;
+        }
+    }
+    /* The started threads steal the chunks of the ones that failed */
+    for (int w = 0; w < n_started; w++) {
+        pthread_join(threads[w], NULL);
+    }
+    if (n_started == 0) {
+        printf("Error: Couldn't start the worker threads\n");
+    }
+
+    for (int w = 0; w < n_workers; w++) {
+        pthread_mutex_destroy(&pool.deques[w].lock);
+        free(pool.deques[w].chunks);
+    }
+    free(pool.deques);
+    return n_started > 0;
+}
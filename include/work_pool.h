@@ -0,0 +1,44 @@
+/**
+ * @file work_pool.h
+ * @brief Work-stealing thread pool over a range of items.
+ *
+ * The items 0..n-1 are cut into chunks of consecutive items and dealt out
+ * round robin to one deque per worker. A worker takes its own chunks from
+ * the front, lowest first, and once its deque is empty steals a chunk from
+ * the back of another worker's. No work is added while the pool runs, so
+ * a worker that finds every deque empty is done. Items finish roughly in
+ * order, which keeps the buffering of an in-order consumer small.
+ *
+ * @author Ubaada
+ * @date 01-04-2024
+ */
+
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+#include <stdbool.h>
+
+#define WORK_POOL_MAX_THREADS 256
+
+/**
+ * Processes one item
+ *
+ * @param context The context given to work_pool_run
+ * @param item The item, 0 to n_items - 1
+ * @param worker The worker running it, 0 to n_workers - 1
+ */
+typedef void (*WorkFunc)(void *context, int item, int worker);
+
+/**
+ * Run work on every item with a pool of threads, returns once all are done
+ *
+ * @param n_items The number of items
+ * @param chunk_size Consecutive items taken at a time, at least 1
+ * @param n_workers The number of threads, 1 runs the items in order on the caller
+ * @param work Called once for each item
+ * @param context Passed to work
+ * @return false if the threads couldn't be started
+ */
+bool work_pool_run(int n_items, int chunk_size, int n_workers, WorkFunc work, void *context);
+
+#endif // WORK_POOL_H
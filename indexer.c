@@ -4,11 +4,34 @@
  * @brief Uses the parsed data to create an index for the search engine.
  *
  * This program creates (from a stream of words and document IDs)
- * 1. A list of document IDs
+ * 1. A list of document IDs, as text and as a binary store (see include/doc_ids.h)
  * 2. A dictionary file with byte offsets to posting lists
  * 3. A posting list file with doc_id index and frequency
  *     i.  Delta encoding for doc_id
  *     ii. Further Variable byte encoding for doc_id and frequency
+ *     iii. Grouped into blocks with a skip table (see include/postings.h)
+ *     iv. BM25 upper bounds of each list and block, for dynamic pruning
+ * 4. A statistics file with the length of every document, for BM25
+ *
+ * With -j N the word stream is split at document boundaries (blank lines)
+ * and N threads each build a partial index over their own range of
+ * documents. The partial indexes are merged word by word when writing.
+ *
+ * With -m MB the indexer keeps its in-memory index under a memory budget
+ * (SPIMI): when the budget is reached at a document boundary the sorted
+ * postings are flushed to a temporary run file and the memory is released.
+ * The runs are merged into the final dictionary and posting files at the end.
+ *
+ * With --from-xml the indexer reads the XML collection and runs the parser's
+ * tokenizer in-process, skipping the intermediate word stream file. With
+ * --pipeline the tokenizer and the indexing run on separate threads, joined
+ * by a bounded lock-free queue of token batches. With -j N, N threads
+ * tokenize chunks of the XML while the main thread indexes them in order.
+ *
+ * The index files are written under a ".new" suffix and renamed into place
+ * once complete, the dictionary last. They share a build stamp, so a
+ * searcher running in --serve mode never reopens a half written index or
+ * a mix of two builds.
  * 
  * @author Ubaada
  * @date 01-04-2024
@@ -18,196 +41,1284 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
 
-#include "include/rbtree.h"
+#include "include/vocabulary.h"
 #include "include/linked_list.h"
 #include "include/common.h"
+#include "include/postings.h"
+#include "include/codec.h"
+#include "include/timing.h"
+#include "include/arena.h"
+#include "include/tokenizer.h"
+#include "include/spsc_queue.h"
+#include "include/ranking.h"
+#include "include/doc_ids.h"
+#include "include/dictionary.h"
 
 #define ID_FILE "data/doc_id_list.txt" /* DOC ID list to convert index to doc_id */
 #define DICT_FILE "data/dict_and_offset.bin" /* Dictionary file with byte offset to posting list */
 #define POSTING_FILE "data/posting_list.bin" /* Posting list file, contains doc_id index and freq */
+#define RUN_FILE "data/run_%d.tmp" /* Sorted partial index flushed by the memory budget */
+#define MERGE_FAN_IN 64 /* Runs merged at once, well under the open file limit */
+#define BUDGET_BLOCKS 8 /* A memory budget holds at least this many arena blocks */
+#define NEW_SUFFIX ".new" /* Index files are written under this suffix, then renamed into place */
+#define MAX_THREADS 256
+#define TOKEN_BATCH_SIZE (1 << 16) /* Bytes of tokens per batch of the --pipeline queue */
+#define TOKEN_BATCHES 8 /* Batches in flight between the tokenizer and indexing threads */
+
+/* Stamp of this build, in the dictionary header and the trailer of the other files */
+static uint64_t build_stamp = 0;
+
+/*
+ * Runs flushed to disk by a memory budgeted (SPIMI) build
+ */
+typedef struct RunSet {
+    int n_runs;
+    FILE *id_file; /* Document IDs are appended at every flush */
+    DocIdWriter id_store;
+    bool first_id;
+    const char *text; /* Start of the word stream, released after each flush, NULL if not mapped */
+} RunSet;
+
+/*
+ * Partial index over a contiguous range of documents of the word stream.
+ * Doc indexes are local to the range, doc_base is added when merging.
+ * The terms, posting lists, postings and IDs all live in one arena.
+ */
+typedef struct PartialIndex {
+    const char *start; /* Word stream of this range */
+    const char *end;
+    Arena *arena; /* Memory of the terms, postings and IDs */
+    Vocabulary *vocab; /* Terms with their postings attached */
+    LinkedList *id_list; /* list of document IDs */
+    int n_docs;
+    uint32_t *doc_lengths; /* Words of each document, kept across flushes */
+    int lengths_capacity;
+    int doc_base; /* Index of the first document in the whole collection */
+    long n_words; /* Words (tokens) indexed */
+    bool expect_id; /* The next line is a document ID */
+    bool show_progress;
+    size_t memory_budget; /* Flush a run when the arena grows above this, 0 for no budget */
+    Arena totals; /* Counters of the arenas released so far */
+    RunSet *runs;
+} PartialIndex;
+
+/* Destination of the dictionary and posting files */
+typedef struct IndexWriter {
+    FILE *fp_post;
+    FILE *fp_dict;
+    IndexHeader header;
+    const float *norm; /* BM25 length normalisation, for the block maxima */
+    int64_t byte_offset; /* Offset of the next posting list */
+    ByteBuffer encoded;
+    DictWriter dict;
+} IndexWriter;
 
+/* Time spent in each phase of an index build */
+typedef struct BuildTiming {
+    double index_seconds;
+    double write_seconds;
+} BuildTiming;
+
+
+/**
+ * Append a list of document IDs to the ID file and the ID store
+ * 
+ * @param fp The ID file
+ * @param store The ID store
+ * @param list The linked list of document IDs
+ * @param first true if nothing has been written to the file yet, updated
+ */
+void append_id_list(FILE *fp, DocIdWriter *store, LinkedList *list, bool *first) {
+    Node *current = list->head;
+    while (current != NULL) {
+        /* Newline separated list of document IDs */
+        fprintf(fp, *first ? "%s" : "\n%s", (char *)current->data);
+        doc_id_writer_add(store, (char *)current->data);
+        *first = false;
+        current = current->next;
+    }
+}
 
 /**
  * Save the list of document IDs to a file
  * Produces: data/doc_id_list.txt
+ *           data/doc_ids.bin
  * 
- * @param list The linked list of document IDs
+ * @param parts The partial indexes, in document order
+ * @param n_parts The number of partial indexes
  */
-void save_id_list(LinkedList *list) {
-    FILE *fp = fopen(ID_FILE, "wb");
-    if (fp == NULL) {
+void save_id_list(PartialIndex *parts, int n_parts) {
+    FILE *fp = fopen(ID_FILE NEW_SUFFIX, "wb");
+    DocIdWriter store;
+    if (fp == NULL || !doc_id_writer_open(&store, DOC_IDS_FILE NEW_SUFFIX)) {
         printf("Error: Couldn't open file for writing\n");
+        if (fp) fclose(fp);
         return;
     }
 
-    Node *current = list->head;
-    while (current != NULL) {
-        /* Newline separated list of document IDs */
-        if (current->next != NULL) {
-            fprintf(fp, "%s\n", (char *)current->data);
-        } else {
-            fprintf(fp, "%s", (char *)current->data);
-        }
-        current = current->next;
+    bool first = true;
+    for (int i = 0; i < n_parts; i++) {
+        append_id_list(fp, &store, parts[i].id_list, &first);
     }
 
+    doc_id_writer_close(&store);
     fclose(fp);
 }
 
+/**
+ * Save the length of every document for ranking
+ * Produces: data/doc_stats.bin
+ * 
+ * @param parts The partial indexes, in document order
+ * @param n_parts The number of partial indexes
+ * @param stats Filled with the statistics of the whole collection
+ */
+void save_doc_stats(PartialIndex *parts, int n_parts, DocStats *stats) {
+    int n_docs = 0;
+    for (int i = 0; i < n_parts; i++) {
+        n_docs += parts[i].n_docs;
+    }
+    uint32_t *lengths = (uint32_t *)malloc((n_docs + 1) * sizeof(uint32_t));
+    int n = 0;
+    for (int i = 0; i < n_parts; i++) {
+        memcpy(lengths + n, parts[i].doc_lengths, parts[i].n_docs * sizeof(uint32_t));
+        n += parts[i].n_docs;
+    }
+    doc_stats_init(stats, lengths, n_docs);
+    doc_stats_write(DOC_STATS_FILE NEW_SUFFIX, stats);
+}
 
-/* 
-Recursive Helper function to write the posting lists & dictionary to files
-*/
-void _write_dict_postings(RBTree *tree, RBTreeNode *node, FILE *fp_post, FILE *fp_dict, int* byte_offset) {
-    if (node == tree->nil) return;
+/**
+ * Add one occurrence of a word in a document to the vocabulary.
+ * New lists and postings are allocated from the vocabulary's arena.
+ * 
+ * @param vocab The vocabulary
+ * @param word The word, need not be NUL terminated
+ * @param length The length of the word
+ * @param doc_index The document the word occurs in
+ */
+void add_posting(Vocabulary *vocab, const char *word, size_t length, int doc_index) {
+    /*
+     * Find or add the word, a new word has no posting list yet
+     * If the last posting is for this document, increment the freq
+     * Otherwise add a new posting
+     */
+    bool added;
+    VocabTerm *term = vocab_find_or_add(vocab, word, length, &added);
+    if (added) {
+        term->value = linkedlist_create_arena(posting_cmp, vocab->arena);
+    } else {
+        Posting* last_posting = (Posting *)((LinkedList *)term->value)->tail->data;
+        if (last_posting->doc_id == doc_index) {
+            last_posting->freq += 1;
+            return;
+        }
+    }
+    Posting* new_posting = (Posting *)arena_alloc(vocab->arena, sizeof(Posting));
+    new_posting->doc_id = doc_index;
+    new_posting->freq = 1;
+    linkedlist_add_tail((LinkedList *)term->value, new_posting);
+}
 
-    _write_dict_postings(tree, node->left, fp_post, fp_dict, byte_offset);
+/**
+ * Create the arena, vocabulary and ID list of a partial index.
+ * Under a memory budget the arena blocks are a fraction of the budget,
+ * so reserving a new block doesn't overshoot it.
+ * 
+ * @param part The partial index, its memory_budget already set
+ */
+static void part_alloc(PartialIndex *part) {
+    size_t block_size = 0;
+    if (part->memory_budget > 0) {
+        block_size = part->memory_budget / BUDGET_BLOCKS;
+        if (block_size > ARENA_BLOCK_SIZE) block_size = ARENA_BLOCK_SIZE;
+    }
+    part->arena = arena_create(block_size);
+    part->vocab = vocab_create(part->arena);
+    part->id_list = linkedlist_create_arena(NULL, part->arena);
+}
 
-    /* Write the key to the dictionary file in MAX_KEY_SIZE bytes
-     * followed by the byte offset in 4 bytes */
-    fwrite(node->key, sizeof(char), MAX_KEY_SIZE, fp_dict);
-    write_int_big_endian(fp_dict, *byte_offset);
+/**
+ * Release the terms, postings and IDs of a partial index in one go,
+ * adding the arena counters to the totals of the part
+ * 
+ * @param part The partial index
+ */
+static void part_free(PartialIndex *part) {
+    part->totals.n_allocations += part->arena->n_allocations;
+    part->totals.bytes_used += part->arena->bytes_used;
+    if (part->arena->bytes_reserved > part->totals.bytes_reserved) {
+        part->totals.bytes_reserved = part->arena->bytes_reserved; /* Largest arena at one time */
+    }
+    vocab_destroy(part->vocab);
+    arena_destroy(part->arena);
+    part->arena = NULL;
+    part->vocab = NULL;
+    part->id_list = NULL;
+}
 
-    LinkedList *list = (LinkedList *)node->value;
-    Node *current = list->head;
+/**
+ * Find the next line of the word stream
+ * 
+ * @param p The start of the line
+ * @param end The end of the word stream
+ * @param length Set to the length of the line without the newline
+ * @return The start of the following line
+ */
+static const char* next_line(const char *p, const char *end, int *length) {
+    const char *newline = memchr(p, '\n', end - p);
+    if (newline == NULL) {
+        *length = end - p;
+        return end;
+    }
+    *length = newline - p;
+    return newline + 1;
+}
 
-    /* Previous doc_id for delta encoding */
-    int prev_doc_id = 0;
-    while (current != NULL) {
-        /* Write index and freq to the posting file.
-        *  Total bytes written is tracked for offset of the next word
-        */
-        Posting *posting = (Posting *)current->data;
-        int doc_id_delta = posting->doc_id - prev_doc_id;
-        int id_bytes = variable_byte_encode(doc_id_delta, fp_post);
-        int freq_bytes = variable_byte_encode(posting->freq, fp_post);
-        current = current->next;
-        *byte_offset += id_bytes + freq_bytes;
-        prev_doc_id = posting->doc_id;
+static void flush_run(PartialIndex *part, const char *consumed);
+
+/**
+ * Check if a partial index has outgrown its memory budget
+ */
+static bool over_budget(const PartialIndex *part) {
+    size_t memory_used = part->arena->bytes_reserved + part->vocab->capacity * sizeof(VocabSlot);
+    return part->memory_budget > 0 && memory_used > part->memory_budget;
+}
+
+/**
+ * Index one line of the word stream.
+ * After a blank line (or at the start) the line is a document ID,
+ * other lines are words of the current document.
+ * 
+ * @param part The partial index
+ * @param line The line, need not be NUL terminated
+ * @param length The length of the line
+ * @return true if the line is a blank line ending a document
+ */
+static bool index_line(PartialIndex *part, const char *line, int length) {
+    if (part->expect_id) {
+        char id_line[255];
+        if (length > (int)sizeof(id_line) - 1) length = sizeof(id_line) - 1;
+        memcpy(id_line, line, length);
+        id_line[length] = '\0';
+        linkedlist_add_tail(part->id_list, arena_strdup(part->arena, id_line));
+        if (part->n_docs == part->lengths_capacity) {
+            part->lengths_capacity = part->lengths_capacity ? part->lengths_capacity * 2 : 1024;
+            part->doc_lengths = (uint32_t *)realloc(part->doc_lengths, part->lengths_capacity * sizeof(uint32_t));
+        }
+        part->doc_lengths[part->n_docs] = 0;
+        part->n_docs += 1; /* Documents are numbered in the order they appear */
+        part->expect_id = false;
+        return false;
+    }
+    if (length == 0) {
+        part->expect_id = true;
+        return true;
+    }
+
+    add_posting(part->vocab, line, length, part->n_docs - 1);
+    part->doc_lengths[part->n_docs - 1] += 1;
+    part->n_words += 1;
+
+    /* Print progress */
+    if (part->show_progress && part->n_words % 1000000 == 0) {
+        printf("\rWords: %ld\n", part->n_words);
+        fflush(stdout);
+    }
+    return false;
+}
+
+/**
+ * Index the words of a range of documents.
+ * The range starts with a document ID line, words follow one per line
+ * and a blank line is followed by the ID of the next document.
+ * 
+ * @param part The partial index to fill
+ */
+void index_range(PartialIndex *part) {
+    const char *p = part->start;
+    const char *end = part->end;
+    int length;
+
+    part->n_docs = 0;
+    part->n_words = 0;
+    part->expect_id = true;
+    while (p < end) {
+        const char *start = p;
+        p = next_line(p, end, &length);
+        /* Over budget, write what we have as a run before the next document */
+        if (index_line(part, start, length) && p < end && over_budget(part)) {
+            flush_run(part, p);
+        }
+    }
+}
 
+/* Thread entry point for index_range */
+static void* index_range_thread(void *arg) {
+    index_range((PartialIndex *)arg);
+    return NULL;
+}
+
+/* Grow the doc_id and freq arrays to hold at least n postings */
+static void reserve_postings(int **docs, int **freqs, int *capacity, int n) {
+    if (n <= *capacity) return;
+    int new_capacity = *capacity ? *capacity : 1024;
+    while (new_capacity < n) new_capacity *= 2;
+    *docs = (int *)realloc(*docs, new_capacity * sizeof(int));
+    *freqs = (int *)realloc(*freqs, new_capacity * sizeof(int));
+    *capacity = new_capacity;
+}
+
+/**
+ * Open the dictionary and posting list files for writing
+ * and write the index header
+ * 
+ * @param writer The writer to open
+ * @param codec The PostingCodec for the posting blocks
+ * @param stats The document lengths, for the score upper bounds of the blocks
+ * @return true on success, false otherwise
+ */
+bool index_writer_open(IndexWriter *writer, int codec, const DocStats *stats) {
+    memset(writer, 0, sizeof(IndexWriter));
+    writer->fp_post = fopen(POSTING_FILE NEW_SUFFIX, "wb");
+    writer->fp_dict = fopen(DICT_FILE NEW_SUFFIX, "wb");
+    if (writer->fp_post == NULL || writer->fp_dict == NULL) {
+        printf("Couldn't open file for index creation\n");
+        if (writer->fp_post) fclose(writer->fp_post);
+        if (writer->fp_dict) fclose(writer->fp_dict);
+        return false;
     }
 
-    _write_dict_postings(tree, node->right, fp_post, fp_dict, byte_offset);
+    /* The header entry tells the searcher which format follows */
+    IndexHeader header = { INDEX_VERSION_FRONT_CODED, POSTING_BLOCK_SIZE, codec, build_stamp };
+    writer->header = header;
+    writer->norm = stats->norm;
+    index_header_write(writer->fp_dict, &writer->header);
+    dict_writer_open(&writer->dict, writer->fp_dict, MAX_KEY_SIZE + OFFSET_SIZE);
+    return true;
+}
+
+/**
+ * Write one word and its postings. Words must come in sorted order.
+ * 
+ * @param writer The opened writer
+ * @param word The word
+ * @param length The length of the word
+ * @param docs The doc_ids, increasing
+ * @param freqs The frequencies
+ * @param n The number of postings
+ */
+void index_writer_add(IndexWriter *writer, const char *word, size_t length, const int *docs, const int *freqs, int n) {
+    /* The dictionary maps the word to the byte offset of its list */
+    dict_writer_add(&writer->dict, word, length, writer->byte_offset);
+
+    /* Encode into blocks and write the whole list at once.
+     * Total bytes written is tracked for offset of the next word */
+    writer->encoded.size = 0;
+    encode_posting_blocks(docs, freqs, n, &writer->header, writer->norm, &writer->encoded);
+    fwrite(writer->encoded.data, 1, writer->encoded.size, writer->fp_post);
+    writer->byte_offset += writer->encoded.size;
+}
+
+/**
+ * Close the files of a writer
+ * 
+ * @param writer The writer to close
+ */
+void index_writer_close(IndexWriter *writer) {
+    dict_writer_close(&writer->dict);
+    bytebuffer_free(&writer->encoded);
+    fclose(writer->fp_post);
+    fclose(writer->fp_dict);
 }
 
 /** 
- * Write the dictionary and posting list to files
+ * Write the dictionary and posting list to files.
+ * The sorted terms of the partial indexes are walked together,
+ * for each word the postings of all parts are joined (in document order)
+ * and encoded into blocks.
  * 
  * produces:    data/posting_list.bin
  *              data/dict_and_offset.bin
  * 
- * @param tree The tree to write to file
- * Each node in the tree is a word with a linked list of postings
+ * @param parts The partial indexes, in document order
+ * Each term is a word with a linked list of postings
+ * @param n_parts The number of partial indexes
+ * @param codec The PostingCodec for the posting blocks
+ * @param stats The document lengths of the collection
 */
-void write_dict_postings(RBTree *tree) {
-    FILE* fp_post = fopen(POSTING_FILE, "wb");
-    FILE* fp_dict = fopen(DICT_FILE, "wb");
-    if (fp_post == NULL || fp_dict == NULL) {
-        printf("Couldn't open file for index creation\n");
+void write_dict_postings(PartialIndex *parts, int n_parts, int codec, const DocStats *stats) {
+    IndexWriter writer;
+    if (!index_writer_open(&writer, codec, stats)) {
         return;
     }
-    int byte_offset = 0;
-    _write_dict_postings(tree, tree->root, fp_post, fp_dict, &byte_offset);
-    fclose(fp_post);
-    fclose(fp_dict);
+
+    /* Terms of every part sorted once, and the current (smallest unwritten) one */
+    VocabTerm ***sorted = (VocabTerm ***)malloc(n_parts * sizeof(VocabTerm **));
+    size_t *current = (size_t *)calloc(n_parts, sizeof(size_t));
+    for (int i = 0; i < n_parts; i++) {
+        sorted[i] = vocab_sorted(parts[i].vocab);
+    }
+
+    int *docs = NULL;
+    int *freqs = NULL;
+    int capacity = 0;
+    while (true) {
+        /* Smallest word over all parts */
+        VocabTerm *smallest = NULL;
+        for (int i = 0; i < n_parts; i++) {
+            if (current[i] < parts[i].vocab->size
+                    && (smallest == NULL || strcmp(sorted[i][current[i]]->key, smallest->key) < 0)) {
+                smallest = sorted[i][current[i]];
+            }
+        }
+        if (smallest == NULL) {
+            break;
+        }
+        const char *word = smallest->key;
+        size_t length = smallest->length;
+
+        /* Flatten the postings of every part holding the word */
+        int n = 0;
+        for (int i = 0; i < n_parts; i++) {
+            if (current[i] == parts[i].vocab->size || strcmp(sorted[i][current[i]]->key, word) != 0) {
+                continue;
+            }
+            LinkedList *list = (LinkedList *)sorted[i][current[i]]->value;
+            for (Node *node = list->head; node != NULL; node = node->next) {
+                Posting *posting = (Posting *)node->data;
+                reserve_postings(&docs, &freqs, &capacity, n + 1);
+                docs[n] = parts[i].doc_base + posting->doc_id;
+                freqs[n] = posting->freq;
+                n += 1;
+            }
+            current[i] += 1;
+        }
+
+        index_writer_add(&writer, word, length, docs, freqs, n);
+    }
+
+    for (int i = 0; i < n_parts; i++) {
+        free(sorted[i]);
+    }
+    free(sorted);
+    free(current);
+    free(docs);
+    free(freqs);
+    index_writer_close(&writer);
+}
+
+/* Remove the run files [first, end) */
+static void remove_runs(int first, int end) {
+    for (int i = first; i < end; i++) {
+        char path[64];
+        snprintf(path, sizeof(path), RUN_FILE, i);
+        remove(path);
+    }
+}
+
+/* Remove the index files written so far under NEW_SUFFIX */
+static void remove_new_files(void) {
+    const char *paths[] = { ID_FILE, DOC_IDS_FILE, DOC_STATS_FILE, POSTING_FILE, DICT_FILE };
+    for (size_t i = 0; i < sizeof(paths) / sizeof(paths[0]); i++) {
+        char temp[64];
+        snprintf(temp, sizeof(temp), "%s" NEW_SUFFIX, paths[i]);
+        remove(temp);
+    }
 }
 
 /**
- * Main function to parse the given file.
+ * Write the terms of a partial index as a sorted run and release its memory.
+ * A run is a sequence of records: the word length and the word,
+ * the number of postings, then (doc_id, freq) pairs, all native ints.
+ * The document IDs collected so far are appended to the ID file.
+ * 
+ * @param part The partial index, its vocabulary and ID list are emptied
+ * @param consumed The word stream up to here has been indexed
  */
-int main(int argc, char *argv[]) {
-    if (argc < 2) {
-        printf("Usage: %s <file>\n", argv[0]);
+static void flush_run(PartialIndex *part, const char *consumed) {
+    RunSet *runs = part->runs;
+    char path[64];
+    snprintf(path, sizeof(path), RUN_FILE, runs->n_runs);
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL) {
+        printf("Error: Couldn't open run file '%s'\n", path);
+        remove_runs(0, runs->n_runs);
+        remove_new_files();
+        exit(1);
+    }
+
+    VocabTerm **sorted = vocab_sorted(part->vocab);
+    for (size_t i = 0; i < part->vocab->size; i++) {
+        LinkedList *list = (LinkedList *)sorted[i]->value;
+        int n = 0;
+        for (Node *current = list->head; current != NULL; current = current->next) {
+            n += 1;
+        }
+        int length = sorted[i]->length;
+        fwrite(&length, sizeof(int), 1, fp);
+        fwrite(sorted[i]->key, sizeof(char), length, fp);
+        fwrite(&n, sizeof(int), 1, fp);
+        for (Node *current = list->head; current != NULL; current = current->next) {
+            Posting *posting = (Posting *)current->data;
+            int pair[2] = { part->doc_base + posting->doc_id, posting->freq };
+            fwrite(pair, sizeof(int), 2, fp);
+        }
+    }
+    free(sorted);
+    fclose(fp);
+    runs->n_runs += 1;
+
+    append_id_list(runs->id_file, &runs->id_store, part->id_list, &runs->first_id);
+    part_free(part);
+    part_alloc(part);
+
+    /* Drop the pages of the word stream already read, so they don't count
+     * towards the resident memory of the process */
+    if (runs->text == NULL) {
+        return;
+    }
+    long page = sysconf(_SC_PAGESIZE);
+    size_t length = (size_t)(consumed - runs->text) & ~(size_t)(page - 1);
+    if (length > 0) {
+        madvise((void *)runs->text, length, MADV_DONTNEED);
+    }
+}
+
+/* Reader of one run file */
+typedef struct RunReader {
+    FILE *fp;
+    bool done;
+    char *word; /* The current word, NUL terminated */
+    int word_capacity;
+    int n; /* Postings of the current word */
+    int capacity;
+    int *docs;
+    int *freqs;
+} RunReader;
+
+/* Read the next record of a run, sets done at the end */
+static void run_next(RunReader *run) {
+    int length;
+    if (fread(&length, sizeof(int), 1, run->fp) != 1 || length < 0) {
+        run->done = true;
+        return;
+    }
+    if (length + 1 > run->word_capacity) {
+        run->word_capacity = 2 * (length + 1);
+        run->word = (char *)realloc(run->word, run->word_capacity);
+    }
+    if (fread(run->word, sizeof(char), length, run->fp) != (size_t)length
+            || fread(&run->n, sizeof(int), 1, run->fp) != 1) {
+        run->done = true;
+        return;
+    }
+    run->word[length] = '\0';
+    reserve_postings(&run->docs, &run->freqs, &run->capacity, run->n);
+    for (int i = 0; i < run->n; i++) {
+        int pair[2];
+        if (fread(pair, sizeof(int), 2, run->fp) != 2) {
+            run->done = true;
+            return;
+        }
+        run->docs[i] = pair[0];
+        run->freqs[i] = pair[1];
+    }
+}
+
+/**
+ * Merge the runs [first, first + n) in one go, each word's postings joined
+ * in run (document) order, either into the index files or into a new run.
+ * The merged run files are removed.
+ * 
+ * @param first The first run
+ * @param n The number of runs, at most MERGE_FAN_IN
+ * @param writer The index files to add the words to, or NULL
+ * @param out The run file to write the words to, if writer is NULL
+ * @return true on success, false if a run couldn't be opened
+ */
+static bool merge_run_group(int first, int n, IndexWriter *writer, FILE *out) {
+    RunReader *runs = (RunReader *)calloc(n, sizeof(RunReader));
+    bool opened = true;
+    for (int i = 0; i < n && opened; i++) {
+        char path[64];
+        snprintf(path, sizeof(path), RUN_FILE, first + i);
+        runs[i].fp = fopen(path, "rb");
+        if (runs[i].fp == NULL) {
+            printf("Error: Couldn't open run file '%s'\n", path);
+            opened = false;
+            break;
+        }
+        setvbuf(runs[i].fp, NULL, _IOFBF, 1 << 16);
+        run_next(&runs[i]);
+    }
+
+    int *docs = NULL;
+    int *freqs = NULL;
+    int capacity = 0;
+    char *word = NULL;
+    size_t word_capacity = 0;
+    while (opened) {
+        /* Smallest word over all runs */
+        RunReader *smallest = NULL;
+        for (int i = 0; i < n; i++) {
+            if (!runs[i].done && (smallest == NULL || strcmp(runs[i].word, smallest->word) < 0)) {
+                smallest = &runs[i];
+            }
+        }
+        if (smallest == NULL) {
+            break;
+        }
+        /* The smallest run moves on, keep its word */
+        size_t length = strlen(smallest->word);
+        if (length + 1 > word_capacity) {
+            word_capacity = 2 * (length + 1);
+            word = (char *)realloc(word, word_capacity);
+        }
+        memcpy(word, smallest->word, length + 1);
+
+        int n_postings = 0;
+        for (int i = 0; i < n; i++) {
+            if (runs[i].done || strcmp(runs[i].word, word) != 0) {
+                continue;
+            }
+            reserve_postings(&docs, &freqs, &capacity, n_postings + runs[i].n);
+            memcpy(docs + n_postings, runs[i].docs, runs[i].n * sizeof(int));
+            memcpy(freqs + n_postings, runs[i].freqs, runs[i].n * sizeof(int));
+            n_postings += runs[i].n;
+            run_next(&runs[i]);
+        }
+
+        if (writer != NULL) {
+            index_writer_add(writer, word, length, docs, freqs, n_postings);
+            continue;
+        }
+        /* Same record layout as flush_run */
+        int word_length = (int)length;
+        fwrite(&word_length, sizeof(int), 1, out);
+        fwrite(word, sizeof(char), length, out);
+        fwrite(&n_postings, sizeof(int), 1, out);
+        for (int i = 0; i < n_postings; i++) {
+            int pair[2] = { docs[i], freqs[i] };
+            fwrite(pair, sizeof(int), 2, out);
+        }
+    }
+
+    for (int i = 0; i < n; i++) {
+        if (runs[i].fp) fclose(runs[i].fp);
+        free(runs[i].word);
+        free(runs[i].docs);
+        free(runs[i].freqs);
+    }
+    free(runs);
+    free(word);
+    free(docs);
+    free(freqs);
+    if (opened) {
+        remove_runs(first, first + n);
+    }
+    return opened;
+}
+
+/**
+ * Merge the sorted runs into the dictionary and posting list files.
+ * At most MERGE_FAN_IN runs are open at once: while there are more, each
+ * pass merges groups of consecutive runs into new runs numbered after the
+ * last, which keeps them in document order. The run files are removed
+ * afterwards. On an error the runs and the new index files are removed.
+ * 
+ * @param n_runs The number of runs
+ * @param codec The PostingCodec for the posting blocks
+ * @param stats The document lengths of the collection
+ * @return 0 on success, 1 on error
+ */
+int merge_runs(int n_runs, int codec, const DocStats *stats) {
+    int first = 0;
+    int end = n_runs;
+    while (end - first > MERGE_FAN_IN) {
+        int pass_end = end;
+        for (int group = first; group < pass_end; group += MERGE_FAN_IN) {
+            int n = pass_end - group < MERGE_FAN_IN ? pass_end - group : MERGE_FAN_IN;
+            char path[64];
+            snprintf(path, sizeof(path), RUN_FILE, end);
+            FILE *out = fopen(path, "wb");
+            if (out == NULL) {
+                printf("Error: Couldn't open run file '%s'\n", path);
+                remove_runs(group, end);
+                remove_new_files();
+                return 1;
+            }
+            bool merged = merge_run_group(group, n, NULL, out);
+            fclose(out);
+            end += 1;
+            if (!merged) {
+                remove_runs(group, end);
+                remove_new_files();
+                return 1;
+            }
+        }
+        first = pass_end;
+    }
+
+    IndexWriter writer;
+    if (!index_writer_open(&writer, codec, stats)) {
+        remove_runs(first, end);
+        remove_new_files();
         return 1;
     }
-    
-    printf("Opening file: '%s'\n", argv[1]);
+    bool merged = merge_run_group(first, end - first, &writer, NULL);
+    index_writer_close(&writer);
+    if (!merged) {
+        remove_runs(first, end);
+        remove_new_files();
+        return 1;
+    }
+    return 0;
+}
 
-    FILE* fp = fopen(argv[1], "rb"); /* File which contains the parsed data */
-    if (fp == NULL) {
-        printf("Error: Couldn't open file\n");
+/**
+ * Build the index files from a word stream within a memory budget.
+ * 
+ * @param text The word stream
+ * @param size The size of the word stream
+ * @param memory_budget Bytes the in-memory index may use before a flush
+ * @param codec The PostingCodec for the posting blocks
+ * @param timing Receives the time spent in each phase
+ * @return 0 on success, 1 on error
+ */
+int build_index_budgeted(const char *text, size_t size, size_t memory_budget, int codec, BuildTiming *timing) {
+    RunSet runs = { 0, fopen(ID_FILE NEW_SUFFIX, "wb"), {0}, true, text };
+    if (runs.id_file == NULL || !doc_id_writer_open(&runs.id_store, DOC_IDS_FILE NEW_SUFFIX)) {
+        printf("Error: Couldn't open file for writing\n");
+        if (runs.id_file) fclose(runs.id_file);
         return 1;
     }
 
-    LinkedList* id_list = linkedlist_create(NULL); /* list of document IDs */
-    RBTree* myTree = rb_create(); /* Dictionary tree with postings attached */
-    int progress_counter = 0; /* Counter to track progress */
-    char line[255]; /* Buffer to read lines from file */
+    PartialIndex part;
+    memset(&part, 0, sizeof(part));
+    part.start = text;
+    part.end = text + size;
+    part.memory_budget = memory_budget;
+    part_alloc(&part);
+    part.show_progress = true;
+    part.runs = &runs;
 
+    double start = time_now();
+    index_range(&part);
+    flush_run(&part, part.end);
+    fclose(runs.id_file);
+    doc_id_writer_close(&runs.id_store);
+    timing->index_seconds = time_now() - start;
 
-    /* first line is ID */
-    fgets(line, sizeof(line), fp);
-    line[strcspn(line, "\n")] = 0;
-    linkedlist_add_tail(id_list, strdup(line));
+    start = time_now();
+    DocStats stats;
+    save_doc_stats(&part, 1, &stats);
+    int status = merge_runs(runs.n_runs, codec, &stats);
+    doc_stats_free(&stats);
+    timing->write_seconds = time_now() - start;
 
-    int doc_index = 0; /*assigned to each document in the order they appear */
-    while (fgets(line, sizeof(line), fp)) {
-        if (strcmp(line, "\n") == 0) {
-            /* Read the next line as an ID */
-            fgets(line, sizeof(line), fp);
-            line[strcspn(line, "\n")] = 0;
-            linkedlist_add_tail(id_list, strdup(line));
-            doc_index += 1;
-            continue;
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    part_free(&part);
+    free(part.doc_lengths);
+    if (status != 0) {
+        return status;
+    }
+    printf("Indexed %ld words of %d documents through %d run(s), peak RSS %ld MB\n",
+           part.n_words, part.n_docs, runs.n_runs, usage.ru_maxrss / 1024);
+    arena_report(&part.totals, "Arena", stdout);
+    return 0;
+}
+
+/**
+ * Index a token from the tokenizer, an empty token ends a document.
+ * Over the budget, the postings so far are flushed as a run.
+ */
+static void index_token(void *context, const char *token, int length) {
+    PartialIndex *part = (PartialIndex *)context;
+    if (index_line(part, token, length) && over_budget(part)) {
+        flush_run(part, NULL);
+    }
+}
+
+/**
+ * Index the word stream of a chunk from the parallel tokenizer
+ */
+static void index_text(void *context, const char *text, size_t size) {
+    const char *p = text;
+    const char *end = text + size;
+    int length;
+    while (p < end) {
+        const char *start = p;
+        p = next_line(p, end, &length);
+        index_token(context, start, length);
+    }
+}
+
+/*
+ * Tokens passed from the tokenizer thread to the indexing thread,
+ * each a length byte followed by the token, length 0 between documents
+ */
+typedef struct TokenBatch {
+    size_t size;
+    bool last; /* No batches follow */
+    unsigned char data[TOKEN_BATCH_SIZE];
+} TokenBatch;
+
+/* Queues of the --pipeline build, batches go round from empty to full */
+typedef struct TokenPipeline {
+    SpscQueue full; /* Tokenizer to indexing thread */
+    SpscQueue empty; /* Indexing thread back to tokenizer */
+    TokenBatch *current; /* Batch being filled by the tokenizer */
+    PartialIndex *part;
+} TokenPipeline;
+
+/**
+ * Append a token to the current batch, passing the batch on when full
+ */
+static void batch_token(void *context, const char *token, int length) {
+    TokenPipeline *pipeline = (TokenPipeline *)context;
+    TokenBatch *batch = pipeline->current;
+    if (batch->size + 1 + length > TOKEN_BATCH_SIZE) {
+        spsc_queue_push_wait(&pipeline->full, batch);
+        batch = (TokenBatch *)spsc_queue_pop_wait(&pipeline->empty);
+        batch->size = 0;
+        pipeline->current = batch;
+    }
+    batch->data[batch->size] = (unsigned char)length; /* Tokens are shorter than MAX_TOKEN_SIZE */
+    memcpy(batch->data + batch->size + 1, token, length);
+    batch->size += 1 + length;
+}
+
+/* Indexing thread of the pipeline, indexes batches until the last one */
+static void* index_batches_thread(void *arg) {
+    TokenPipeline *pipeline = (TokenPipeline *)arg;
+    bool last = false;
+    while (!last) {
+        TokenBatch *batch = (TokenBatch *)spsc_queue_pop_wait(&pipeline->full);
+        for (size_t i = 0; i < batch->size; i += 1 + batch->data[i]) {
+            index_token(pipeline->part, (const char *)batch->data + i + 1, batch->data[i]);
         }
+        last = batch->last;
+        spsc_queue_push_wait(&pipeline->empty, batch);
+    }
+    return NULL;
+}
 
-        progress_counter += 1;
-
-        /*
-         * Check if the word is already in the tree 
-         * If not, create a new linked list for the word
-         * If it is, add a new posting to the linked list
-         */
-        line[strcspn(line, "\n")] = 0;
-        //printf("Word: %s\n", line);
-        RBTreeNode* btree_node = rb_search(myTree, line);
-        if (btree_node == myTree->nil) {
-            /* Word Not found, insert a new word with 1 new posting */
-            LinkedList* new_list = linkedlist_create(posting_cmp);
-            Posting* new_posting = (Posting *)malloc(sizeof(Posting));
-            new_posting->doc_id = doc_index;
-            new_posting->freq = 1;
-            linkedlist_add_tail(new_list, new_posting);
-
-            /* insert the word as key and the posting linked list as value */
-            rb_insert(myTree, line, new_list);
-        } else {
-            /*
-             * Btree node for the word Found, 
-             * Add a new posting for this docid
-             * if the docid is already present, increment the freq
-             */
-            LinkedList* posting_list = (LinkedList *)btree_node->value;
-            Posting* last_posting = (Posting *)posting_list->tail->data;
-            if (last_posting->doc_id == doc_index) {
-                last_posting->freq += 1;
-            } else {
-                Posting* new_posting = (Posting *)malloc(sizeof(Posting));
-                new_posting->doc_id = doc_index;
-                new_posting->freq = 1;
-                linkedlist_add_tail(posting_list, new_posting);
+/**
+ * Tokenize an XML file on this thread while another thread indexes the tokens
+ * 
+ * @param path The XML collection
+ * @param part The partial index to fill
+ * @return 0 on success, 1 on error
+ */
+static int tokenize_pipelined(const char *path, PartialIndex *part) {
+    TokenPipeline pipeline;
+    TokenBatch *batches = (TokenBatch *)malloc(TOKEN_BATCHES * sizeof(TokenBatch));
+    if (batches == NULL || !spsc_queue_init(&pipeline.full, TOKEN_BATCHES)
+            || !spsc_queue_init(&pipeline.empty, TOKEN_BATCHES)) {
+        printf("Error: Out of memory\n");
+        exit(1);
+    }
+    for (int i = 0; i < TOKEN_BATCHES; i++) {
+        batches[i].size = 0;
+        batches[i].last = false;
+    }
+    for (int i = 1; i < TOKEN_BATCHES; i++) {
+        spsc_queue_push(&pipeline.empty, &batches[i]);
+    }
+    pipeline.current = &batches[0];
+    pipeline.part = part;
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, index_batches_thread, &pipeline) != 0) {
+        printf("Error: Couldn't create thread\n");
+        exit(1);
+    }
+    int status = tokenize_file(path, batch_token, &pipeline);
+
+    /* Hand over what is left, marked as the end */
+    pipeline.current->last = true;
+    spsc_queue_push_wait(&pipeline.full, pipeline.current);
+    pthread_join(thread, NULL);
+
+    spsc_queue_free(&pipeline.full);
+    spsc_queue_free(&pipeline.empty);
+    free(batches);
+    return status;
+}
+
+/**
+ * Build the index files straight from the XML collection, tokenizing it
+ * in-process instead of reading the parser's word stream.
+ * 
+ * @param path The XML collection
+ * @param memory_budget Bytes the in-memory index may use before a flush, 0 for no budget
+ * @param n_threads Tokenizer threads, more than 1 to tokenize chunks in parallel
+ * @param pipelined Tokenize and index on separate threads (single tokenizer thread)
+ * @param codec The PostingCodec for the posting blocks
+ * @param timing Receives the time spent in each phase
+ * @return 0 on success, 1 on error
+ */
+int build_index_from_xml(const char *path, size_t memory_budget, int n_threads, bool pipelined, int codec, BuildTiming *timing) {
+    RunSet runs = { 0, NULL, {0}, true, NULL };
+    PartialIndex part;
+    memset(&part, 0, sizeof(part));
+    part.memory_budget = memory_budget;
+    part_alloc(&part);
+    part.show_progress = true;
+    part.expect_id = true;
+    if (memory_budget > 0) {
+        runs.id_file = fopen(ID_FILE NEW_SUFFIX, "wb");
+        if (runs.id_file == NULL || !doc_id_writer_open(&runs.id_store, DOC_IDS_FILE NEW_SUFFIX)) {
+            printf("Error: Couldn't open file for writing\n");
+            if (runs.id_file) fclose(runs.id_file);
+            part_free(&part);
+            return 1;
+        }
+        part.runs = &runs;
+    }
+
+    double start = time_now();
+    int status;
+    if (n_threads > 1) {
+        status = tokenize_file_parallel(path, n_threads, index_text, &part);
+    } else if (pipelined) {
+        status = tokenize_pipelined(path, &part);
+    } else {
+        status = tokenize_file(path, index_token, &part);
+    }
+    if (memory_budget > 0) {
+        flush_run(&part, NULL);
+        fclose(runs.id_file);
+        doc_id_writer_close(&runs.id_store);
+    }
+    timing->index_seconds = time_now() - start;
+    if (status != 0) {
+        remove_runs(0, runs.n_runs);
+        part_free(&part);
+        free(part.doc_lengths);
+        return status;
+    }
+
+    start = time_now();
+    DocStats stats;
+    save_doc_stats(&part, 1, &stats);
+    if (memory_budget > 0) {
+        status = merge_runs(runs.n_runs, codec, &stats);
+    } else {
+        save_id_list(&part, 1);
+        write_dict_postings(&part, 1, codec, &stats);
+    }
+    doc_stats_free(&stats);
+    timing->write_seconds = time_now() - start;
+
+    part_free(&part);
+    free(part.doc_lengths);
+    if (status != 0) {
+        return status;
+    }
+    printf("Indexed %ld words of %d documents from XML%s in %.3f s\n", part.n_words, part.n_docs,
+           n_threads > 1 ? " (parallel tokenizer)" : pipelined ? " (pipelined)" : "",
+           timing->index_seconds + timing->write_seconds);
+    arena_report(&part.totals, "Arena", stdout);
+    return 0;
+}
+
+/**
+ * Split the word stream into n ranges at document boundaries.
+ * Every range but the first starts right after a blank line.
+ * 
+ * @param text The word stream
+ * @param size The size of the word stream
+ * @param parts Receives the start and end of each range
+ * @param n The number of ranges
+ */
+void split_ranges(const char *text, size_t size, PartialIndex *parts, int n) {
+    const char *end = text + size;
+    const char *start = text;
+    for (int i = 0; i < n; i++) {
+        const char *split = end;
+        if (i < n - 1) {
+            /* Move forward from the even split point to the next blank line */
+            const char *p = text + size * (i + 1) / n;
+            if (p < start) p = start;
+            while (p < end) {
+                const char *newline = memchr(p, '\n', end - p);
+                if (newline == NULL || newline + 1 >= end) {
+                    p = end;
+                    break;
+                }
+                if (newline[1] == '\n') {
+                    p = newline + 2;
+                    break;
+                }
+                p = newline + 1;
             }
+            split = p;
         }
+        parts[i].start = start;
+        parts[i].end = split;
+        start = split;
+    }
+}
+
+/**
+ * Build the index files from a word stream
+ * 
+ * @param text The word stream
+ * @param size The size of the word stream
+ * @param n_threads The number of threads (and partial indexes)
+ * @param codec The PostingCodec for the posting blocks
+ * @param show_progress Print the word count every million words (single thread only)
+ * @param timing Receives the time spent in each phase
+ * @return 0 on success, 1 on error
+ */
+int build_index(const char *text, size_t size, int n_threads, int codec, bool show_progress, BuildTiming *timing) {
+    PartialIndex parts[MAX_THREADS];
+    pthread_t threads[MAX_THREADS];
+    memset(parts, 0, sizeof(parts));
+
+    double start = time_now();
+    split_ranges(text, size, parts, n_threads);
+    for (int i = 0; i < n_threads; i++) {
+        part_alloc(&parts[i]);
+        parts[i].show_progress = show_progress && n_threads == 1;
+    }
 
-        /* Print progress */
-        if (progress_counter % 1000000 == 0) {
-            printf("\rWords: %d\n", progress_counter);
-            fflush(stdout);
+    if (n_threads == 1) {
+        index_range(&parts[0]);
+    } else {
+        for (int i = 0; i < n_threads; i++) {
+            if (pthread_create(&threads[i], NULL, index_range_thread, &parts[i]) != 0) {
+                printf("Error: Couldn't create thread\n");
+                exit(1);
+            }
+        }
+        for (int i = 0; i < n_threads; i++) {
+            pthread_join(threads[i], NULL);
         }
     }
 
+    /* Number the documents of each part after those of the previous parts */
+    long n_words = 0;
+    for (int i = 1; i < n_threads; i++) {
+        parts[i].doc_base = parts[i - 1].doc_base + parts[i - 1].n_docs;
+    }
+    for (int i = 0; i < n_threads; i++) {
+        n_words += parts[i].n_words;
+    }
+    timing->index_seconds = time_now() - start;
+
     /* Save the list of document IDs to a file */
-    save_id_list(id_list);
+    start = time_now();
+    save_id_list(parts, n_threads);
+    DocStats stats;
+    save_doc_stats(parts, n_threads, &stats);
 
     /* write the dictionary and posting list to files */
-    write_dict_postings(myTree);
+    write_dict_postings(parts, n_threads, codec, &stats);
+    doc_stats_free(&stats);
+    timing->write_seconds = time_now() - start;
 
-    /* Clean up */
-    rb_destroy(myTree);
-    linkedlist_delete(id_list);
-    fclose(fp);
+    printf("Indexed %ld words of %d documents with %d thread(s)\n", n_words,
+           parts[n_threads - 1].doc_base + parts[n_threads - 1].n_docs, n_threads);
 
+    /* Clean up, each part's memory goes in one shot */
+    Arena totals = {0};
+    for (int i = 0; i < n_threads; i++) {
+        part_free(&parts[i]);
+        free(parts[i].doc_lengths);
+        totals.n_allocations += parts[i].totals.n_allocations;
+        totals.bytes_used += parts[i].totals.bytes_used;
+        totals.bytes_reserved += parts[i].totals.bytes_reserved;
+    }
+    if (show_progress) {
+        arena_report(&totals, "Arena", stdout);
+    }
     return 0;
 }
 
+/* A stamp unlike that of any other build, never 0 */
+static uint64_t new_build_stamp(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    uint64_t stamp = (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+    return (stamp ^ ((uint64_t)getpid() << 40)) | 1;
+}
+
+/**
+ * Move the new index files over the old ones. The postings, doc IDs and
+ * doc stats get a trailer with the build stamp the dictionary header
+ * holds, then each file is renamed into place, the dictionary last.
+ * A rename replaces one file at once, not the set: a searcher opening
+ * between two renames sees files of two builds, which their stamps tell
+ * apart (see index_stamps_match). On an error the new files are removed.
+ * 
+ * @return 0 on success, 1 on error
+ */
+int publish_index(void) {
+    const char *stamped[] = { DOC_IDS_FILE, DOC_STATS_FILE, POSTING_FILE };
+    for (size_t i = 0; i < sizeof(stamped) / sizeof(stamped[0]); i++) {
+        char temp[64];
+        snprintf(temp, sizeof(temp), "%s" NEW_SUFFIX, stamped[i]);
+        FILE *fp = fopen(temp, "ab");
+        if (fp == NULL) {
+            printf("Error: Couldn't open '%s'\n", temp);
+            remove_new_files();
+            return 1;
+        }
+        index_stamp_append(fp, build_stamp);
+        fclose(fp);
+    }
+
+    const char *paths[] = { ID_FILE, DOC_IDS_FILE, DOC_STATS_FILE, POSTING_FILE, DICT_FILE };
+    for (size_t i = 0; i < sizeof(paths) / sizeof(paths[0]); i++) {
+        char temp[64];
+        snprintf(temp, sizeof(temp), "%s" NEW_SUFFIX, paths[i]);
+        if (rename(temp, paths[i]) != 0) {
+            printf("Error: Couldn't move '%s' into place\n", temp);
+            remove_new_files();
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Publish the files of a successful build, remove those of a failed one */
+static int finish_build(int status) {
+    if (status != 0) {
+        remove_new_files();
+        return status;
+    }
+    return publish_index();
+}
+
+/**
+ * Main function to parse the given file.
+ */
+int main(int argc, char *argv[]) {
+    build_stamp = new_build_stamp();
+    int codec = CODEC_VBYTE;
+    int n_threads = 1;
+    bool scaling = false;
+    bool from_xml = false;
+    bool pipelined = false;
+    size_t memory_budget = 0;
+    int arg = 1;
+
+    /* Leading options */
+    while (arg < argc && argv[arg][0] == '-') {
+        if (arg + 1 < argc && strcmp(argv[arg], "--codec") == 0) {
+            codec = codec_from_name(argv[arg + 1]);
+            if (codec == -1) {
+                printf("Error: Unknown codec '%s' (vbyte, streamvbyte, pfor)\n", argv[arg + 1]);
+                return 1;
+            }
+            arg += 2;
+        } else if (arg + 1 < argc && strcmp(argv[arg], "-j") == 0) {
+            n_threads = atoi(argv[arg + 1]);
+            if (n_threads < 1 || n_threads > MAX_THREADS) {
+                printf("Error: -j takes 1 to %d threads\n", MAX_THREADS);
+                return 1;
+            }
+            arg += 2;
+        } else if (arg + 1 < argc && strcmp(argv[arg], "-m") == 0) {
+            long budget_mb = atol(argv[arg + 1]);
+            memory_budget = (size_t)(budget_mb > 0 ? budget_mb : 0) * 1024 * 1024;
+            if (memory_budget < ARENA_BLOCK_SIZE) {
+                printf("Error: -m takes the memory budget in MB, at least %d MB (one arena block)\n",
+                       ARENA_BLOCK_SIZE >> 20);
+                return 1;
+            }
+            arg += 2;
+        } else if (strcmp(argv[arg], "--scaling") == 0) {
+            scaling = true;
+            arg += 1;
+        } else if (strcmp(argv[arg], "--from-xml") == 0) {
+            from_xml = true;
+            arg += 1;
+        } else if (strcmp(argv[arg], "--pipeline") == 0) {
+            pipelined = true;
+            arg += 1;
+        } else {
+            break;
+        }
+    }
+
+    if (arg >= argc) {
+        printf("Usage: %s [--codec vbyte|streamvbyte|pfor] [-j threads | -m budget_mb] [--scaling] <file>\n", argv[0]);
+        printf("       %s [--codec vbyte|streamvbyte|pfor] [-j threads] [-m budget_mb] --from-xml [--pipeline] <xml_file>\n", argv[0]);
+        return 1;
+    }
+
+    if (from_xml) {
+        if (scaling) {
+            printf("Note: --from-xml ignores --scaling, see parser --scaling\n");
+        }
+        printf("Opening file: '%s'\n", argv[arg]);
+        BuildTiming timing;
+        int status = build_index_from_xml(argv[arg], memory_budget, n_threads, pipelined, codec, &timing);
+        return finish_build(status);
+    }
+    
+    printf("Opening file: '%s'\n", argv[arg]);
+
+    FILE* fp = fopen(argv[arg], "rb"); /* File which contains the parsed data */
+    struct stat sb;
+    if (fp == NULL || fstat(fileno(fp), &sb) == -1) {
+        printf("Error: Couldn't open file\n");
+        return 1;
+    }
+
+    /* Map the word stream, threads read their own ranges of it */
+    size_t size = sb.st_size;
+    const char *text = "";
+    if (size > 0) {
+        void *mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+        if (mapped == MAP_FAILED) {
+            printf("Error: Couldn't map file\n");
+            fclose(fp);
+            return 1;
+        }
+        madvise(mapped, size, MADV_SEQUENTIAL);
+        text = (const char *)mapped;
+    }
+
+    int status = 0;
+    BuildTiming timing;
+    if (scaling) {
+        /* Build with 1..N threads and report the time of each */
+        double base = 0;
+        printf("%8s %12s %12s %12s %10s\n", "threads", "index (s)", "write (s)", "total (s)", "speedup");
+        for (int j = 1; j <= n_threads && status == 0; j++) {
+            status = build_index(text, size, j, codec, false, &timing);
+            double total = timing.index_seconds + timing.write_seconds;
+            if (j == 1) base = total;
+            printf("%8d %12.3f %12.3f %12.3f %10.2f\n", j, timing.index_seconds, timing.write_seconds,
+                   total, total > 0 ? base / total : 0);
+        }
+    } else if (memory_budget > 0) {
+        if (n_threads > 1) {
+            printf("Note: -m builds with a single thread, ignoring -j\n");
+        }
+        status = build_index_budgeted(text, size, memory_budget, codec, &timing);
+    } else {
+        status = build_index(text, size, n_threads, codec, true, &timing);
+    }
+
+    if (size > 0) {
+        munmap((void *)text, size);
+    }
+    fclose(fp);
+
+    return finish_build(status);
+}
@@ -6,101 +6,115 @@
  * This program reads a file and outputs words from the file, one per line.
  * on the standard output.
  * Extra newlines are added between documents.
- * 
+ * The tokenizer lives in include/tokenizer.c, shared with indexer --from-xml.
+ *
+ * With -j N the file is mapped and split at <DOC> tags, N threads tokenize
+ * the pieces and the output is written in the original document order.
+ * --scaling tokenizes with 1..N threads and prints the MB/s of each.
+ *
  * @author Ubaada
  * @date 01-04-2024
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
-#include <ctype.h>
+#include <sys/stat.h>
 #include "include/common.h"
+#include "include/tokenizer.h"
+#include "include/timing.h"
+
+#define MAX_THREADS 256
+#define OUTPUT_BUFFER_SIZE (1 << 16)
 
-#define BUFFER_SIZE 4096
-char READ_BUFFER[BUFFER_SIZE];
+/* Lines collected before they are written out in one go */
+typedef struct OutputBuffer {
+    FILE *out;
+    size_t size;
+    char data[OUTPUT_BUFFER_SIZE];
+} OutputBuffer;
+
+/**
+ * Write out the buffered lines
+ */
+static void flush_output(OutputBuffer *buffer) {
+    fwrite(buffer->data, 1, buffer->size, buffer->out);
+    buffer->size = 0;
+}
 
+/**
+ * Buffer a token on its own line, an empty line between documents
+ */
+static void print_token(void *context, const char *token, int length) {
+    OutputBuffer *buffer = (OutputBuffer *)context;
+    if (buffer->size + length + 1 > OUTPUT_BUFFER_SIZE) {
+        flush_output(buffer);
+    }
+    memcpy(buffer->data + buffer->size, token, length);
+    buffer->data[buffer->size + length] = '\n';
+    buffer->size += length + 1;
+}
+
+/**
+ * Write the word stream of a chunk as it is
+ */
+static void print_text(void *context, const char *text, size_t size) {
+    fwrite(text, 1, size, (FILE *)context);
+}
+
+/**
+ * Count the bytes of the word stream without writing them
+ */
+static void count_text(void *context, const char *text, size_t size) {
+    (void)text;
+    *(size_t *)context += size;
+}
 
 /**
  * Parse the given document and output words to stdout.
- * 
- * Working: 
- * 1. Scan byte by byte to form a word until a non-alphanumeric char is found.
- * 2. Unless the char is between < and >, then it is a tag.
- * 3. If the tag is DOC, then the next word is a document ID.
- * 
- * 
+ *
  * @param doc_address The address of the document to parse.
+ * @param n_threads Tokenize with this many threads, 1 to read the file in one pass
 */
-int parse(char *doc_address) {
-    FILE *file = fopen(doc_address, "rb");
-    if (file == NULL) {
+int parse(char *doc_address, int n_threads) {
+    if (n_threads > 1) {
+        return tokenize_file_parallel(doc_address, n_threads, print_text, stdout);
+    }
+    static OutputBuffer buffer;
+    buffer.out = stdout;
+    int status = tokenize_file(doc_address, print_token, &buffer);
+    flush_output(&buffer);
+    return status;
+}
+
+/**
+ * Tokenize the file with 1..N threads, discarding the output,
+ * and print the throughput of each
+ *
+ * @param doc_address The address of the document to parse.
+ * @param max_threads The largest number of threads
+ */
+int parse_scaling(char *doc_address, int max_threads) {
+    struct stat sb;
+    if (stat(doc_address, &sb) == -1) {
         printf("Error: File not found\n");
         return 1;
     }
+    double mb = sb.st_size / (1024.0 * 1024.0);
 
-    char word[255];
-    int word_index = 0;
-    bool is_angle_start = false;
-    bool is_angle_end = false;
-    bool is_doc_id = false;
-    bool is_first_doc = true;
-    while (!feof(file)) {
-        int bytes_read = fread(READ_BUFFER, 1, BUFFER_SIZE, file);
-        for (int i = 0; i < bytes_read; i++) {
-            if (READ_BUFFER[i] == '<') {
-                is_angle_start = true;
-            } else if (READ_BUFFER[i] == '>' && is_angle_start) {
-                is_angle_end = true;
-            }
-            /**
-             * STOP string building If current char is not alphanumeric
-             * But allow '-' if it is a doc id
-             */
-            if ((isalnum(READ_BUFFER[i]) == 0) && !(is_doc_id && READ_BUFFER[i] == '-')) {
-                if (word_index == 0) {
-                    /* word is empty, skip */
-                    continue;
-                }
-                if (is_angle_start && is_angle_end) {
-                    /* tag between < and > */
-                    is_angle_start = false;
-                    is_angle_end = false;
-                    word[word_index] = '\0';
-                    if (strncmp(word, "DOC", word_index) == 0) {
-                        /* so it only triggers for opening tag
-                         * not both opening and closing tag
-                         */
-                        if (READ_BUFFER[i-4] == '<') {
-                            if (!is_first_doc) {
-                                printf("\n");
-                            } else {
-                                is_first_doc = false;
-                            }
-                            is_doc_id = true;
-                        }
-                    }
-                    word_index = 0;
-                } else {
-                    /* word */
-                    word[word_index] = '\0';
-                    /* if it is a doc id, don't stem */
-                    if (is_doc_id) {
-                        is_doc_id = false;
-                    } else {
-                        stem(word);
-                    }
-                    printf("%s\n", word);
-                    word_index = 0;
-                }
-            } else {
-                /* add char to word */
-                word[word_index++] = READ_BUFFER[i];
-            }
+    double base = 0;
+    printf("%8s %12s %12s %10s\n", "threads", "seconds", "MB/s", "speedup");
+    for (int j = 1; j <= max_threads; j++) {
+        size_t output = 0;
+        double start = time_now();
+        if (tokenize_file_parallel(doc_address, j, count_text, &output) != 0) {
+            return 1;
         }
+        double seconds = time_now() - start;
+        if (j == 1) base = seconds;
+        printf("%8d %12.3f %12.1f %10.2f\n", j, seconds, mb / seconds, seconds > 0 ? base / seconds : 0);
     }
-    fclose(file);
-
     return 0;
 }
 
@@ -108,13 +122,38 @@ int parse(char *doc_address) {
  * Main function to parse the given file.
  */
 int main(int argc, char *argv[]) {
-    if (argc < 2) {
-        printf("Usage: %s <file>\n", argv[0]);
+    int n_threads = 1;
+    bool scaling = false;
+    int arg = 1;
+
+    /* Leading options */
+    while (arg < argc && argv[arg][0] == '-') {
+        if (arg + 1 < argc && strcmp(argv[arg], "-j") == 0) {
+            n_threads = atoi(argv[arg + 1]);
+            if (n_threads < 1 || n_threads > MAX_THREADS) {
+                printf("Error: -j takes 1 to %d threads\n", MAX_THREADS);
+                return 1;
+            }
+            arg += 2;
+        } else if (strcmp(argv[arg], "--scaling") == 0) {
+            scaling = true;
+            arg += 1;
+        } else {
+            break;
+        }
+    }
+
+    if (arg >= argc) {
+        printf("Usage: %s [-j threads] [--scaling] <file>\n", argv[0]);
         return 1;
     }
 
-    /* read first argument as file name */
-    int p = parse(argv[1]);
+    if (scaling) {
+        return parse_scaling(argv[arg], n_threads);
+    }
+
+    /* read the argument as file name */
+    int p = parse(argv[arg], n_threads);
 
     return p;
-}
\ No newline at end of file
+}
@@ -5,8 +5,23 @@
  *
  * This program reads searches for the word in the dictionary.
  * It takes the offset from dictionary to locate and decompress the posting list.
- * Intersects the posting lists of all words to find the common documents.
- * Ranks the documents based on the frequency of the words and outputs the ordered list.
+ * Intersects the posting lists of all words to find the common documents,
+ * over arrays of doc_ids, freqs and scores reused by every query of a thread.
+ * Ranks the documents with BM25, using the document lengths saved by the indexer
+ * (--rank freq ranks by the summed frequency of the words), and outputs the ordered list.
+ * With -k N only the N best documents are kept, in a bounded heap, and only
+ * their document IDs are resolved.
+ * With --or documents containing any of the words are ranked, with -k N
+ * Block-Max WAND skips the documents that can't make it into the top N.
+ * With --batch a file of queries (TREC topics or one per line) is run on
+ * a pool of -j threads over the one opened index, and the results are
+ * written as a TREC run in query order.
+ * With --cache MB the posting lists of the words searched are kept decoded
+ * in a CLOCK cache, so hot words cost no I/O or decoding in later queries.
+ * With --result-cache MB the ranked results of whole queries are kept, keyed
+ * by the query normalised (stemmed and sorted), so a repeated query is
+ * answered without reading a posting list. In serve mode the
+ * index is reopened, and the caches emptied, when its files are rebuilt.
  * 
  * 
  * @author Ubaada
@@ -19,340 +34,1252 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <signal.h>
+#include <errno.h>
+#include <ctype.h>
+#include <pthread.h>
 
-#include "include/linked_list.h"
 #include "include/common.h"
+#include "include/timing.h"
+#include "include/index_reader.h"
+#include "include/postings.h"
+#include "include/topk.h"
+#include "include/wand.h"
+#include "include/work_pool.h"
+#include "include/posting_cache.h"
+#include "include/result_cache.h"
+#include "include/query_buffers.h"
+#include "include/intersect.h"
 
+#define MAX_QUERY_SIZE 4096 /* Longest query line accepted in serve mode */
+#define MAX_QUERY_WORDS 64 /* Most words taken from a single query line */
+#define MAX_CLIENTS 64 /* Concurrent socket connections in serve mode */
+#define TREC_RUN_TAG "searcher" /* Last column of the TREC run lines */
+#define TREC_DEPTH 1000 /* Results per topic in batch mode without -k */
+#define BATCH_CHUNK 4 /* Queries a batch worker takes at a time */
 
-#define ID_FILE "data/doc_id_list.txt"
-#define DICT_FILE "data/dict_and_offset.bin"
-#define POSTING_FILE "data/posting_list.bin"
 
+/*
+ * Options that apply to every query
+ */
+typedef struct SearchOptions {
+    int top_k; /* Print only the k best results, 0 for all */
+    RankingModel model;
+    bool disjunctive; /* Documents with any of the words (OR), not all */
+    PostingCache *cache; /* Decoded posting lists of hot words, NULL for none */
+    ResultCache *results; /* Ranked results of repeated queries, NULL for none */
+} SearchOptions;
+
+/*
+ * Where the results of a query are printed: "doc_id score" lines,
+ * or TREC run lines when the query has a topic number
+ */
+typedef struct ResultWriter {
+    FILE *out;
+    const char *topic; /* TREC topic number, NULL for plain lines */
+    int rank; /* Results printed so far */
+    ScoredDoc *recorded; /* Results printed, for the result cache, NULL if not recording */
+    int n_recorded;
+    int recorded_capacity;
+} ResultWriter;
 
 /*
- * To store the search results
+ * The posting list of one query word: its encoded bytes
+ * and a cursor that decodes them block by block
  */
-typedef struct SearchResult {
-    char doc_id[DOC_ID_SIZE + 1];
-    float score;
-} SearchResult;
+typedef struct WordPostings {
+    PostingBytes bytes;
+    PostingCursor cursor;
+    CachedPostings *cached; /* The cache entry the cursor reads, NULL if none */
+    float idf; /* BM25 weight of the word */
+} WordPostings;
 
+/**
+ * Score of a word occurring tf times in a document
+ * 
+ * @param word The posting list of the word
+ * @param tf The frequency of the word in the document
+ * @param doc The document index
+ * @param norm Length normalisation of every document, NULL to rank by frequency
+ * @return The score
+ */
+static inline float term_score(const WordPostings *word, int tf, int doc, const float *norm) {
+    return norm == NULL ? tf : bm25_score(word->idf, tf, norm[doc]);
+}
 
 
 /**
- * Decode a string of bytes encoded using variable byte encoding
- * into a list of integers and return it as a linked list of postings
- * id and frequency are read alternatively.
- * Also, undoes the delta and variable byte encoding.
+ * Print the next result of a query
  * 
- * @param data The encoded data
- * @param size The size of the data
- * @return A linked list of postings
+ * @param writer The writer of the query's results
+ * @param doc_id The document ID
+ * @param doc_index The document index
+ * @param score Its score
+ */
+static void write_result(ResultWriter *writer, const char *doc_id, int doc_index, float score) {
+    if (writer->recorded != NULL) {
+        if (writer->n_recorded == writer->recorded_capacity) {
+            writer->recorded_capacity *= 2;
+            writer->recorded = (ScoredDoc *)realloc(writer->recorded, writer->recorded_capacity * sizeof(ScoredDoc));
+        }
+        writer->recorded[writer->n_recorded].doc_id = doc_index;
+        writer->recorded[writer->n_recorded].score = score;
+        writer->n_recorded += 1;
+    }
+    writer->rank += 1;
+    if (writer->topic == NULL) {
+        fprintf(writer->out, "%s %f\n", doc_id, score);
+    } else {
+        fprintf(writer->out, "%s Q0 %s %d %f %s\n", writer->topic, doc_id, writer->rank, score, TREC_RUN_TAG);
+    }
+}
+
+/**
+ * Print the documents of a top-k best first, the top-k is freed
  * 
+ * @param topk The top-k
+ * @param index The opened index, to resolve the document IDs
+ * @param out The writer to print the results with
+ * @return The number of results printed
  */
-LinkedList* decode_posting_list(unsigned char *data, int size) {
-    LinkedList* list = linkedlist_create(NULL);
-    list->head = NULL;
-    list->tail = NULL;
-
-    int res = 0;
-    int is_id = 1; /* First number is ID then freq alternatively */
-    int prev_id = 0; /* For delta encoding */
-    Posting *posting = NULL;
-    for (int i = 0; i < size; i++) {
-        if (!(data[i] & 128)) {
-            /* keep adding offset byte and current byte
-             * leading bit is 0 it will remove itself when added
-             */
-            res = (res | (int)data[i]) << 7;
-        } else {
-            /* Final byte of a number
-             * Unset leading 1 and add
-             */
-            res = (res | (data[i] ^ 128));
-            if (is_id) {
-                posting = (Posting *)malloc(sizeof(Posting));
-                prev_id += res;
-                posting->doc_id = prev_id;
-                is_id = 0;
-            } else {
-                posting->freq = res;
-                linkedlist_add_tail(list, posting);
-                is_id = 1;
+static int print_ranked(TopK *topk, IndexReader *index, ResultWriter *out) {
+    int n = topk_sort(topk);
+    for (int i = 0; i < n; i++) {
+        write_result(out, index_doc_id(index, topk->heap[i].doc_id), topk->heap[i].doc_id, topk->heap[i].score);
+    }
+    topk_free(topk);
+    return n;
+}
+
+/**
+ * Print the k best of the scored documents, best first.
+ * Scores go through a bounded heap in one pass and only the
+ * document IDs of the k printed results are resolved.
+ * Ties keep document order, as with the full sort.
+ * 
+ * @param docs The doc_ids of the scored documents
+ * @param scores Their scores
+ * @param n_results The number of scored documents
+ * @param k The number of results to print
+ * @param index The opened index, to resolve the document IDs
+ * @param out The writer to print the results with
+ * @return The number of results printed
+ */
+int print_top_k(const uint32_t *docs, const float *scores, int n_results, int k, IndexReader *index, ResultWriter *out) {
+    TopK topk;
+    if (!topk_init(&topk, k)) {
+        printf("Error: Out of memory\n");
+        return 0;
+    }
+    for (int i = 0; i < n_results; i++) {
+        topk_push(&topk, docs[i], scores[i]);
+    }
+    return print_ranked(&topk, index, out);
+}
+
+/* Order scored documents best first, equal scores in document order */
+static int cmp_ranked(const void *a, const void *b) {
+    const ScoredDoc *doc_a = (const ScoredDoc *)a;
+    const ScoredDoc *doc_b = (const ScoredDoc *)b;
+    if (doc_a->score != doc_b->score) {
+        return doc_a->score < doc_b->score ? 1 : -1;
+    }
+    return (doc_a->doc_id > doc_b->doc_id) - (doc_a->doc_id < doc_b->doc_id);
+}
+
+/**
+ * Print every scored document, best first. They are sorted in the
+ * ranked array of the query buffers, ties keep document order.
+ * 
+ * @param buffers The query buffers, the documents at the front of docs and scores
+ * @param n_results The number of scored documents
+ * @param index The opened index, to resolve the document IDs
+ * @param out The writer to print the results with
+ * @return The number of results printed
+ */
+static int print_all_ranked(QueryBuffers *buffers, int n_results, IndexReader *index, ResultWriter *out) {
+    ScoredDoc *ranked = buffers->ranked;
+    for (int i = 0; i < n_results; i++) {
+        ranked[i].doc_id = buffers->docs[i];
+        ranked[i].score = buffers->scores[i];
+    }
+    qsort(ranked, n_results, sizeof(ScoredDoc), cmp_ranked);
+    for (int i = 0; i < n_results; i++) {
+        write_result(out, index_doc_id(index, ranked[i].doc_id), ranked[i].doc_id, ranked[i].score);
+    }
+    return n_results;
+}
+
+/* Order posting lists by document frequency, rarest first */
+static int cmp_list_size(const void *a, const void *b) {
+    const WordPostings *list_a = *(WordPostings * const *)a;
+    const WordPostings *list_b = *(WordPostings * const *)b;
+    return list_a->cursor.n_postings - list_b->cursor.n_postings;
+}
+
+/**
+ * Intersect the posting lists of all words to find the common documents.
+ * The lists are ordered by document frequency and the rarest list is
+ * decoded into the candidate arrays of the query buffers. Each longer
+ * list in turn filters the candidates in place: the skip table finds the
+ * block holding the next candidate, blocks without one are never decoded,
+ * and the candidates up to the block's last doc_id are intersected with
+ * the block by the kernel suited to their lengths (see intersect.h).
+ * A list from the posting cache is already decoded, so the remaining
+ * candidates are intersected with the rest of it at once, and a very
+ * skewed pair gallops. The survivors add the list's score.
+ * 
+ * @param word_lists The posting lists of all words, reordered by size
+ * @param n_lists The number of posting lists
+ * @param norm Length normalisation of every document, NULL to rank by frequency
+ * @param buffers The query buffers of the thread
+ * @return The number of documents in the intersection, their doc_ids and
+ *         scores in document order at the front of buffers->docs and buffers->scores
+ */
+int intersect_posting_lists(WordPostings **word_lists, int n_lists, const float *norm, QueryBuffers *buffers) {
+    if (n_lists == 0) return 0; /* Early return if no posting lists */
+
+    qsort(word_lists, n_lists, sizeof(WordPostings *), cmp_list_size);
+    if (!query_buffers_reserve(buffers, word_lists[0]->cursor.n_postings)) {
+        printf("Error: Out of memory\n");
+        return 0;
+    }
+    uint32_t *docs = buffers->docs;
+    float *scores = buffers->scores;
+    int n_candidates = posting_cursor_decode_into(&word_lists[0]->cursor, docs, buffers->freqs);
+    for (int r = 0; r < n_candidates; r++) {
+        scores[r] = term_score(word_lists[0], buffers->freqs[r], docs[r], norm);
+    }
+
+    for (int i = 1; i < n_lists && n_candidates > 0; i++) {
+        PostingCursor *cursor = &word_lists[i]->cursor;
+        int n_kept = 0;
+        int b = 0;
+        int r = 0;
+        while (r < n_candidates) {
+            b = gallop_search(cursor->block_last_doc, cursor->n_blocks, b, (int)docs[r]);
+            if (b == cursor->n_blocks) {
+                break; /* The list is exhausted, no later candidate can match */
+            }
+            const uint32_t *block_docs, *block_freqs;
+            int n_block = posting_cursor_load_rest(cursor, b, &block_docs, &block_freqs);
+            int r_end = n_candidates;
+            if (n_block == -1) {
+                /* Candidates [r, r_end) fall in block b */
+                r_end = gallop_search((const int *)docs, n_candidates, r, cursor->block_last_doc[b] + 1);
+                n_block = posting_cursor_load_block(cursor, b, &block_docs, &block_freqs);
             }
-            res = 0;
+            int n_matches = intersect_adaptive(docs + r, r_end - r, block_docs, n_block,
+                                               buffers->match_a, buffers->match_b);
+            for (int m = 0; m < n_matches; m++) {
+                int c = r + buffers->match_a[m];
+                docs[n_kept] = docs[c];
+                scores[n_kept] = scores[c] + term_score(word_lists[i], block_freqs[buffers->match_b[m]], docs[c], norm);
+                n_kept += 1;
+            }
+            r = r_end;
+            b += 1;
         }
+        n_candidates = n_kept;
     }
-
-    return list;
+    return n_candidates;
 }
 
+/**
+ * Get the posting list for a word from the cache, or from the dictionary
+ * and posting list files
+ * 
+ * @param search_word The stemmed word to search for
+ * @param index The opened index
+ * @param cache The posting cache, NULL for none
+ * @return The posting list with an open cursor, NULL if the word was not found
+ */
+WordPostings* get_posting_list(const char* search_word, IndexReader* index, PostingCache *cache) {
+    /* A hot word is served decoded from the cache */
+    WordPostings *word_plist = (WordPostings *)calloc(1, sizeof(WordPostings));
+    if (cache != NULL && (word_plist->cached = posting_cache_get(cache, search_word)) != NULL) {
+        posting_cursor_open_decoded(&word_plist->cursor, &word_plist->cached->list);
+        return word_plist;
+    }
+
+    /* Binary search the word in the dictionary */
+    int64_t posting_begin_offset, posting_end_offset;
+    if (!index_lookup(index, search_word, &posting_begin_offset, &posting_end_offset)) {
+        /* Word not found */
+        free(word_plist);
+        return NULL;
+    }
+
+    /* Read (or point into) the posting list bytes [begin, end) */
+    if (!index_read_postings(index, posting_begin_offset, posting_end_offset, &word_plist->bytes)) {
+        free(word_plist);
+        return NULL;
+    }
+
+    /* Blocks are decoded lazily by the cursor */
+    if (!posting_cursor_open(&word_plist->cursor, word_plist->bytes.data, word_plist->bytes.size, &index->header)) {
+        printf("Error: Corrupt posting list for '%s'\n", search_word);
+        index_release_postings(&word_plist->bytes);
+        free(word_plist);
+        return NULL;
+    }
+
+    if (cache != NULL) {
+        /* Decode the whole list into the cache, the bytes aren't needed after */
+        DecodedPostings list;
+        decoded_postings_init(&list, &word_plist->cursor);
+        posting_cursor_close(&word_plist->cursor);
+        index_release_postings(&word_plist->bytes);
+        word_plist->cached = posting_cache_put(cache, search_word, &list);
+        posting_cursor_open_decoded(&word_plist->cursor, &word_plist->cached->list);
+    }
+    return word_plist;
+}
 
 /**
- * Calculate the rank of the search results based on the frequency of the words
+ * Free a word's posting list and close its cursor
  * 
- * @param ranked_results The list of ranked results to be populated
- * @param results The list of search results
- * @param id_file The file containing the document IDs
+ * @param word_plist The posting list, may be NULL
+ */
+void free_word_postings(WordPostings *word_plist) {
+    if (word_plist == NULL) return;
+    posting_cursor_close(&word_plist->cursor);
+    index_release_postings(&word_plist->bytes);
+    if (word_plist->cached != NULL) {
+        posting_cache_release(word_plist->cached);
+    }
+    free(word_plist);
+}
+
+/**
+ * Find the documents containing any of the words and print them ranked
+ * by BM25. With a top-k, Block-Max WAND skips documents that can't make
+ * it, otherwise every document is scored.
  * 
-*/
-void calculate_rank(LinkedList* ranked_results, LinkedList* results, FILE* id_file) {
-    Node *current = results->head;
-    while (current != NULL) {
-        Posting *posting = (Posting *)current->data;
-
-        /* Get the DOC_ID from the index number */
-        SearchResult *result = (SearchResult *)malloc(sizeof(SearchResult));
-        fseek(id_file, posting->doc_id * (DOC_ID_SIZE + 1), SEEK_SET); 
-        fread(result->doc_id, DOC_ID_SIZE, 1, id_file);
-        result->doc_id[DOC_ID_SIZE] = '\0';
-        /* Simple ranking based on the frequency of the word */
-        result->score = posting->freq;
-        
-        /* Insert the result in the ranked list */
-        linkedlist_add_tail(ranked_results, result);
-
-        current = current->next;
+ * @param index The opened index
+ * @param word_lists The posting lists of the words found
+ * @param n_lists The number of posting lists
+ * @param options The search options
+ * @param out The writer to print the results with
+ * @return The number of results printed
+ */
+int run_or_query(IndexReader *index, WordPostings **word_lists, int n_lists, const SearchOptions *options, ResultWriter *out) {
+    QueryTerm terms[MAX_QUERY_WORDS];
+    long n_postings = 0;
+    if (n_lists > MAX_QUERY_WORDS) n_lists = MAX_QUERY_WORDS;
+    for (int i = 0; i < n_lists; i++) {
+        terms[i].cursor = &word_lists[i]->cursor;
+        terms[i].idf = word_lists[i]->idf;
+        n_postings += word_lists[i]->cursor.n_postings;
+    }
+    if (n_postings == 0) {
+        return 0;
     }
+
+    /* Without -k every document of the union is kept */
+    int k = options->top_k > 0 ? options->top_k : (int)n_postings;
+    TopK topk;
+    if (!topk_init(&topk, k)) {
+        printf("Error: Out of memory\n");
+        return 0;
+    }
+    WandStats stats = { 0, 0 };
+    if (options->top_k > 0) {
+        or_query_wand(terms, n_lists, index->stats.norm, &topk, &stats);
+    } else {
+        or_query_exhaustive(terms, n_lists, index->stats.norm, &topk, &stats);
+    }
+    return print_ranked(&topk, index, out);
 }
 
 /**
- * Copy a posting list
+ * Find the documents containing all (or with --or any) of the words
+ * and print them ranked
  * 
- * @param original The original posting list
- * @return A copy of the posting list
+ * @param index The opened index
+ * @param words The stemmed words to search for, sorted
+ * @param n_words The number of words
+ * @param options The search options
+ * @param out The writer to print the results with
+ * @param buffers The query buffers of the thread
+ * @return The number of results printed
  */
-LinkedList* copy_posting_list(LinkedList *original) {
-    LinkedList *copy = linkedlist_create(NULL); /* Assume this initializes an empty list */
-    Node *current = original->head;
-    while (current != NULL) {
-        Posting *originalPosting = (Posting *)current->data;
-        /* Allocate memory for a new Posting and copy the values */
-        Posting *newPosting = malloc(sizeof(Posting));
-        if (newPosting == NULL) {
-            exit(1);
+static int evaluate_query(IndexReader *index, char **words, int n_words, const SearchOptions *options, ResultWriter *out,
+                          QueryBuffers *buffers) {
+    /* Posting lists of all words */
+    WordPostings **word_lists = (WordPostings **)calloc(n_words, sizeof(WordPostings *));
+    int n_results = 0;
+
+    /* Search for each word in the dictionary */
+    int n_lists = 0;
+    for (int i = 0; i < n_words; i++) {
+        WordPostings *word_plist = get_posting_list(words[i], index, options->cache);
+        if (word_plist == NULL && options->disjunctive) {
+            continue; /* The other words can still match */
+        }
+        if (word_plist == NULL) {
+            /* If any one of the words is not found, there are no results */
+            for (int j = 0; j < n_lists; j++) {
+                free_word_postings(word_lists[j]);
+            }
+            free(word_lists);
+            return 0;
+        }
+        word_lists[n_lists++] = word_plist;
+    }
+
+    /* BM25 weights the words by how rare they are */
+    const float *norm = NULL;
+    if (options->model == RANK_BM25) {
+        norm = index->stats.norm;
+        for (int i = 0; i < n_lists; i++) {
+            word_lists[i]->idf = bm25_idf(index->stats.n_docs, word_lists[i]->cursor.n_postings);
+        }
+    }
+
+    if (options->disjunctive) {
+        n_results = run_or_query(index, word_lists, n_lists, options, out);
+        for (int i = 0; i < n_lists; i++) {
+            free_word_postings(word_lists[i]);
         }
-        *newPosting = *originalPosting; /* Shallow copy is enough since fields are not pointers */
+        free(word_lists);
+        return n_results;
+    }
 
-        linkedlist_add_tail(copy, newPosting); /* Add the new posting to the copied list */
-        current = current->next;
+    /* Intersect the posting lists of all words (AND search) */
+    int n_scored = intersect_posting_lists(word_lists, n_lists, norm, buffers);
+
+    if (options->top_k > 0) {
+        n_results = print_top_k(buffers->docs, buffers->scores, n_scored, options->top_k, index, out);
+    } else {
+        n_results = print_all_ranked(buffers, n_scored, index, out);
     }
-    return copy;
+
+    /* Clean up */
+    for (int i = 0; i < n_lists; i++) {
+        free_word_postings(word_lists[i]);
+    }
+    free(word_lists);
+
+    return n_results;
+}
+
+/* Order words alphabetically */
+static int cmp_words(const void *a, const void *b) {
+    return strcmp(*(char * const *)a, *(char * const *)b);
 }
 
 /**
- * Intersect the posting lists of all words to find the common documents
+ * Key of a query in the result cache: the options that change its results,
+ * then its sorted words. A repeated word adds to the score, so it is kept.
  * 
- * @param all_word_plist The list of all words' posting lists
- * @param resultList The resulting posting list
+ * @param words The stemmed words, sorted
+ * @param n_words The number of words
+ * @param options The search options
+ * @return The key, malloc'd
  */
-void intersect_posting_lists(LinkedList *all_word_plist, LinkedList **resultList) {
-    if (all_word_plist->head == NULL) return; /* Early return if no posting lists */
-
-    /* Initialize the intersection result with the first posting list */
-    LinkedList *results = copy_posting_list((LinkedList *)all_word_plist->head->data);
-
-    Node *i = all_word_plist->head->next; /* Start from the second posting list */
-    while (i != NULL) {
-        LinkedList *currentList = (LinkedList *)i->data;
-        LinkedList *newResults = linkedlist_create(NULL);
-
-        /* Iterate over the results to see if each doc_id is in the current list */
-        Node *resultNode = results->head;
-        while (resultNode != NULL) {
-            Posting *resultPosting = (Posting *)resultNode->data;
-            int isInCurrentList = 0; /* Flag to check existence in the current list */
-
-            Node *currentNode = currentList->head;
-            while (currentNode != NULL) {
-                Posting *currentPosting = (Posting *)currentNode->data;
-                if (currentPosting->doc_id == resultPosting->doc_id) {
-                    isInCurrentList = 1;
-                    resultPosting->freq += currentPosting->freq; /* Sum frequencies */
-                    break;
-                }
-                currentNode = currentNode->next;
-            }
+static char* result_cache_key(char **words, int n_words, const SearchOptions *options) {
+    size_t size = 64;
+    for (int i = 0; i < n_words; i++) {
+        size += strlen(words[i]) + 1;
+    }
+    char *key = (char *)malloc(size);
+    size_t used = snprintf(key, size, "%s %s %d:", options->disjunctive ? "or" : "and",
+                           options->model == RANK_BM25 ? "bm25" : "freq", options->top_k);
+    for (int i = 0; i < n_words; i++) {
+        used += snprintf(key + used, size - used, " %s", words[i]);
+    }
+    return key;
+}
 
-            if (isInCurrentList) {
-                /* If the doc_id is in both lists, add it to the new results */
-                Posting *newPosting = malloc(sizeof(Posting));
-                newPosting->doc_id = resultPosting->doc_id;
-                newPosting->freq = resultPosting->freq;
-                linkedlist_add_tail(newResults, newPosting);
-            }
+/**
+ * Print the results of a query from the result cache, or evaluate the
+ * query and keep the results it printed. A hit reads no posting list
+ * and scores nothing, the document IDs are resolved as they are printed.
+ * 
+ * @param index The opened index
+ * @param words The stemmed words to search for, sorted
+ * @param n_words The number of words
+ * @param options The search options, with a result cache
+ * @param out The writer to print the results with
+ * @param buffers The query buffers of the thread
+ * @return The number of results printed
+ */
+static int run_cached_query(IndexReader *index, char **words, int n_words, const SearchOptions *options, ResultWriter *out,
+                            QueryBuffers *buffers) {
+    char *key = result_cache_key(words, n_words, options);
 
-            resultNode = resultNode->next;
+    ScoredDoc *results;
+    int n_results = result_cache_get(options->results, key, index->generation, &results);
+    if (n_results >= 0) {
+        for (int i = 0; i < n_results; i++) {
+            write_result(out, index_doc_id(index, results[i].doc_id), results[i].doc_id, results[i].score);
         }
+        free(results);
+        free(key);
+        return n_results;
+    }
 
-        /* Replace the old results with the newResults */
-        linkedlist_delete(results);
-        results = newResults;
+    out->recorded_capacity = 16;
+    out->recorded = (ScoredDoc *)malloc(out->recorded_capacity * sizeof(ScoredDoc));
+    out->n_recorded = 0;
+    n_results = evaluate_query(index, words, n_words, options, out, buffers);
+    result_cache_put(options->results, key, index->generation, out->recorded, out->n_recorded);
+    free(out->recorded);
+    out->recorded = NULL;
+    free(key);
+    return n_results;
+}
 
-        i = i->next;
+/**
+ * Find the documents containing all the words and print them ranked.
+ * The words are stemmed and sorted in place: neither AND nor OR depend on
+ * their order, and sorted words add up the scores in the same order
+ * whichever way the query was written, with or without the result cache.
+ * 
+ * @param index The opened index
+ * @param words The words to search for
+ * @param n_words The number of words
+ * @param options The search options
+ * @param out The writer to print the results with
+ * @param buffers The query buffers of the calling thread
+ * @return The number of results printed
+ */
+int run_query(IndexReader *index, char **words, int n_words, const SearchOptions *options, ResultWriter *out,
+              QueryBuffers *buffers) {
+    for (int i = 0; i < n_words; i++) {
+        stem(words[i]);
     }
+    qsort(words, n_words, sizeof(char *), cmp_words);
+    if (options->results != NULL) {
+        return run_cached_query(index, words, n_words, options, out, buffers);
+    }
+    return evaluate_query(index, words, n_words, options, out, buffers);
+}
 
-    /* Set the resultList to the final intersection of all posting lists */
-    *resultList = results;
+/*
+ * A connection in serve mode, stdin or a socket client.
+ * Bytes are buffered until a full line (query) has arrived.
+ */
+typedef struct Connection {
+    int fd;
+    FILE *out; /* Where the answers go */
+    char buffer[MAX_QUERY_SIZE];
+    int used;
+} Connection;
+
+/* Set by the signal handler to leave the serve loop */
+static volatile sig_atomic_t stop_serving = 0;
+
+static void handle_stop_signal(int sig) {
+    (void)sig;
+    stop_serving = 1;
 }
 
 /**
- * Compare function for sorting search results
+ * Answer one query line. The answer is the ranked result lines
+ * followed by an empty line so clients know where it ends.
  * 
- * @param a The first search result
- * @param b The second search result
- * @return 1 if a > b, -1 if a < b, 0 if a == b
- 
-*/
-int cmp_search_results(const void *a, const void *b) {
-    SearchResult *resultA = (SearchResult *)a;
-    SearchResult *resultB = (SearchResult *)b;
-
-    if (resultA->score < resultB->score) {
-        return 1;
-    } else if (resultA->score > resultB->score) {
+ * @param index The opened index
+ * @param line The query line, split into words in place
+ * @param options The search options
+ * @param out The stream to answer on
+ * @param stats Latency of the query is recorded here
+ * @param buffers The query buffers of the server
+ */
+void serve_query(IndexReader *index, char *line, const SearchOptions *options, FILE *out, LatencyStats *stats,
+                 QueryBuffers *buffers) {
+    char *words[MAX_QUERY_WORDS];
+    int n_words = 0;
+    char *saveptr = NULL;
+    char *word = strtok_r(line, " \t\r", &saveptr);
+    while (word != NULL && n_words < MAX_QUERY_WORDS) {
+        words[n_words++] = word;
+        word = strtok_r(NULL, " \t\r", &saveptr);
+    }
+    if (n_words == 0) {
+        return;
+    }
+
+    double start = time_now();
+    ResultWriter writer = { out, NULL, 0, NULL, 0, 0 };
+    run_query(index, words, n_words, options, &writer, buffers);
+    latency_stats_add(stats, time_now() - start);
+
+    fprintf(out, "\n");
+    fflush(out);
+}
+
+/**
+ * Read what is available on a connection and answer every complete line.
+ * 
+ * @param index The opened index
+ * @param conn The connection to read from
+ * @param options The search options
+ * @param stats Latency of the queries is recorded here
+ * @param buffers The query buffers of the server
+ * @return false once the connection is closed, true otherwise
+ */
+bool serve_connection(IndexReader *index, Connection *conn, const SearchOptions *options, LatencyStats *stats,
+                      QueryBuffers *buffers) {
+    ssize_t n = read(conn->fd, conn->buffer + conn->used, sizeof(conn->buffer) - conn->used - 1);
+    if (n < 0 && errno == EINTR) {
+        return true;
+    }
+    if (n <= 0) {
+        /* Answer a last query that was not newline terminated */
+        if (conn->used > 0) {
+            conn->buffer[conn->used] = '\0';
+            serve_query(index, conn->buffer, options, conn->out, stats, buffers);
+        }
+        return false;
+    }
+    conn->used += n;
+
+    /* Answer every complete line */
+    char *start = conn->buffer;
+    char *end;
+    while ((end = memchr(start, '\n', conn->used - (start - conn->buffer))) != NULL) {
+        *end = '\0';
+        serve_query(index, start, options, conn->out, stats, buffers);
+        start = end + 1;
+    }
+    conn->used -= start - conn->buffer;
+    memmove(conn->buffer, start, conn->used);
+
+    /* Line too long to ever fit, answer what we have */
+    if (conn->used == (int)sizeof(conn->buffer) - 1) {
+        conn->buffer[conn->used] = '\0';
+        serve_query(index, conn->buffer, options, conn->out, stats, buffers);
+        conn->used = 0;
+    }
+    return true;
+}
+
+/**
+ * Create a Unix socket listening on the given path
+ * 
+ * @param path The file system path of the socket
+ * @return The listening socket, -1 on error
+ */
+int listen_unix_socket(const char *path) {
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        printf("Error: Socket path too long\n");
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1) {
+        printf("Error: Couldn't create socket\n");
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    unlink(path); /* Remove a stale socket from a previous run */
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 || listen(fd, MAX_CLIENTS) == -1) {
+        printf("Error: Couldn't listen on socket '%s'\n", path);
+        close(fd);
         return -1;
-    } else {
-        return 0;
     }
+    return fd;
 }
 
 /**
- * Get the posting list for a word from the dictionary and posting list files
+ * Reopen the index if its files have changed since it was opened.
+ * The posting cache is emptied, the result cache empties itself on its
+ * next lookup as the generation has changed. The indexer renames complete
+ * files into place one at a time, and a rebuild writing in place leaves a
+ * dictionary without its header or footer, which would open as an empty
+ * legacy index. So the new index is only taken if its dictionary is
+ * versioned and whole, the other files carry its build stamp (no mix of
+ * two builds), and nothing changed again while opening. Otherwise the old
+ * index is kept and the next wake up tries again.
  * 
- * @param search_word The word to search for
- * @param dict_file The dictionary file
- * @param posting_file The posting list file
- * @param dict_size The size of the dictionary
- * @param all_word_plist The list of all words' posting lists
- * @return true if the word was found, false otherwise
+ * @param index The opened index, replaced by the new one
+ * @param options The search options
  */
-bool get_posting_list(char* search_word, FILE* dict_file, FILE* posting_file, int dict_size, LinkedList* all_word_plist) {
-    char word[MAX_KEY_SIZE] = {0};
-    stem(search_word); 
-    int low = 0, high = dict_size - 1;
-    int posting_begin_offset = -1;
-    int posting_end_offset = -1;
+static void reopen_if_changed(IndexReader *index, const SearchOptions *options) {
+    if (index_generation() == index->generation) {
+        return;
+    }
+    IndexReader fresh;
+    if (!index_open(&fresh, index->use_mmap) || fresh.dict_first == 0
+            || (options->model == RANK_BM25 && !fresh.has_stats) || !index_stamps_match(&fresh)
+            || index_generation() != fresh.generation) {
+        index_close(&fresh);
+        return;
+    }
+    fprintf(stderr, "Index files changed, reopened\n");
+    if (options->cache != NULL) {
+        posting_cache_clear(options->cache);
+    }
+    index_close(index);
+    *index = fresh;
+}
 
-    /* Binary search the word in the dictionary */
-    while (low <= high) {
-        int mid = low + (high - low) / 2;
-        fseek(dict_file, mid * (MAX_KEY_SIZE+OFFSET_SIZE), SEEK_SET);
-
-        fread(word, MAX_KEY_SIZE, 1, dict_file);
-        
-        int cmp = strcmp(search_word, word);
-        if (cmp == 0) {
-            /*
-             * Found the word
-             * Get the offset into the posting list file for this word
-             */
-            posting_begin_offset = read_int_big_endian(dict_file);
-            /*
-             * get the end offset from the start of next word 
-             * or from the end of the file if this is the last word
-             */
-            if (mid < dict_size - 1) {
-                fseek(dict_file, (mid + 1) * (MAX_KEY_SIZE + OFFSET_SIZE) + MAX_KEY_SIZE, SEEK_SET);
-                posting_end_offset = read_int_big_endian(dict_file);
-            } else {
-                fseek(posting_file, 0, SEEK_END);
-                posting_end_offset = ftell(posting_file);
+/**
+ * Keep the index open and answer newline separated queries from stdin
+ * and, if a path is given, from clients of a Unix socket.
+ * The index is reopened when its files are rebuilt.
+ * Stops when stdin is closed (without a socket) or on SIGINT/SIGTERM,
+ * then prints a throughput and latency report to stderr.
+ * 
+ * @param index The opened index
+ * @param socket_path Path of the Unix socket, NULL for stdin only
+ * @param options The search options
+ * @return 0 on success, 1 on error
+ */
+int serve(IndexReader *index, const char *socket_path, const SearchOptions *options) {
+    int listen_fd = -1;
+    if (socket_path != NULL) {
+        listen_fd = listen_unix_socket(socket_path);
+        if (listen_fd == -1) {
+            return 1;
+        }
+    }
+    signal(SIGINT, handle_stop_signal);
+    signal(SIGTERM, handle_stop_signal);
+    signal(SIGPIPE, SIG_IGN); /* A client going away must not kill the server */
+
+    /* Slot 0 is stdin, the rest are socket clients */
+    Connection *conns[MAX_CLIENTS + 1] = {0};
+    conns[0] = (Connection *)calloc(1, sizeof(Connection));
+    conns[0]->fd = STDIN_FILENO;
+    conns[0]->out = stdout;
+
+    LatencyStats stats;
+    latency_stats_init(&stats);
+    QueryBuffers buffers = { NULL, NULL, NULL, NULL, NULL, NULL, 0 };
+    double start = time_now();
+
+    while (!stop_serving) {
+        struct pollfd fds[MAX_CLIENTS + 2];
+        int slot_of[MAX_CLIENTS + 2];
+        int n_fds = 0;
+        for (int i = 0; i <= MAX_CLIENTS; i++) {
+            if (conns[i] != NULL) {
+                fds[n_fds].fd = conns[i]->fd;
+                fds[n_fds].events = POLLIN;
+                slot_of[n_fds++] = i;
             }
+        }
+        if (listen_fd != -1) {
+            fds[n_fds].fd = listen_fd;
+            fds[n_fds].events = POLLIN;
+            slot_of[n_fds++] = -1;
+        }
+        if (n_fds == 0) {
+            break; /* stdin closed and no socket to wait on */
+        }
+
+        if (poll(fds, n_fds, -1) == -1) {
+            if (errno == EINTR) continue;
             break;
-        } else if (cmp < 0) {
-            high = mid - 1;
-        } else {
-            low = mid + 1;
+        }
+        reopen_if_changed(index, options);
+
+        for (int i = 0; i < n_fds; i++) {
+            if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+                continue;
+            }
+            if (slot_of[i] == -1) {
+                /* New client, take the first free slot */
+                int client_fd = accept(listen_fd, NULL, NULL);
+                if (client_fd == -1) continue;
+                int slot = 1;
+                while (slot <= MAX_CLIENTS && conns[slot] != NULL) slot++;
+                if (slot > MAX_CLIENTS) {
+                    close(client_fd);
+                    continue;
+                }
+                Connection *conn = (Connection *)calloc(1, sizeof(Connection));
+                FILE *out = conn != NULL ? fdopen(client_fd, "w") : NULL;
+                if (out == NULL) {
+                    /* Drop the client, the others are still served */
+                    fprintf(stderr, "Error: Couldn't accept client: %s\n", strerror(errno));
+                    close(client_fd);
+                    free(conn);
+                    continue;
+                }
+                conn->fd = client_fd;
+                conn->out = out;
+                conns[slot] = conn;
+                continue;
+            }
+
+            Connection *conn = conns[slot_of[i]];
+            if (!serve_connection(index, conn, options, &stats, &buffers)) {
+                if (conn->fd != STDIN_FILENO) {
+                    fclose(conn->out); /* also closes the socket */
+                }
+                free(conn);
+                conns[slot_of[i]] = NULL;
+            }
         }
     }
 
-    if (posting_begin_offset == -1) {
-        /* Word not found */
-        return false;
+    latency_stats_report(&stats, "serve", time_now() - start, stderr);
+    latency_stats_free(&stats);
+    query_buffers_free(&buffers);
+    if (options->cache != NULL) {
+        posting_cache_report(options->cache, stderr);
+    }
+    if (options->results != NULL) {
+        result_cache_report(options->results, stderr);
     }
 
-    /* Read the posting list from the posting file */
-    fseek(posting_file, posting_begin_offset, SEEK_SET);
-    unsigned int p_size = posting_end_offset - posting_begin_offset; /* [begin, end) */
-    unsigned char *data = (unsigned char *)malloc(p_size);
-    fread(data, p_size, 1, posting_file);
+    for (int i = 0; i <= MAX_CLIENTS; i++) {
+        if (conns[i] != NULL && conns[i]->fd != STDIN_FILENO) {
+            fclose(conns[i]->out);
+        }
+        free(conns[i]);
+    }
+    if (listen_fd != -1) {
+        close(listen_fd);
+        unlink(socket_path);
+    }
+    return 0;
+}
+
+/*
+ * A query of a batch, its topic number and its text
+ */
+typedef struct BatchQuery {
+    char topic[32];
+    const char *text;
+} BatchQuery;
 
-    /* Decode the posting list into a linked list */
-    LinkedList* word_plist = decode_posting_list(data, p_size);
+/*
+ * A batch run shared by the worker threads. Each answer is written to
+ * memory and handed on once the answers before it are out.
+ */
+typedef struct Batch {
+    IndexReader *index;
+    const SearchOptions *options;
+    const BatchQuery *queries;
+    int n_queries;
+    double *latency; /* Seconds taken by each query */
+    QueryBufferPool buffers; /* Query buffers of each worker */
+    FILE *out; /* Where the run goes, NULL to only time the queries */
+    char **answers; /* Answers waiting for the ones before them */
+    size_t *answer_sizes;
+    bool *answered;
+    int next_out; /* First query whose answer isn't out */
+    pthread_mutex_t out_lock;
+} Batch;
 
-    /* Append the list to the list of lists */
-    linkedlist_add_tail(all_word_plist, word_plist);
-    return true;
+/**
+ * Find the text of a field of a TREC topic, after the tag and an
+ * optional label such as "Number:"
+ * 
+ * @param top The topic, NUL terminated
+ * @param tag The tag of the field
+ * @param label The label, skipped if present
+ * @return The start of the field's text, NULL if the topic has no such field
+ */
+static char* trec_field(char *top, const char *tag, const char *label) {
+    char *field = strstr(top, tag);
+    if (field == NULL) {
+        return NULL;
+    }
+    field += strlen(tag);
+    while (isspace((unsigned char)*field)) field++;
+    if (strncmp(field, label, strlen(label)) == 0) {
+        field += strlen(label);
+        while (isspace((unsigned char)*field)) field++;
+    }
+    return field;
+}
+
+/* Append a query, growing the array */
+static void add_batch_query(BatchQuery **queries, int *n_queries, int *capacity, const char *topic, const char *text) {
+    if (*n_queries == *capacity) {
+        *capacity *= 2;
+        *queries = (BatchQuery *)realloc(*queries, *capacity * sizeof(BatchQuery));
+    }
+    BatchQuery *query = &(*queries)[*n_queries];
+    snprintf(query->topic, sizeof(query->topic), "%s", topic);
+    query->text = text;
+    *n_queries += 1;
 }
 
 /**
- * Main function.
- * Takes a list of words and finds the documents that contain all the words
+ * Split a query file into queries, in place. Files with <top> tags are
+ * read as TREC topics, the title being the query. Otherwise every non
+ * empty line is a query, its topic number being the line number.
+ * 
+ * @param text The file contents, NUL terminated, cut up in place
+ * @param n_queries Set to the number of queries
+ * @return The queries, their text points into text
  */
-int main(int argc, char *argv[]) {
+BatchQuery* read_batch_queries(char *text, int *n_queries) {
+    int capacity = 256;
+    BatchQuery *queries = (BatchQuery *)malloc(capacity * sizeof(BatchQuery));
+    *n_queries = 0;
 
-    if (argc < 2) {
-        printf("Usage: %s <word>\n", argv[0]);
-        return 1;
+    char *next = strstr(text, "<top>");
+    if (next != NULL) {
+        while (next != NULL) {
+            char *top = next + strlen("<top>");
+            char *end = strstr(top, "</top>");
+            next = end != NULL ? strstr(end, "<top>") : NULL;
+            if (end != NULL) *end = '\0';
+
+            char *topic = trec_field(top, "<num>", "Number:");
+            char *title = trec_field(top, "<title>", "Topic:");
+            if (topic == NULL || title == NULL) {
+                continue;
+            }
+            /* The number is one word, the title runs up to the next tag */
+            title[strcspn(title, "<")] = '\0';
+            topic[strcspn(topic, " \t\r\n<")] = '\0';
+            add_batch_query(&queries, n_queries, &capacity, topic, title);
+        }
+        return queries;
     }
 
-    /* Open the data files */
-    FILE *dict_file = fopen(DICT_FILE, "rb");
-    FILE *posting_file = fopen(POSTING_FILE, "rb");
-    FILE *id_file = fopen(ID_FILE, "rb");
+    int line_number = 1;
+    for (char *line = text; line != NULL; line_number++) {
+        char *newline = strchr(line, '\n');
+        if (newline != NULL) *newline = '\0';
+        if (line[strspn(line, " \t\r")] != '\0') {
+            char topic[32];
+            snprintf(topic, sizeof(topic), "%d", line_number);
+            add_batch_query(&queries, n_queries, &capacity, topic, line);
+        }
+        line = newline != NULL ? newline + 1 : NULL;
+    }
+    return queries;
+}
+
+/**
+ * Run one query of a batch, called by the worker threads.
+ * The query text is split at the characters the tokenizer splits
+ * documents at, its answer goes out once the earlier ones have.
+ * 
+ * @param context The batch
+ * @param q The query
+ * @param worker The worker thread, picks its query buffers
+ */
+static void run_batch_query(void *context, int q, int worker) {
+    Batch *batch = (Batch *)context;
+    double start = time_now();
+
+    /* A copy, the words are stemmed in place and a batch may run again */
+    char *text = strdup(batch->queries[q].text);
+    char *words[MAX_QUERY_WORDS];
+    int n_words = 0;
+    for (char *p = text; *p != '\0' && n_words < MAX_QUERY_WORDS;) {
+        while (*p != '\0' && !isalnum((unsigned char)*p)) p++;
+        if (*p == '\0') break;
+        words[n_words++] = p;
+        while (isalnum((unsigned char)*p)) p++;
+        if (*p != '\0') *p++ = '\0';
+    }
+
+    char *answer = NULL;
+    size_t size = 0;
+    FILE *out = open_memstream(&answer, &size);
+    if (out != NULL) {
+        ResultWriter writer = { out, batch->queries[q].topic, 0, NULL, 0, 0 };
+        if (n_words > 0) {
+            run_query(batch->index, words, n_words, batch->options, &writer,
+                      query_buffer_pool_get(&batch->buffers, worker));
+        }
+        fclose(out);
+    }
+    free(text);
+    batch->latency[q] = time_now() - start;
+
+    /* Write out every answer that is now next in line */
+    pthread_mutex_lock(&batch->out_lock);
+    batch->answers[q] = answer;
+    batch->answer_sizes[q] = size;
+    batch->answered[q] = true;
+    while (batch->next_out < batch->n_queries && batch->answered[batch->next_out]) {
+        int next = batch->next_out++;
+        if (batch->out != NULL && batch->answers[next] != NULL) {
+            fwrite(batch->answers[next], 1, batch->answer_sizes[next], batch->out);
+        }
+        free(batch->answers[next]);
+        batch->answers[next] = NULL;
+    }
+    pthread_mutex_unlock(&batch->out_lock);
+}
+
+/**
+ * Run every query of a batch on a pool of threads
+ * 
+ * @param batch The batch, its queries, index and options set
+ * @param n_threads The number of worker threads
+ * @param out Where the run goes, NULL to only time the queries
+ * @return The wall clock seconds taken, -1 if the threads couldn't start
+ */
+double run_batch(Batch *batch, int n_threads, FILE *out) {
+    batch->out = out;
+    batch->next_out = 0;
+    memset(batch->answered, 0, batch->n_queries * sizeof(bool));
+    double start = time_now();
+    if (!work_pool_run(batch->n_queries, BATCH_CHUNK, n_threads, run_batch_query, batch)) {
+        return -1;
+    }
+    return time_now() - start;
+}
+
+/**
+ * Run a query file and write a TREC run to stdout, in query order.
+ * With scaling the batch is run with 1..n_threads threads instead and
+ * the queries per second of each are printed.
+ * Without -k each topic gets TREC_DEPTH results.
+ * 
+ * @param index The opened index, shared by the threads
+ * @param path The query file, TREC topics or one query per line
+ * @param options The search options
+ * @param n_threads The number of worker threads
+ * @param scaling Report the throughput per thread count
+ * @return 0 on success, 1 on error
+ */
+int batch(IndexReader *index, const char *path, const SearchOptions *options, int n_threads, bool scaling) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        printf("Error: Couldn't open query file '%s'\n", path);
+        return 1;
+    }
     struct stat sb;
-    int stat_res = (fstat(fileno(dict_file), &sb) == -1);
-    if (dict_file == NULL || posting_file == NULL || id_file == NULL || stat_res) {
-        printf("Error: Error opening file(s)\n");
+    fstat(fileno(file), &sb);
+    char *text = (char *)malloc(sb.st_size + 1);
+    size_t size = fread(text, 1, sb.st_size, file);
+    fclose(file);
+    text[size] = '\0';
+
+    int n_queries;
+    BatchQuery *queries = read_batch_queries(text, &n_queries);
+    if (n_queries == 0) {
+        printf("Error: No queries in '%s'\n", path);
+        free(queries);
+        free(text);
         return 1;
     }
 
-    /* List of all words' posting lists */
-    LinkedList *all_word_plist = linkedlist_create(NULL); 
+    SearchOptions batch_options = *options;
+    if (batch_options.top_k == 0) {
+        batch_options.top_k = TREC_DEPTH;
+    }
+    Batch run;
+    memset(&run, 0, sizeof(Batch));
+    run.index = index;
+    run.options = &batch_options;
+    run.queries = queries;
+    run.n_queries = n_queries;
+    run.latency = (double *)malloc(n_queries * sizeof(double));
+    run.answers = (char **)calloc(n_queries, sizeof(char *));
+    run.answer_sizes = (size_t *)calloc(n_queries, sizeof(size_t));
+    run.answered = (bool *)calloc(n_queries, sizeof(bool));
+    pthread_mutex_init(&run.out_lock, NULL);
+    if (!query_buffer_pool_init(&run.buffers, n_threads)) {
+        printf("Error: Out of memory\n");
+        pthread_mutex_destroy(&run.out_lock);
+        free(run.latency);
+        free(run.answers);
+        free(run.answer_sizes);
+        free(run.answered);
+        free(queries);
+        free(text);
+        return 1;
+    }
 
-    
-    /* Search for each word in the dictionary */
-    int dict_size = sb.st_size / (MAX_KEY_SIZE + OFFSET_SIZE);
-    for (int i = 1; i < argc; i++) {
-        bool found = get_posting_list(argv[i], dict_file, posting_file, dict_size, all_word_plist);
-        if (!found) {
-            /* If any one of the words is not found, exit */
-            return 0;
+    int status = 0;
+    if (scaling) {
+        double base = 0;
+        printf("%8s %12s %12s %10s\n", "threads", "seconds", "queries/sec", "speedup");
+        for (int j = 1; j <= n_threads && status == 0; j++) {
+            double seconds = run_batch(&run, j, NULL);
+            if (seconds < 0) {
+                status = 1;
+                break;
+            }
+            if (j == 1) base = seconds;
+            printf("%8d %12.3f %12.1f %10.2f\n", j, seconds, n_queries / seconds, seconds > 0 ? base / seconds : 0);
         }
+    } else {
+        double seconds = run_batch(&run, n_threads, stdout);
+        if (seconds < 0) {
+            status = 1;
+        } else {
+            fflush(stdout);
+            LatencyStats stats;
+            latency_stats_init(&stats);
+            for (int q = 0; q < n_queries; q++) {
+                latency_stats_add(&stats, run.latency[q]);
+            }
+            char label[64];
+            snprintf(label, sizeof(label), "batch (%d threads)", n_threads);
+            latency_stats_report(&stats, label, seconds, stderr);
+            latency_stats_free(&stats);
+        }
+    }
+    if (options->cache != NULL) {
+        posting_cache_report(options->cache, stderr);
+    }
+    if (options->results != NULL) {
+        result_cache_report(options->results, stderr);
     }
 
-    /* If no words were found, exit */
-    if (all_word_plist->head == NULL) {
-        return 0;
+    query_buffer_pool_free(&run.buffers);
+    pthread_mutex_destroy(&run.out_lock);
+    free(run.latency);
+    free(run.answers);
+    free(run.answer_sizes);
+    free(run.answered);
+    free(queries);
+    free(text);
+    return status;
+}
+
+/**
+ * Main function.
+ * Takes a list of words and finds the documents that contain all the words
+ * or with --serve keeps the index open and answers queries line by line,
+ * or with --batch runs a query file on -j threads
+ */
+int main(int argc, char *argv[]) {
+    bool use_mmap = true;
+    SearchOptions options = { 0, RANK_BM25, false, NULL, NULL };
+    size_t cache_mb = 0;
+    size_t result_cache_mb = 0;
+    bool rank_given = false;
+    int n_threads = 1;
+    bool scaling = false;
+    int arg = 1;
+
+    /* Leading options */
+    while (arg < argc) {
+        if (strcmp(argv[arg], "--no-mmap") == 0) {
+            use_mmap = false;
+            arg += 1;
+        } else if (arg + 1 < argc && strcmp(argv[arg], "-k") == 0) {
+            options.top_k = atoi(argv[arg + 1]);
+            if (options.top_k < 1) {
+                printf("Error: -k takes the number of results to print\n");
+                return 1;
+            }
+            arg += 2;
+        } else if (arg + 1 < argc && strcmp(argv[arg], "--rank") == 0) {
+            if (strcmp(argv[arg + 1], "bm25") == 0) {
+                options.model = RANK_BM25;
+            } else if (strcmp(argv[arg + 1], "freq") == 0) {
+                options.model = RANK_FREQ;
+            } else {
+                printf("Error: --rank takes bm25 or freq\n");
+                return 1;
+            }
+            rank_given = true;
+            arg += 2;
+        } else if (strcmp(argv[arg], "--or") == 0) {
+            options.disjunctive = true;
+            arg += 1;
+        } else if (arg + 1 < argc && strcmp(argv[arg], "-j") == 0) {
+            n_threads = atoi(argv[arg + 1]);
+            if (n_threads < 1 || n_threads > WORK_POOL_MAX_THREADS) {
+                printf("Error: -j takes 1 to %d threads\n", WORK_POOL_MAX_THREADS);
+                return 1;
+            }
+            arg += 2;
+        } else if (strcmp(argv[arg], "--scaling") == 0) {
+            scaling = true;
+            arg += 1;
+        } else if (arg + 1 < argc && strcmp(argv[arg], "--cache") == 0) {
+            int mb = atoi(argv[arg + 1]);
+            if (mb < 1) {
+                printf("Error: --cache takes the cache size in MB\n");
+                return 1;
+            }
+            cache_mb = mb;
+            arg += 2;
+        } else if (arg + 1 < argc && strcmp(argv[arg], "--result-cache") == 0) {
+            int mb = atoi(argv[arg + 1]);
+            if (mb < 1) {
+                printf("Error: --result-cache takes the cache size in MB\n");
+                return 1;
+            }
+            result_cache_mb = mb;
+            arg += 2;
+        } else {
+            break;
+        }
     }
-    
-    /* Intersect the posting lists of all words (AND search) */
-    LinkedList *results = NULL;
-    intersect_posting_lists(all_word_plist, &results);
 
-    /* Rank the results and get DOC_ID from the ID file */
-    LinkedList *ranked_results = linkedlist_create(cmp_search_results);
-    calculate_rank(ranked_results, results, id_file);
+    if (arg >= argc) {
+        printf("Usage: %s [--no-mmap] [-k results] [--rank bm25|freq] [--or] <word>\n", argv[0]);
+        printf("       %s [--no-mmap] [-k results] [--rank bm25|freq] [--or] [--cache MB] [--result-cache MB]"
+               " --serve [socket_path]\n", argv[0]);
+        printf("       %s [--no-mmap] [-k results] [--rank bm25|freq] [--or] [--cache MB] [--result-cache MB]"
+               " [-j threads] [--scaling] --batch <query_file>\n", argv[0]);
+        return 1;
+    }
 
-    /* Sort the ranked results */
-    linkedlist_sort(ranked_results);
+    IndexReader index;
+    if (!index_open(&index, use_mmap)) {
+        index_close(&index);
+        return 1;
+    }
+    if (options.model == RANK_BM25 && !index.has_stats) {
+        if (rank_given) {
+            printf("Error: BM25 needs %s, rebuild the index\n", DOC_STATS_FILE);
+            index_close(&index);
+            return 1;
+        }
+        /* Index from before the document lengths were saved */
+        options.model = RANK_FREQ;
+    }
+    if (options.disjunctive && options.model != RANK_BM25) {
+        printf("Error: --or ranks with BM25, which needs %s\n", DOC_STATS_FILE);
+        index_close(&index);
+        return 1;
+    }
 
-    /* Print the ranked and sorted results */
-    Node *current = ranked_results->head;
-    while (current != NULL) {
-        SearchResult *result = (SearchResult *)current->data;
-        printf("%s %f\n", result->doc_id, result->score);
-        current = current->next;
+    PostingCache cache;
+    if (cache_mb > 0) {
+        if (!posting_cache_init(&cache, cache_mb << 20)) {
+            printf("Error: Out of memory\n");
+            index_close(&index);
+            return 1;
+        }
+        options.cache = &cache;
+    }
+    ResultCache results;
+    if (result_cache_mb > 0) {
+        if (!result_cache_init(&results, result_cache_mb << 20)) {
+            printf("Error: Out of memory\n");
+            if (options.cache != NULL) posting_cache_free(options.cache);
+            index_close(&index);
+            return 1;
+        }
+        options.results = &results;
     }
 
-    /* Clean up */
-    fclose(dict_file);
-    fclose(posting_file);
-    fclose(id_file);
-    linkedlist_delete(all_word_plist);
-    linkedlist_delete(results);
-    linkedlist_delete(ranked_results);
+    int status = 0;
+    if (strcmp(argv[arg], "--serve") == 0) {
+        status = serve(&index, arg + 1 < argc ? argv[arg + 1] : NULL, &options);
+    } else if (strcmp(argv[arg], "--batch") == 0 && arg + 1 < argc) {
+        status = batch(&index, argv[arg + 1], &options, n_threads, scaling);
+    } else {
+        ResultWriter writer = { stdout, NULL, 0, NULL, 0, 0 };
+        QueryBuffers buffers = { NULL, NULL, NULL, NULL, NULL, NULL, 0 };
+        run_query(&index, argv + arg, argc - arg, &options, &writer, &buffers);
+        query_buffers_free(&buffers);
+    }
 
-    return 0;
-}
\ No newline at end of file
+    if (options.cache != NULL) {
+        posting_cache_free(options.cache);
+    }
+    if (options.results != NULL) {
+        result_cache_free(options.results);
+    }
+    index_close(&index);
+    return status;
+}